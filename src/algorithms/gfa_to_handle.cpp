@@ -1,5 +1,13 @@
 #include "gfa_to_handle.hpp"
 #include "../path.hpp"
+#include "../utility.hpp"
+
+#include <cstring>
+#include <unordered_set>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace vg {
 namespace algorithms {
@@ -17,6 +25,31 @@ struct IDMapInfo {
     nid_t max_id = 0;
     unordered_map<string, nid_t> name_to_id;
 };
+
+/// Interpret a segment name as a positive numeric ID. Returns false if it
+/// isn't all digits, is 0, or doesn't fit in an ID.
+static bool parse_gfa_numeric_id(const char* name, size_t length, nid_t& node_id) {
+    if (length == 0) {
+        return false;
+    }
+    nid_t value = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (!isdigit(name[i])) {
+            return false;
+        }
+        nid_t digit = name[i] - '0';
+        if (value > (numeric_limits<nid_t>::max() - digit) / 10) {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    if (value <= 0) {
+        return false;
+    }
+    node_id = value;
+    return true;
+}
+
 static nid_t parse_gfa_sequence_id(const string& str, IDMapInfo& id_map_info) {
     
     if (id_map_info.name_to_id.count(str)) {
@@ -25,17 +58,9 @@ static nid_t parse_gfa_sequence_id(const string& str, IDMapInfo& id_map_info) {
     } 
 
     nid_t node_id = -1;
-    if (id_map_info.numeric_mode) {
-        if (any_of(str.begin(), str.end(), [](char c) { return !isdigit(c); })) {
-            // non-numeric: use max id and add to map
-            id_map_info.numeric_mode = false;
-        } else {
-            node_id = stoll(str);
-            if (node_id <= 0) {
-                // treat <= 0 as non-numeric
-                id_map_info.numeric_mode = false;
-            }
-        }
+    if (id_map_info.numeric_mode && !parse_gfa_numeric_id(str.data(), str.size(), node_id)) {
+        // non-numeric (or <= 0): use max id and add to map
+        id_map_info.numeric_mode = false;
     }
 
     // if numeric, the id was set to stoll above, otherwise we take it from current max
@@ -62,11 +87,12 @@ static void write_gfa_translation(const IDMapInfo& id_map_info, const string& tr
     }
 }
 
+static const string not_blunt = ("error:[gfa_to_handle_graph] Can only load blunt-ended GFAs. "
+    "Try \"bluntifying\" your graph with a tool like <https://github.com/vgteam/GetBlunted>, or "
+    "transitively merge overlaps with a pipeline of <https://github.com/ekg/gimbricate> and "
+    "<https://github.com/ekg/seqwish>.");
+
 static void validate_gfa_edge(const gfak::edge_elem& e) {
-    static const string not_blunt = ("error:[gfa_to_handle_graph] Can only load blunt-ended GFAs. "
-        "Try \"bluntifying\" your graph with a tool like <https://github.com/vgteam/GetBlunted>, or "
-        "transitively merge overlaps with a pipeline of <https://github.com/ekg/gimbricate> and "
-        "<https://github.com/ekg/seqwish>.");
     if (e.source_begin != e.source_end || e.sink_begin != 0 || e.sink_end != 0) {
         throw GFAFormatError(not_blunt + " Found edge with an overlay: " + e.source_name + "[" + to_string(e.source_begin) + ":" + to_string(e.source_end) + "] -> " + e.sink_name + "[" + to_string(e.sink_begin) + ":" + to_string(e.sink_end) + "]");
     }
@@ -465,9 +491,554 @@ static vector<gfak::sequence_elem> gfa_to_path_handle_graph_stream(istream& in,
     return rgfa_seq_elems;
 }
 
+/// A GFA file, memory-mapped read-only for the parallel loader.
+class MappedGFA {
+public:
+    /// Map the given file. If it isn't a regular file that can be mapped,
+    /// data will be null. Throws std::ios_base::failure if it can't be opened.
+    MappedGFA(const string& filename) {
+        fd = open(filename.c_str(), O_RDONLY);
+        if (fd == -1) {
+            throw std::ios_base::failure("error:[gfa_to_handle_graph] Couldn't open file " + filename);
+        }
+        struct stat file_stats;
+        if (fstat(fd, &file_stats) != 0 || !S_ISREG(file_stats.st_mode)) {
+            // Pipes and the like can't be mapped.
+            return;
+        }
+        size = file_stats.st_size;
+        if (size == 0) {
+            // Nothing to map, but nothing to load either.
+            data = "";
+            return;
+        }
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            size = 0;
+            return;
+        }
+        // Every pass reads the file front to back.
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = (const char*) mapped;
+    }
+    
+    ~MappedGFA() {
+        if (data != nullptr && size != 0) {
+            munmap((void*) data, size);
+        }
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+    
+    MappedGFA(const MappedGFA& other) = delete;
+    MappedGFA& operator=(const MappedGFA& other) = delete;
+    
+    const char* data = nullptr;
+    size_t size = 0;
+    
+private:
+    int fd = -1;
+};
+
+/// A tab-separated field of a GFA line, pointing into the mapped file.
+struct GFAField {
+    const char* data = nullptr;
+    size_t length = 0;
+    
+    string str() const {
+        return string(data, length);
+    }
+    
+    bool operator==(const char* other) const {
+        return strlen(other) == length && strncmp(data, other, length) == 0;
+    }
+};
+
+/// Get the field starting at cursor, and advance cursor past it and the tab
+/// after it. Returns false if there are no more fields before end.
+static bool next_gfa_field(const char*& cursor, const char* end, GFAField& field) {
+    if (cursor > end) {
+        return false;
+    }
+    const char* tab = (const char*) memchr(cursor, '\t', end - cursor);
+    if (tab == nullptr) {
+        tab = end;
+    }
+    field.data = cursor;
+    field.length = tab - cursor;
+    cursor = tab + 1;
+    return true;
+}
+
+/// Interpret a segment name as a positive numeric ID, the way
+/// parse_gfa_sequence_id() does in numeric mode. Returns false if it isn't
+/// one.
+static bool parse_gfa_numeric_id(const GFAField& name, nid_t& node_id) {
+    return parse_gfa_numeric_id(name.data, name.length, node_id);
+}
+
+/// Assign an ID to a segment being created, in file order, with the same
+/// results as parse_gfa_sequence_id(). While all the names are numeric, they
+/// are kept out of the name map, since they don't need it. Numeric names that
+/// aren't written the way to_string() would write their IDs (like "007") are
+/// remembered in padded_names instead. If we switch, the map then gets every
+/// name exactly as written, as parse_gfa_sequence_id() would have stored it,
+/// so later names like "7" get new IDs the same way.
+static nid_t assign_gfa_sequence_id(const GFAField& name, IDMapInfo& id_map_info, const HandleGraph* graph,
+                                    vector<GFAField>& padded_names) {
+    nid_t node_id;
+    if (id_map_info.numeric_mode && parse_gfa_numeric_id(name, node_id)) {
+        id_map_info.max_id = std::max(node_id, id_map_info.max_id);
+        if (name.data[0] == '0') {
+            padded_names.push_back(name);
+        }
+        return node_id;
+    }
+    
+    if (id_map_info.numeric_mode) {
+        // Switch to assigning IDs, and put the numeric names we skipped into
+        // the map so that everything can be found there from now on.
+        id_map_info.numeric_mode = false;
+        id_map_info.name_to_id.reserve(graph->get_node_count() + 1);
+        unordered_set<nid_t> padded_ids;
+        for (auto& padded_name : padded_names) {
+            nid_t existing_id;
+            parse_gfa_numeric_id(padded_name, existing_id);
+            id_map_info.name_to_id[padded_name.str()] = existing_id;
+            padded_ids.insert(existing_id);
+        }
+        padded_names.clear();
+        graph->for_each_handle([&](const handle_t& handle) {
+            nid_t existing_id = graph->get_id(handle);
+            if (!padded_ids.count(existing_id)) {
+                id_map_info.name_to_id[to_string(existing_id)] = existing_id;
+            }
+        });
+    }
+    
+    string name_string = name.str();
+    auto found = id_map_info.name_to_id.find(name_string);
+    if (found != id_map_info.name_to_id.end()) {
+        return found->second;
+    }
+    node_id = id_map_info.max_id + 1;
+    id_map_info.max_id = node_id;
+    id_map_info.name_to_id.emplace(std::move(name_string), node_id);
+    return node_id;
+}
+
+/// Look up the ID for an existing segment name without modifying anything, so
+/// it can be done from many threads at once. Returns false if there is no
+/// such segment.
+static bool resolve_gfa_sequence_id(const GFAField& name, const IDMapInfo& id_map_info, const HandleGraph* graph,
+                                    nid_t& node_id) {
+    if (id_map_info.numeric_mode) {
+        return parse_gfa_numeric_id(name, node_id) && graph->has_node(node_id);
+    }
+    auto found = id_map_info.name_to_id.find(name.str());
+    if (found == id_map_info.name_to_id.end()) {
+        return false;
+    }
+    node_id = found->second;
+    return true;
+}
+
+/// Call the callback with the start and past-the-end of each line between
+/// begin and end, not including the newline.
+static void for_each_gfa_line(const char* begin, const char* end,
+                              const function<void(const char*, const char*)>& iteratee) {
+    while (begin < end) {
+        const char* newline = (const char*) memchr(begin, '\n', end - begin);
+        const char* line_end = newline == nullptr ? end : newline;
+        if (line_end != begin) {
+            iteratee(begin, line_end);
+        }
+        begin = line_end + 1;
+    }
+}
+
+/// Make one pass over a mapped GFA file, in batches of line-aligned blocks of
+/// up to block_size bytes. For each batch, parse_block is called on each
+/// block in parallel, filling in a Parsed, and then apply_batch is called on
+/// one thread with the Parsed results of the whole batch, in file order.
+///
+/// A line longer than a block is first offered to take_long_line, alone and
+/// on one thread, after everything before it has been applied. If that returns
+/// false, the line gets a block of its own.
+template<typename Parsed>
+static void for_each_gfa_block_batch(const MappedGFA& gfa,
+                                     const function<void(const char*, const char*, Parsed&)>& parse_block,
+                                     const function<void(vector<Parsed>&)>& apply_batch,
+                                     const function<bool(const char*, const char*)>& take_long_line,
+                                     size_t block_size) {
+    
+    size_t max_batch_blocks = 2 * get_thread_count();
+    vector<pair<size_t, size_t>> blocks;
+    vector<Parsed> parsed;
+    size_t pos = 0;
+    while (pos < gfa.size) {
+        blocks.clear();
+        while (pos < gfa.size && blocks.size() < max_batch_blocks) {
+            size_t limit = pos + block_size;
+            size_t end;
+            if (limit >= gfa.size) {
+                end = gfa.size;
+            } else {
+                // End the block after the last full line that fits.
+                end = limit;
+                while (end > pos && gfa.data[end - 1] != '\n') {
+                    --end;
+                }
+                if (end == pos) {
+                    // The line here is longer than a block.
+                    const char* newline = (const char*) memchr(gfa.data + limit, '\n', gfa.size - limit);
+                    size_t line_end = newline == nullptr ? gfa.size : newline - gfa.data;
+                    if (!blocks.empty()) {
+                        // Finish what comes before it first.
+                        break;
+                    }
+                    if (take_long_line(gfa.data + pos, gfa.data + line_end)) {
+                        pos = std::min(gfa.size, line_end + 1);
+                        continue;
+                    }
+                    end = std::min(gfa.size, line_end + 1);
+                }
+            }
+            blocks.emplace_back(pos, end);
+            pos = end;
+        }
+        
+        if (blocks.empty()) {
+            continue;
+        }
+        parsed.clear();
+        parsed.resize(blocks.size());
+#pragma omp parallel for schedule(dynamic, 1)
+        for (size_t i = 0; i < blocks.size(); i++) {
+            parse_block(gfa.data + blocks[i].first, gfa.data + blocks[i].second, parsed[i]);
+        }
+        apply_batch(parsed);
+    }
+}
+
+/// Parse a comma-separated list of oriented segment names, as in the segment
+/// names field of a P line, into handles. Empty entries are skipped. Returns
+/// an error message, or an empty string on success.
+static string parse_gfa_steps(const char* begin, const char* end, const IDMapInfo& id_map_info,
+                              const HandleGraph* graph, vector<handle_t>& steps) {
+    while (begin < end) {
+        const char* comma = (const char*) memchr(begin, ',', end - begin);
+        const char* step_end = comma == nullptr ? end : comma;
+        if (step_end != begin) {
+            char orientation = *(step_end - 1);
+            GFAField name;
+            name.data = begin;
+            name.length = step_end - begin - 1;
+            nid_t node_id;
+            if ((orientation != '+' && orientation != '-') || !resolve_gfa_sequence_id(name, id_map_info, graph, node_id)) {
+                return "error:[gfa_to_handle_graph] Found path step '" + string(begin, step_end) +
+                    "' that is not an oriented existing segment";
+            }
+            steps.push_back(graph->get_handle(node_id, orientation == '-'));
+        }
+        begin = step_end + 1;
+    }
+    return "";
+}
+
+/// Load a GFA file from disk, in parallel over all threads, by memory-mapping
+/// it and parsing blocks of about block_size bytes of lines on each thread
+/// without copying. Nodes are
+/// created in one pass, and then edges and, if path_graph is set, paths in
+/// another, always in file order so IDs come out the same as with the
+/// sequential loaders.
+///
+/// rGFA-tagged segments are appended to rgfa_seq_elems, for
+/// gfa_to_handle_graph_add_rgfa_paths().
+///
+/// Returns false without doing anything if the file can't be memory-mapped,
+/// in which case a sequential loader must be used.
+static bool gfa_to_handle_graph_parallel(const string& filename, MutableHandleGraph* graph,
+                                         MutablePathHandleGraph* path_graph, bool try_id_increment_hint,
+                                         IDMapInfo& id_map_info, vector<gfak::sequence_elem>& rgfa_seq_elems,
+                                         size_t block_size) {
+    
+    MappedGFA gfa(filename);
+    if (gfa.data == nullptr) {
+        return false;
+    }
+    if (graph->get_node_count() > 0) {
+        throw invalid_argument("error:[gfa_to_handle_graph] Must parse GFA into an empty graph");
+    }
+    
+    // Long lines are parsed inside the passes that need them and skipped by
+    // the others.
+    auto skip_long_line_unless = [](char record_type) {
+        return [record_type](const char* begin, const char* end) {
+            return *begin != record_type;
+        };
+    };
+    
+    if (try_id_increment_hint) {
+        // Find the minimum ID. Only names before the first non-numeric one
+        // keep their numbers, and everything after gets a bigger ID.
+        struct MinIDBlock {
+            nid_t min_id = numeric_limits<nid_t>::max();
+            bool found_non_numeric = false;
+        };
+        nid_t min_id = numeric_limits<nid_t>::max();
+        bool found_non_numeric = false;
+        for_each_gfa_block_batch<MinIDBlock>(gfa, [&](const char* begin, const char* end, MinIDBlock& block) {
+            for_each_gfa_line(begin, end, [&](const char* line, const char* line_end) {
+                GFAField type, name;
+                if (*line != 'S' || block.found_non_numeric ||
+                    !next_gfa_field(line, line_end, type) || !next_gfa_field(line, line_end, name)) {
+                    return;
+                }
+                nid_t node_id;
+                if (parse_gfa_numeric_id(name, node_id)) {
+                    block.min_id = std::min(block.min_id, node_id);
+                } else {
+                    block.found_non_numeric = true;
+                }
+            });
+        }, [&](vector<MinIDBlock>& blocks) {
+            for (auto& block : blocks) {
+                if (!found_non_numeric) {
+                    min_id = std::min(min_id, block.min_id);
+                    found_non_numeric = block.found_non_numeric;
+                }
+            }
+        }, skip_long_line_unless('S'), block_size);
+        
+        if (found_non_numeric && min_id == numeric_limits<nid_t>::max()) {
+            // Assigned IDs start at 1
+            min_id = 1;
+        }
+        if (min_id != numeric_limits<nid_t>::max()) {
+            graph->set_id_increment(min_id);
+        }
+    }
+    
+    // Make all the nodes
+    vector<GFAField> padded_names;
+    struct SegmentBlock {
+        struct Segment {
+            GFAField name;
+            GFAField sequence;
+            // rGFA tags, if the segment has all of them
+            vector<gfak::opt_elem> rgfa_tags;
+        };
+        vector<Segment> segments;
+        string error;
+    };
+    for_each_gfa_block_batch<SegmentBlock>(gfa, [&](const char* begin, const char* end, SegmentBlock& block) {
+        for_each_gfa_line(begin, end, [&](const char* line, const char* line_end) {
+            if (*line != 'S' || !block.error.empty()) {
+                return;
+            }
+            const char* cursor = line;
+            GFAField type;
+            SegmentBlock::Segment segment;
+            if (!next_gfa_field(cursor, line_end, type) || !(type == "S") ||
+                !next_gfa_field(cursor, line_end, segment.name) || !next_gfa_field(cursor, line_end, segment.sequence)) {
+                block.error = "error:[gfa_to_handle_graph] Found malformed S line: " + string(line, line_end);
+                return;
+            }
+            GFAField tag;
+            while (next_gfa_field(cursor, line_end, tag)) {
+                if (tag.length > 5 && tag.data[2] == ':' && tag.data[4] == ':' &&
+                    ((tag.data[0] == 'S' && tag.data[1] == 'N' && tag.data[3] == 'Z') ||
+                     (tag.data[0] == 'S' && (tag.data[1] == 'O' || tag.data[1] == 'R') && tag.data[3] == 'i'))) {
+                    gfak::opt_elem opt;
+                    opt.key = string(tag.data, 2);
+                    opt.type = string(tag.data + 3, 1);
+                    opt.val = string(tag.data + 5, tag.length - 5);
+                    segment.rgfa_tags.push_back(opt);
+                }
+            }
+            if (segment.rgfa_tags.size() < 3) {
+                segment.rgfa_tags.clear();
+            }
+            block.segments.push_back(std::move(segment));
+        });
+    }, [&](vector<SegmentBlock>& blocks) {
+        for (auto& block : blocks) {
+            if (!block.error.empty()) {
+                throw GFAFormatError(block.error);
+            }
+            for (auto& segment : block.segments) {
+                graph->create_handle(segment.sequence.str(), assign_gfa_sequence_id(segment.name, id_map_info, graph, padded_names));
+                if (!segment.rgfa_tags.empty()) {
+                    gfak::sequence_elem seq_elem;
+                    seq_elem.name = segment.name.str();
+                    seq_elem.length = segment.sequence.length;
+                    seq_elem.opt_fields = std::move(segment.rgfa_tags);
+                    if (gfa_sequence_parse_rgfa_tags(seq_elem)) {
+                        rgfa_seq_elems.push_back(std::move(seq_elem));
+                    }
+                }
+            }
+        }
+    }, skip_long_line_unless('S'), block_size);
+    
+    // Make all the edges and paths. From here on, we only read the graph and
+    // the name map while parsing.
+    struct LinkPathBlock {
+        struct PathLine {
+            string name;
+            vector<handle_t> steps;
+        };
+        vector<pair<handle_t, handle_t>> edges;
+        vector<PathLine> paths;
+        string error;
+    };
+    
+    // Parse the name out of a P line, and point cursor at its steps
+    auto parse_path_name = [&](const char*& cursor, const char* line_end, string& path_name, const char*& steps_end) {
+        GFAField type, name, steps;
+        if (!next_gfa_field(cursor, line_end, type) || !(type == "P") || !next_gfa_field(cursor, line_end, name)) {
+            return false;
+        }
+        const char* steps_begin = cursor;
+        if (!next_gfa_field(cursor, line_end, steps)) {
+            return false;
+        }
+        path_name = process_raw_gfa_path_name(name.str());
+        cursor = steps_begin;
+        steps_end = steps.data + steps.length;
+        if (steps == "*") {
+            // No steps
+            steps_end = cursor;
+        }
+        return true;
+    };
+    
+    // Get the handle of a path, making it if it's new
+    auto get_path = [&](const string& path_name) {
+        if (path_graph->has_path(path_name)) {
+            return path_graph->get_path_handle(path_name);
+        }
+        return path_graph->create_path_handle(path_name);
+    };
+    
+    for_each_gfa_block_batch<LinkPathBlock>(gfa, [&](const char* begin, const char* end, LinkPathBlock& block) {
+        for_each_gfa_line(begin, end, [&](const char* line, const char* line_end) {
+            if (!block.error.empty()) {
+                return;
+            }
+            const char* cursor = line;
+            if (*line == 'L') {
+                GFAField type, from, from_orientation, to, to_orientation, overlap;
+                if (!next_gfa_field(cursor, line_end, type) || !(type == "L") ||
+                    !next_gfa_field(cursor, line_end, from) || !next_gfa_field(cursor, line_end, from_orientation) ||
+                    !next_gfa_field(cursor, line_end, to) || !next_gfa_field(cursor, line_end, to_orientation) ||
+                    !(from_orientation == "+" || from_orientation == "-") ||
+                    !(to_orientation == "+" || to_orientation == "-")) {
+                    block.error = "error:[gfa_to_handle_graph] Found malformed L line: " + string(line, line_end);
+                    return;
+                }
+                if (next_gfa_field(cursor, line_end, overlap) && !(overlap == "0M" || overlap == "*" || overlap == "")) {
+                    block.error = not_blunt + " Found edge with a non-null alignment '" + overlap.str() + "'.";
+                    return;
+                }
+                nid_t from_id, to_id;
+                if (!resolve_gfa_sequence_id(from, id_map_info, graph, from_id) ||
+                    !resolve_gfa_sequence_id(to, id_map_info, graph, to_id)) {
+                    block.error = "error:[gfa_to_handle_graph] Found edge record with a missing segment: " + string(line, line_end);
+                    return;
+                }
+                block.edges.emplace_back(graph->get_handle(from_id, from_orientation == "-"),
+                                         graph->get_handle(to_id, to_orientation == "-"));
+            } else if (*line == 'P' && path_graph != nullptr) {
+                LinkPathBlock::PathLine path;
+                const char* steps_end;
+                if (!parse_path_name(cursor, line_end, path.name, steps_end)) {
+                    block.error = "error:[gfa_to_handle_graph] Found malformed P line: " + string(line, line_end);
+                    return;
+                }
+                block.error = parse_gfa_steps(cursor, steps_end, id_map_info, graph, path.steps);
+                block.paths.push_back(std::move(path));
+            }
+        });
+    }, [&](vector<LinkPathBlock>& blocks) {
+        for (auto& block : blocks) {
+            if (!block.error.empty()) {
+                throw GFAFormatError(block.error);
+            }
+            for (auto& edge : block.edges) {
+                // note: we're counting on implementations de-duplicating edges
+                graph->create_edge(edge.first, edge.second);
+            }
+            for (auto& path : block.paths) {
+                path_handle_t path_handle = get_path(path.name);
+                for (auto& step : path.steps) {
+                    path_graph->append_step(path_handle, step);
+                }
+            }
+        }
+    }, [&](const char* begin, const char* end) {
+        if (*begin != 'P') {
+            // Only long P lines need special treatment.
+            return *begin != 'L';
+        }
+        if (path_graph == nullptr) {
+            return true;
+        }
+        
+        // A whole-genome path can be one enormous line, so split its steps
+        // into pieces at commas and parse them in parallel, a window at a
+        // time to bound the memory used.
+        const char* cursor = begin;
+        string path_name;
+        const char* steps_end;
+        if (!parse_path_name(cursor, end, path_name, steps_end)) {
+            throw GFAFormatError("error:[gfa_to_handle_graph] Found malformed P line starting: " +
+                                 string(begin, std::min<size_t>(end - begin, 100)));
+        }
+        path_handle_t path_handle = get_path(path_name);
+        
+        size_t pieces = get_thread_count();
+        vector<vector<handle_t>> piece_steps(pieces);
+        vector<string> piece_errors(pieces);
+        vector<const char*> bounds(pieces + 1);
+        while (cursor < steps_end) {
+            // Pick piece boundaries just after commas
+            bounds[0] = cursor;
+            for (size_t i = 1; i <= pieces; i++) {
+                const char* bound = (size_t) (steps_end - cursor) > i * block_size ? cursor + i * block_size : steps_end;
+                bound = std::max(bound, bounds[i - 1]);
+                if (bound < steps_end) {
+                    const char* comma = (const char*) memchr(bound, ',', steps_end - bound);
+                    bound = comma == nullptr ? steps_end : comma + 1;
+                }
+                bounds[i] = bound;
+            }
+#pragma omp parallel for schedule(dynamic, 1)
+            for (size_t i = 0; i < pieces; i++) {
+                piece_steps[i].clear();
+                piece_errors[i] = parse_gfa_steps(bounds[i], bounds[i + 1], id_map_info, graph, piece_steps[i]);
+            }
+            for (size_t i = 0; i < pieces; i++) {
+                if (!piece_errors[i].empty()) {
+                    throw GFAFormatError(piece_errors[i]);
+                }
+                for (auto& step : piece_steps[i]) {
+                    path_graph->append_step(path_handle, step);
+                }
+            }
+            cursor = bounds[pieces];
+        }
+        return true;
+    }, block_size);
+    
+    return true;
+}
+
 void gfa_to_handle_graph(const string& filename, MutableHandleGraph* graph,
                          bool try_from_disk, bool try_id_increment_hint,
-                         const string& translation_filename) {
+                         const string& translation_filename, size_t block_size) {
 
     // What stream should we read from (isntead of opening the file), if any?
     istream* unseekable = nullptr;
@@ -490,7 +1061,11 @@ void gfa_to_handle_graph(const string& filename, MutableHandleGraph* graph,
     
     gfak::GFAKluge gg;
     IDMapInfo id_map_info;
-    gfa_to_handle_graph_load_graph(filename, unseekable, graph, try_id_increment_hint, gg, id_map_info);
+    vector<gfak::sequence_elem> rgfa_seq_elems;
+    if (unseekable || !gfa_to_handle_graph_parallel(filename, graph, nullptr, try_id_increment_hint,
+                                                    id_map_info, rgfa_seq_elems, block_size)) {
+        gfa_to_handle_graph_load_graph(filename, unseekable, graph, try_id_increment_hint, gg, id_map_info);
+    }
 
     write_gfa_translation(id_map_info, translation_filename);
 }
@@ -498,7 +1073,8 @@ void gfa_to_handle_graph(const string& filename, MutableHandleGraph* graph,
 
 void gfa_to_path_handle_graph(const string& filename, MutablePathMutableHandleGraph* graph,
                               bool try_from_disk, bool try_id_increment_hint,
-                              int64_t max_rgfa_rank, const string& translation_filename) {
+                              int64_t max_rgfa_rank, const string& translation_filename,
+                              size_t block_size) {
     
     
     // What stream should we read from (isntead of opening the file), if any?
@@ -522,13 +1098,22 @@ void gfa_to_path_handle_graph(const string& filename, MutablePathMutableHandleGr
     
     gfak::GFAKluge gg;
     IDMapInfo id_map_info;
-    bool has_rgfa_tags = gfa_to_handle_graph_load_graph(filename, unseekable, graph, try_id_increment_hint, gg, id_map_info);
-    
-    // TODO: Deduplicate everything other than this line somehow.
-    gfa_to_handle_graph_add_paths(filename, unseekable, graph, gg, id_map_info);
+    vector<gfak::sequence_elem> rgfa_seq_elems;
+    if (!unseekable && gfa_to_handle_graph_parallel(filename, graph, graph, try_id_increment_hint,
+                                                    id_map_info, rgfa_seq_elems, block_size)) {
+        // We loaded it all in parallel, and collected the rGFA tags as we went
+        if (!rgfa_seq_elems.empty()) {
+            gfa_to_handle_graph_add_rgfa_paths(filename, nullptr, &rgfa_seq_elems, graph, gg, id_map_info, max_rgfa_rank);
+        }
+    } else {
+        bool has_rgfa_tags = gfa_to_handle_graph_load_graph(filename, unseekable, graph, try_id_increment_hint, gg, id_map_info);
+        
+        // TODO: Deduplicate everything other than this line somehow.
+        gfa_to_handle_graph_add_paths(filename, unseekable, graph, gg, id_map_info);
 
-    if (has_rgfa_tags) {
-        gfa_to_handle_graph_add_rgfa_paths(filename, unseekable, nullptr, graph, gg, id_map_info, max_rgfa_rank);
+        if (has_rgfa_tags) {
+            gfa_to_handle_graph_add_rgfa_paths(filename, unseekable, nullptr, graph, gg, id_map_info, max_rgfa_rank);
+        }
     }
 
     write_gfa_translation(id_map_info, translation_filename);
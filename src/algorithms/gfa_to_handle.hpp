@@ -23,6 +23,10 @@ struct GFAFormatError : std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
+/// How many bytes of GFA lines should one thread parse at a time, by default,
+/// when loading a file in parallel?
+const size_t DEFAULT_GFA_BLOCK_SIZE = 8 * 1024 * 1024;
+
 /// Read a GFA file for a blunt-ended graph into a HandleGraph. Give "-" as a filename for stdin.
 ///
 /// Optionally tries read the GFA from disk without creating an in-memory representation (defaults to
@@ -31,6 +35,10 @@ struct GFAFormatError : std::runtime_error {
 /// Also optionally provides a hint about the node ID range to the handle graph implementation before
 /// constructing it (defaults to no hint if reading from stdin).
 ///
+/// A GFA read from a regular file on disk is memory-mapped and parsed in parallel over all OpenMP
+/// threads, in blocks of about block_size bytes. Node IDs come out the same as they would reading it
+/// sequentially.
+///
 /// Throws GFAFormatError if the GFA file is not acceptable, and
 /// std::ios_base::failure if an IO operation fails. Throws invalid_argument if
 /// otherwise misused.
@@ -38,7 +46,8 @@ void gfa_to_handle_graph(const string& filename,
                          MutableHandleGraph* graph,
                          bool try_from_disk = true,
                          bool try_id_increment_hint = false,
-                         const string& translation_filename = "");
+                         const string& translation_filename = "",
+                         size_t block_size = DEFAULT_GFA_BLOCK_SIZE);
 
 /// Same as gfa_to_handle_graph but also adds path elements from the GFA to the graph
 void gfa_to_path_handle_graph(const string& filename,
@@ -46,7 +55,8 @@ void gfa_to_path_handle_graph(const string& filename,
                               bool try_from_disk = true,
                               bool try_id_increment_hint = false,
                               int64_t max_rgfa_rank = numeric_limits<int64_t>::max(),
-                              const string& translation_filename = "");
+                              const string& translation_filename = "",
+                              size_t block_size = DEFAULT_GFA_BLOCK_SIZE);
                               
 /// Same as above but operating on a stream. Assumed to be non-seekable; all conversion happens in memory.
 /// Always streaming. Doesn't support ID increment hints.
@@ -19,6 +19,8 @@ using namespace vg::io;
 
 static const double quality_scale_factor = 10.0 / log(10.0);
 static const double exp_overflow_limit = log(std::numeric_limits<double>::max());
+// largest scratch tables for building GSSW graphs that we keep between calls
+static const size_t max_reused_gssw_table_size = 1 << 16;
 
 GSSWAligner::~GSSWAligner(void) {
     free(nt_table);
@@ -47,34 +49,56 @@ GSSWAligner::GSSWAligner(const int8_t* _score_matrix,
 
 gssw_graph* GSSWAligner::create_gssw_graph(const HandleGraph& g) const {
     
+    // these are reused between calls on the same thread, so that aligning
+    // many small subgraphs doesn't keep reallocating them
+    thread_local vector<gssw_node*> nodes_by_offset;
+    thread_local unordered_map<int64_t, gssw_node*> nodes_by_id;
+    thread_local string cleaned_seq;
+    
     vector<handle_t> topological_order = handlealgs::lazier_topological_order(&g);
     
     gssw_graph* graph = gssw_graph_create(g.get_node_count());
-    unordered_map<int64_t, gssw_node*> nodes;
+    
+    // if the IDs are reasonably compact, we can find nodes by offset from the
+    // min ID instead of hashing
+    int64_t min_id = g.min_node_id();
+    bool dense_ids = !topological_order.empty() && g.max_node_id() - min_id < 4 * (int64_t) topological_order.size();
+    if (dense_ids) {
+        nodes_by_offset.assign(g.max_node_id() - min_id + 1, nullptr);
+    }
+    // otherwise nodes_by_id was left empty by the last call
+    auto lookup_node = [&](int64_t node_id) -> gssw_node*& {
+        return dense_ids ? nodes_by_offset[node_id - min_id] : nodes_by_id[node_id];
+    };
     
     // compute the topological order
     for (const handle_t& handle : topological_order) {
-        auto cleaned_seq = nonATGCNtoN(g.get_sequence(handle));
+        cleaned_seq = g.get_sequence(handle);
+        for (char& c : cleaned_seq) {
+            if (c != 'A' && c != 'T' && c != 'G' && c != 'C' && c != 'N') {
+                c = 'N';
+            }
+        }
         gssw_node* node = gssw_node_create(nullptr,       // TODO: the ID should be enough, don't need Node* too
                                            g.get_id(handle),
                                            cleaned_seq.c_str(),
                                            nt_table,
                                            score_matrix); // TODO: this arg isn't used, could edit
                                                           // in gssw
-        nodes[node->id] = node;
+        lookup_node(node->id) = node;
         gssw_graph_add_node(graph, node);
     }
     
     g.for_each_edge([&](const edge_t& edge) {
         if(!g.get_is_reverse(edge.first) && !g.get_is_reverse(edge.second)) {
             // This is a normal end to start edge.
-            gssw_nodes_add_edge(nodes[g.get_id(edge.first)], nodes[g.get_id(edge.second)]);
+            gssw_nodes_add_edge(lookup_node(g.get_id(edge.first)), lookup_node(g.get_id(edge.second)));
         }
         else if (g.get_is_reverse(edge.first) && g.get_is_reverse(edge.second)) {
             // This is a start to end edge, but isn't reversing and can be converted to a normal end to start edge.
             
             // Flip the start and end
-            gssw_nodes_add_edge(nodes[g.get_id(edge.second)], nodes[g.get_id(edge.first)]);
+            gssw_nodes_add_edge(lookup_node(g.get_id(edge.second)), lookup_node(g.get_id(edge.first)));
         }
         else {
             // TODO: It's a reversing edge, which gssw doesn't support yet. What
@@ -98,6 +122,27 @@ gssw_graph* GSSWAligner::create_gssw_graph(const HandleGraph& g) const {
         return true;
     });
     
+    if (!dense_ids) {
+        // erasing just our own nodes costs time in proportion to this graph,
+        // whereas clear() would have to visit every bucket left over from
+        // the biggest graph yet
+        for (const handle_t& handle : topological_order) {
+            nodes_by_id.erase(g.get_id(handle));
+        }
+    }
+    
+    // don't hold onto the memory from one unusually large graph for the life
+    // of the thread
+    if (nodes_by_offset.capacity() > max_reused_gssw_table_size) {
+        vector<gssw_node*>().swap(nodes_by_offset);
+    }
+    if (nodes_by_id.bucket_count() > max_reused_gssw_table_size) {
+        unordered_map<int64_t, gssw_node*>().swap(nodes_by_id);
+    }
+    if (cleaned_seq.capacity() > max_reused_gssw_table_size) {
+        string().swap(cleaned_seq);
+    }
+    
     return graph;
     
 }
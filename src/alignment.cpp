@@ -1,5 +1,6 @@
 #include "alignment.hpp"
 #include "vg/io/gafkluge.hpp"
+#include "read_scheduler.hpp"
 
 #include <sstream>
 
@@ -94,20 +95,22 @@ bam_hdr_t* hts_file_header(string& filename, string& header) {
 
 bam_hdr_t* hts_string_header(string& header,
                              const map<string, int64_t>& path_length,
-                             const map<string, string>& rg_sample) {
+                             const map<string, string>& rg_sample,
+                             bool coordinate_sorted) {
     
     // Copy the map into a vecotr in its own order
     vector<pair<string, int64_t>> path_order_and_length(path_length.begin(), path_length.end());
     
     // Make header in that order.
-    return hts_string_header(header, path_order_and_length, rg_sample);
+    return hts_string_header(header, path_order_and_length, rg_sample, coordinate_sorted);
 }
 
 bam_hdr_t* hts_string_header(string& header,
                              const vector<pair<string, int64_t>>& path_order_and_length,
-                             const map<string, string>& rg_sample) {
+                             const map<string, string>& rg_sample,
+                             bool coordinate_sorted) {
     stringstream hdr;
-    hdr << "@HD\tVN:1.5\tSO:unknown\n";
+    hdr << "@HD\tVN:1.5\tSO:" << (coordinate_sorted ? "coordinate" : "unknown") << "\n";
     for (auto& p : path_order_and_length) {
         hdr << "@SQ\tSN:" << p.first << "\t" << "LN:" << p.second << "\n";
     }
@@ -178,7 +181,8 @@ bool get_next_alignment_pair_from_fastqs(gzFile fp1, gzFile fp2, char* buffer, s
     return get_next_alignment_from_fastq(fp1, buffer, len, mate1) && get_next_alignment_from_fastq(fp2, buffer, len, mate2);
 }
 
-size_t fastq_unpaired_for_each_parallel(const string& filename, function<void(Alignment&)> lambda) {
+size_t fastq_unpaired_for_each_parallel(const string& filename, function<void(Alignment&)> lambda,
+                                        ReadBatchScheduler* scheduler) {
     
     gzFile fp = (filename != "-") ? gzopen(filename.c_str(), "r") : gzdopen(fileno(stdin), "r");
     if (!fp) {
@@ -193,7 +197,8 @@ size_t fastq_unpaired_for_each_parallel(const string& filename, function<void(Al
     };
     
     
-    size_t nLines = unpaired_for_each_parallel(get_read, lambda);
+    size_t nLines = scheduler ? scheduler->for_each_parallel(get_read, lambda) :
+                                unpaired_for_each_parallel(get_read, lambda);
     
     delete[] buf;
     gzclose(fp);
@@ -211,7 +216,8 @@ size_t fastq_paired_two_files_for_each_parallel(const string& file1, const strin
     
 size_t fastq_paired_interleaved_for_each_parallel_after_wait(const string& filename,
                                                              function<void(Alignment&, Alignment&)> lambda,
-                                                             function<bool(void)> single_threaded_until_true) {
+                                                             function<bool(void)> single_threaded_until_true,
+                                                             ReadBatchScheduler* scheduler) {
     
     gzFile fp = (filename != "-") ? gzopen(filename.c_str(), "r") : gzdopen(fileno(stdin), "r");
     if (!fp) {
@@ -225,7 +231,8 @@ size_t fastq_paired_interleaved_for_each_parallel_after_wait(const string& filen
         return get_next_interleaved_alignment_pair_from_fastq(fp, buf, len, mate1, mate2);
     };
     
-    size_t nLines = paired_for_each_parallel_after_wait(get_pair, lambda, single_threaded_until_true);
+    size_t nLines = scheduler ? scheduler->for_each_pair_parallel_after_wait(get_pair, lambda, single_threaded_until_true) :
+                                paired_for_each_parallel_after_wait(get_pair, lambda, single_threaded_until_true);
     
     delete[] buf;
     gzclose(fp);
@@ -234,7 +241,8 @@ size_t fastq_paired_interleaved_for_each_parallel_after_wait(const string& filen
     
 size_t fastq_paired_two_files_for_each_parallel_after_wait(const string& file1, const string& file2,
                                                            function<void(Alignment&, Alignment&)> lambda,
-                                                           function<bool(void)> single_threaded_until_true) {
+                                                           function<bool(void)> single_threaded_until_true,
+                                                           ReadBatchScheduler* scheduler) {
     
     gzFile fp1 = (file1 != "-") ? gzopen(file1.c_str(), "r") : gzdopen(fileno(stdin), "r");
     if (!fp1) {
@@ -252,7 +260,8 @@ size_t fastq_paired_two_files_for_each_parallel_after_wait(const string& file1,
         return get_next_alignment_pair_from_fastqs(fp1, fp2, buf, len, mate1, mate2);
     };
     
-    size_t nLines = paired_for_each_parallel_after_wait(get_pair, lambda, single_threaded_until_true);
+    size_t nLines = scheduler ? scheduler->for_each_pair_parallel_after_wait(get_pair, lambda, single_threaded_until_true) :
+                                paired_for_each_parallel_after_wait(get_pair, lambda, single_threaded_until_true);
     
     delete[] buf;
     gzclose(fp1);
@@ -18,6 +18,8 @@
 
 namespace vg {
 
+class ReadBatchScheduler;
+
 const char* const BAM_DNA_LOOKUP = "=ACMGRSVTWYHKDBN";
 
 int hts_for_each(string& filename, function<void(Alignment&)> lambda);
@@ -37,30 +39,37 @@ size_t fastq_unpaired_for_each(const string& filename, function<void(Alignment&)
 size_t fastq_paired_interleaved_for_each(const string& filename, function<void(Alignment&, Alignment&)> lambda);
 size_t fastq_paired_two_files_for_each(const string& file1, const string& file2, function<void(Alignment&, Alignment&)> lambda);
 // parallel versions of above
+// If a ReadBatchScheduler is provided, it hands the reads out to the threads;
+// otherwise they are handed out as OpenMP tasks.
 size_t fastq_unpaired_for_each_parallel(const string& filename,
-                                        function<void(Alignment&)> lambda);
+                                        function<void(Alignment&)> lambda,
+                                        ReadBatchScheduler* scheduler = nullptr);
     
 size_t fastq_paired_interleaved_for_each_parallel(const string& filename,
                                                   function<void(Alignment&, Alignment&)> lambda);
     
 size_t fastq_paired_interleaved_for_each_parallel_after_wait(const string& filename,
                                                              function<void(Alignment&, Alignment&)> lambda,
-                                                             function<bool(void)> single_threaded_until_true);
+                                                             function<bool(void)> single_threaded_until_true,
+                                                             ReadBatchScheduler* scheduler = nullptr);
     
 size_t fastq_paired_two_files_for_each_parallel(const string& file1, const string& file2,
                                                 function<void(Alignment&, Alignment&)> lambda);
     
 size_t fastq_paired_two_files_for_each_parallel_after_wait(const string& file1, const string& file2,
                                                            function<void(Alignment&, Alignment&)> lambda,
-                                                           function<bool(void)> single_threaded_until_true);
+                                                           function<bool(void)> single_threaded_until_true,
+                                                           ReadBatchScheduler* scheduler = nullptr);
 
 bam_hdr_t* hts_file_header(string& filename, string& header);
 bam_hdr_t* hts_string_header(string& header,
                              const map<string, int64_t>& path_length,
-                             const map<string, string>& rg_sample);
+                             const map<string, string>& rg_sample,
+                             bool coordinate_sorted = false);
 bam_hdr_t* hts_string_header(string& header,
                              const vector<pair<string, int64_t>>& path_order_and_length,
-                             const map<string, string>& rg_sample);
+                             const map<string, string>& rg_sample,
+                             bool coordinate_sorted = false);
 void write_alignment_to_file(const Alignment& aln, const string& filename);
 
 void mapping_cigar(const Mapping& mapping, vector<pair<int, char> >& cigar);
@@ -21,6 +21,19 @@
 
 namespace vg {
 
+/// Largest matrix backing memory, in cells, that we keep around for reuse
+static const size_t max_pooled_matrix_cells = 1 << 20;
+/// Most matrix backing memories that we keep around for reuse on one thread
+static const size_t max_pooled_matrices = 256;
+/// Most bytes of matrix backing memory that we keep around for reuse on one thread
+static const size_t max_pooled_bytes = 32 * 1024 * 1024;
+
+template<class IntType>
+thread_local vector<vector<IntType>> BandedGlobalAligner<IntType>::BAMatrix::storage_pool;
+
+template<class IntType>
+thread_local size_t BandedGlobalAligner<IntType>::BAMatrix::pooled_bytes = 0;
+
 template<class IntType>
 BandedGlobalAligner<IntType>::BABuilder::BABuilder(Alignment& alignment) :
                                                    alignment(alignment),
@@ -231,9 +244,13 @@ BandedGlobalAligner<IntType>::BAMatrix::~BAMatrix() {
 #ifdef debug_banded_aligner_objects
     cerr << "[BAMatrix::~BAMatrix] destructing matrix for handle " << handlegraph::as_integer(node) << endl;
 #endif
-    free(match);
-    free(insert_row);
-    free(insert_col);
+    // give the memory back for the next matrix on this thread
+    size_t storage_bytes = storage.capacity() * sizeof(IntType);
+    if (storage.capacity() > 0 && storage.capacity() <= max_pooled_matrix_cells
+        && storage_pool.size() < max_pooled_matrices && pooled_bytes + storage_bytes <= max_pooled_bytes) {
+        pooled_bytes += storage_bytes;
+        storage_pool.emplace_back(std::move(storage));
+    }
 }
 
 template <class IntType>
@@ -257,53 +274,46 @@ void BandedGlobalAligner<IntType>::BAMatrix::fill_matrix(const HandleGraph& grap
     const string& read = alignment.sequence();
     const string& base_quality = alignment.quality();
     
-    match = (IntType*) malloc(sizeof(IntType) * band_size);
-    insert_col = (IntType*) malloc(sizeof(IntType) * band_size);
-    insert_row = (IntType*) malloc(sizeof(IntType) * band_size);
-    if (!match || !insert_col || !insert_row) {
-        // An allocation has failed.
-        // We may have run out of virtual memory.
-        
-#ifdef debug_jemalloc
-        size_t requested_size = sizeof(IntType) * band_size;
-        size_t usable_size[3] = {0, 0, 0};
-#endif
-        
-        // Free up what we are holding, and also report how much usable mamoey jemalloc gave us for anything that passed.
-        if (match) {
-#ifdef debug_jemalloc
-            usable_size[0] = malloc_usable_size(match);
-#endif
-            free(match);
-        }
-        if (insert_col) {
-#ifdef debug_jemalloc
-            usable_size[1] = malloc_usable_size(insert_col);
-#endif
-            free(insert_col);
+    // always have some memory, so a filled matrix is never null
+    size_t storage_cells = max<int64_t>(3 * band_size, 1);
+    
+    // reuse the smallest memory from an earlier matrix that's big enough, without
+    // clearing it, since every cell in the band gets written before it is read
+    size_t best_fit = storage_pool.size();
+    for (size_t i = 0; i < storage_pool.size(); ++i) {
+        if (storage_pool[i].capacity() >= storage_cells
+            && (best_fit == storage_pool.size() || storage_pool[i].capacity() < storage_pool[best_fit].capacity())) {
+            best_fit = i;
         }
-        if (insert_row) {
-#ifdef debug_jemalloc
-            usable_size[2] = malloc_usable_size(insert_row);
-#endif
-            free(insert_row);
+    }
+    if (best_fit < storage_pool.size()) {
+        storage = std::move(storage_pool[best_fit]);
+        pooled_bytes -= storage.capacity() * sizeof(IntType);
+        storage_pool[best_fit] = std::move(storage_pool.back());
+        storage_pool.pop_back();
+    }
+    try {
+        // if nothing was big enough, this makes fresh memory rather than growing
+        // (and copying) a smaller one
+        if (storage.size() < storage_cells) {
+            storage.resize(storage_cells);
         }
-        
+    }
+    catch (const std::bad_alloc& e) {
+        // We may have run out of virtual memory.
         cerr << "[BAMatrix::fill_matrix]: failed to allocate matrices of height " << band_height << " and width " << ncols << " for a total cell count of " << band_size << endl;
-#ifdef debug_jemalloc
-        cerr << "[BAMatrix::fill_matrix]: requested: " << requested_size << " actually obtained: " << usable_size[0] << " " << usable_size[1] << " " << usable_size[2] << endl;
-#endif
-        cerr << "[BAMatrix::fill_matrix]: is alignment problem too big for your virtual or physical memory?" << endl;
-        
 #ifdef debug_jemalloc
         // Dump the stats from the allocator.
-        // TODO: skip when not building with jemalloc somehow.
         malloc_stats_print(nullptr, nullptr, "");
 #endif
+        cerr << "[BAMatrix::fill_matrix]: is alignment problem too big for your virtual or physical memory?" << endl;
         
         // Bail out relatively safely
-        throw std::bad_alloc();
+        throw;
     }
+    match = storage.data();
+    insert_col = match + band_size;
+    insert_row = insert_col + band_size;
     
     /* these represent a band in a matrix, but we store it as a rectangle with chopped
      * corners
@@ -660,30 +670,45 @@ void BandedGlobalAligner<IntType>::BAMatrix::fill_matrix(const HandleGraph& grap
         }
         
         
-        for (int64_t i = iter_start + 1; i < iter_stop - 1; i++) {
-            // indices of the current and previous cells in the rectangularized band
-            idx = i * ncols + j;
-            up_idx = (i - 1) * ncols + j;
-            diag_idx = i * ncols + (j - 1);
-            left_idx = (i + 1) * ncols + (j - 1);
-            
-            if (qual_adjusted) {
-                match_score = score_mat[25 * base_quality[i + top_diag + j] + 5 * nt_table[node_seq[j]] + nt_table[read[i + top_diag + j]]];
+        // the match and column insert matrices only depend on the previous column, so
+        // we can fill them for the whole interior without a dependency between cells
+        const int8_t* node_score_mat = score_mat + 5 * nt_table[node_seq[j]];
+        int64_t read_offset = top_diag + j;
+        if (qual_adjusted) {
+#pragma omp simd
+            for (int64_t i = iter_start + 1; i < iter_stop - 1; i++) {
+                int64_t idx = i * ncols + j;
+                int64_t diag_idx = idx - 1;
+                int64_t left_idx = idx + ncols - 1;
+                IntType match_score = node_score_mat[25 * base_quality[read_offset + i] + nt_table[read[read_offset + i]]];
+                match[idx] = match_score + max(max(match[diag_idx], insert_row[diag_idx]), insert_col[diag_idx]);
+                insert_col[idx] = max(max(match[left_idx] - gap_open, insert_row[left_idx] - gap_open),
+                                      insert_col[left_idx] - gap_extend);
             }
-            else {
-                match_score = score_mat[5 * nt_table[node_seq[j]] + nt_table[read[i + top_diag + j]]];
+        }
+        else {
+#pragma omp simd
+            for (int64_t i = iter_start + 1; i < iter_stop - 1; i++) {
+                int64_t idx = i * ncols + j;
+                int64_t diag_idx = idx - 1;
+                int64_t left_idx = idx + ncols - 1;
+                IntType match_score = node_score_mat[nt_table[read[read_offset + i]]];
+                match[idx] = match_score + max(max(match[diag_idx], insert_row[diag_idx]), insert_col[diag_idx]);
+                insert_col[idx] = max(max(match[left_idx] - gap_open, insert_row[left_idx] - gap_open),
+                                      insert_col[left_idx] - gap_extend);
             }
-            
-            match[idx] = match_score + max(max(match[diag_idx], insert_row[diag_idx]), insert_col[diag_idx]);
+        }
+        
+        // the row insert matrix depends on the cell above, so it goes one cell at a time
+        for (int64_t i = iter_start + 1; i < iter_stop - 1; i++) {
+            idx = i * ncols + j;
+            up_idx = idx - ncols;
             
             insert_row[idx] = max(max(match[up_idx] - gap_open, insert_row[up_idx] - gap_extend),
                                   insert_col[up_idx] - gap_open);
             
-            insert_col[idx] = max(max(match[left_idx] - gap_open, insert_row[left_idx] - gap_open),
-                                  insert_col[left_idx] - gap_extend);
-            
 #ifdef debug_banded_aligner_fill_matrix
-            cerr << "[BAMatrix::fill_matrix]: in interior of matrix at rectangle coords (" << i << ", " << j << "), match score of node char " << j << " (" << node_seq[j] << ") and read char " << i + top_diag + j << " (" << read[i + top_diag + j] << ") is " << (int) match_score << ", leading gap length is " << cumulative_seq_len + j << " for total match matrix score of " << (int) match[idx] << endl;
+            cerr << "[BAMatrix::fill_matrix]: in interior of matrix at rectangle coords (" << i << ", " << j << "), match score of node char " << j << " (" << node_seq[j] << ") and read char " << i + top_diag + j << " (" << read[i + top_diag + j] << ") is " << (int) node_score_mat[nt_table[read[read_offset + i]]] << ", leading gap length is " << cumulative_seq_len + j << " for total match matrix score of " << (int) match[idx] << endl;
 #endif
         }
         
@@ -203,6 +203,15 @@ namespace vg {
         /// DP matrix
         IntType* insert_row;
         
+        /// Backing memory for all three DP matrices
+        vector<IntType> storage;
+        
+        /// Backing memory released by earlier matrices on this thread, to be
+        /// reused so that repeated alignments don't allocate for every node
+        static thread_local vector<vector<IntType>> storage_pool;
+        /// The total size of the memory in storage_pool
+        static thread_local size_t pooled_bytes;
+        
         /// Debugging function
         void print_matrix(const HandleGraph& graph, matrix_t which_mat);
         /// Debugging function
@@ -0,0 +1,182 @@
+/**
+ * \file batch_pinned_scorer.cpp
+ *
+ * Implements the inter-sequence vectorized pinned alignment scorer.
+ */
+
+#include "batch_pinned_scorer.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace vg {
+
+using namespace std;
+
+// Far enough below any real score that it never wins, and far enough above
+// the minimum int32_t that subtracting penalties from it can't wrap.
+static const int32_t NEGATIVE_INFINITY = numeric_limits<int32_t>::min() / 4;
+
+// Maximum and minimum by value. std::max and std::min work through
+// references, which can keep the compiler from vectorizing the lane loops.
+static inline int32_t lane_max(int32_t a, int32_t b) {
+    return a > b ? a : b;
+}
+
+static inline int32_t lane_min(int32_t a, int32_t b) {
+    return a < b ? a : b;
+}
+
+BatchPinnedScorer::BatchPinnedScorer(const int8_t* score_matrix, int8_t gap_open, int8_t gap_extension,
+                                     int8_t full_length_bonus) :
+    gap_open(gap_open), gap_extension(gap_extension), full_length_bonus(full_length_bonus) {
+
+    int32_t best = score_matrix[0];
+    for (size_t i = 0; i < 16; i++) {
+        best = max<int32_t>(best, score_matrix[i]);
+    }
+    for (size_t i = 0; i < 5; i++) {
+        for (size_t j = 0; j < 5; j++) {
+            substitution[i * 5 + j] = (i == 4 || j == 4) ? best : score_matrix[i * 4 + j];
+        }
+    }
+}
+
+size_t BatchPinnedScorer::char_class(char c) {
+    switch (c) {
+    case 'A':
+    case 'a':
+        return 0;
+    case 'C':
+    case 'c':
+        return 1;
+    case 'G':
+    case 'g':
+        return 2;
+    case 'T':
+    case 't':
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+vector<int32_t> BatchPinnedScorer::score(const string& query, const vector<string>& targets) const {
+    vector<int32_t> scores(targets.size(), 0);
+    for (size_t first = 0; first < targets.size(); first += LANES) {
+        score_batch(query, targets, first, scores);
+    }
+    return scores;
+}
+
+void BatchPinnedScorer::score_batch(const string& query, const vector<string>& targets, size_t first,
+                                    vector<int32_t>& scores) const {
+
+    size_t lanes = min(LANES, targets.size() - first);
+    size_t width = 0;
+    for (size_t lane = 0; lane < lanes; lane++) {
+        width = max(width, targets[first + lane].size());
+    }
+
+    // For each query character class, the substitution score at each target
+    // position in each lane, laid out position-major so a position's lanes
+    // are contiguous. Positions past the end of a lane's target score so
+    // badly that nothing there is ever the best.
+    vector<int32_t> profile(5 * width * LANES, NEGATIVE_INFINITY);
+    // And a cap on each cell, to keep gaps from running off the end of a
+    // target, where nothing else would stop them.
+    vector<int32_t> cap(width * LANES, NEGATIVE_INFINITY);
+    for (size_t lane = 0; lane < lanes; lane++) {
+        const string& target = targets[first + lane];
+        for (size_t j = 0; j < target.size(); j++) {
+            size_t target_class = char_class(target[j]);
+            for (size_t query_class = 0; query_class < 5; query_class++) {
+                profile[(query_class * width + j) * LANES + lane] = substitution[query_class * 5 + target_class];
+            }
+            cap[j * LANES + lane] = numeric_limits<int32_t>::max();
+        }
+    }
+
+    // Rows of the matrix, for the query read so far. Column 0 (before the
+    // target) is kept separately, since it is the same in every lane.
+    // H is the best score ending at a cell, and F the best ending in a gap
+    // in the target (consuming query).
+    vector<int32_t> h_row(width * LANES);
+    vector<int32_t> f_row(width * LANES, NEGATIVE_INFINITY);
+    // Best score seen in each lane. Aligning nothing scores 0.
+    int32_t best[LANES];
+    // E is the best score ending in a gap in the query (consuming target),
+    // carried along the row.
+    int32_t e[LANES];
+    // The cell diagonally up and left of the current one
+    int32_t diagonal[LANES];
+    // The cell to the left of the current one
+    int32_t left[LANES];
+
+    for (size_t lane = 0; lane < LANES; lane++) {
+        best[lane] = 0;
+    }
+
+    // Row 0 is all deletions from the pinned corner.
+    for (size_t j = 0; j < width; j++) {
+        int32_t deletion = -gap_open - (int32_t) j * gap_extension;
+        for (size_t lane = 0; lane < LANES; lane++) {
+            h_row[j * LANES + lane] = min(deletion, cap[j * LANES + lane]);
+        }
+    }
+
+    // Keep the penalties in locals, so the compiler knows the stores below
+    // can't change them.
+    const int32_t open = gap_open;
+    const int32_t extend = gap_extension;
+
+    for (size_t i = 0; i < query.size(); i++) {
+        const int32_t* query_profile = profile.data() + char_class(query[i]) * width * LANES;
+        // Column 0 is all insertions from the pinned corner.
+        int32_t insertion = -gap_open - (int32_t) i * gap_extension;
+        for (size_t lane = 0; lane < LANES; lane++) {
+            diagonal[lane] = i == 0 ? 0 : insertion + gap_extension;
+            left[lane] = insertion;
+            e[lane] = NEGATIVE_INFINITY;
+        }
+
+        for (size_t j = 0; j < width; j++) {
+            int32_t* h = h_row.data() + j * LANES;
+            int32_t* f = f_row.data() + j * LANES;
+            const int32_t* substitution_scores = query_profile + j * LANES;
+            const int32_t* cell_cap = cap.data() + j * LANES;
+#pragma omp simd
+            for (size_t lane = 0; lane < LANES; lane++) {
+                int32_t up = h[lane];
+                int32_t gap_left = lane_max(left[lane] - open, e[lane] - extend);
+                int32_t gap_up = lane_max(up - open, f[lane] - extend);
+                int32_t here = lane_max(diagonal[lane] + substitution_scores[lane], lane_max(gap_left, gap_up));
+                here = lane_min(here, cell_cap[lane]);
+                best[lane] = lane_max(best[lane], here);
+                e[lane] = gap_left;
+                f[lane] = gap_up;
+                diagonal[lane] = up;
+                left[lane] = here;
+                h[lane] = here;
+            }
+        }
+    }
+
+    // Alignments reaching the end of the query get the full length bonus.
+    // The last row is in h_row, and an alignment that uses no target at all
+    // is all insertions.
+    for (size_t lane = 0; lane < lanes; lane++) {
+        if (!query.empty()) {
+            int32_t all_insertions = -gap_open - ((int32_t) query.size() - 1) * gap_extension;
+            best[lane] = max(best[lane], all_insertions + full_length_bonus);
+        } else {
+            best[lane] = max(best[lane], full_length_bonus);
+        }
+        for (size_t j = 0; j < targets[first + lane].size(); j++) {
+            best[lane] = max(best[lane], h_row[j * LANES + lane] + full_length_bonus);
+        }
+        scores[first + lane] = best[lane];
+    }
+}
+
+}
@@ -0,0 +1,72 @@
+#ifndef VG_BATCH_PINNED_SCORER_HPP_INCLUDED
+#define VG_BATCH_PINNED_SCORER_HPP_INCLUDED
+
+/**
+ * \file batch_pinned_scorer.hpp
+ *
+ * Defines an inter-sequence vectorized scorer for batches of small pinned
+ * alignment problems, such as a read tail against each path of its tail
+ * forest.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vg {
+
+using namespace std;
+
+/**
+ * Computes the scores of the best alignments of a query against many short
+ * targets, with the alignment pinned at the start of both, but free to stop
+ * anywhere. Reaching the end of the query earns the full length bonus.
+ *
+ * Tail alignment problems are individually too small to fill a vector
+ * register with one sequence, so instead each of LANES targets gets its own
+ * lane, and the lanes all advance through the dynamic programming matrix
+ * together. The inner loops run over lanes, in plain C++ that the compiler
+ * can vectorize for whatever instruction set it targets.
+ *
+ * Scores are computed with full (unbanded) affine gap dynamic programming, so
+ * they are at least as good as what an X-drop aligner can find. Any pair
+ * involving a non-ACGT character scores as well as the best entry in the score
+ * matrix, so the scores are upper bounds for alignments that score Ns lower.
+ */
+class BatchPinnedScorer {
+public:
+
+    /// How many targets are scored together
+    static const size_t LANES = 16;
+
+    /// Make a scorer using the given 4x4 ACGT score matrix, and affine gap
+    /// penalties where a gap of length L costs gap_open + (L - 1) *
+    /// gap_extension.
+    BatchPinnedScorer(const int8_t* score_matrix, int8_t gap_open, int8_t gap_extension,
+                      int8_t full_length_bonus);
+
+    /// Get the best pinned alignment score of the query against each target.
+    /// Scores are never negative, since aligning nothing scores 0.
+    vector<int32_t> score(const string& query, const vector<string>& targets) const;
+
+private:
+
+    /// Score one batch of up to LANES targets, starting at the given index,
+    /// into the corresponding entries of scores.
+    void score_batch(const string& query, const vector<string>& targets, size_t first,
+                     vector<int32_t>& scores) const;
+
+    /// Get the character class (0-3 for ACGT, 4 for anything else) of a base.
+    static size_t char_class(char c);
+
+    /// Substitution scores, indexed by query class * 5 + target class
+    int32_t substitution[25];
+
+    int32_t gap_open;
+    int32_t gap_extension;
+    int32_t full_length_bonus;
+};
+
+}
+
+#endif
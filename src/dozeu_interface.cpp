@@ -682,7 +682,8 @@ void DozeuInterface::align(Alignment& alignment, const HandleGraph& graph, const
     
 void DozeuInterface::align_downward(Alignment& alignment, const OrderedGraph& graph, const vector<graph_pos_s>& head_positions,
                                     bool left_to_right, vector<const dz_forefront_s*>& forefronts,
-                                    int8_t full_length_bonus, uint16_t max_gap_length)
+                                    int8_t full_length_bonus, uint16_t max_gap_length,
+                                    const dz_query_s* packed_query)
 { 
 
     // we're now allowing multiple graph start positions, but not multiple read start positions
@@ -701,8 +702,8 @@ void DozeuInterface::align_downward(Alignment& alignment, const OrderedGraph& gr
         pack_qual = (const uint8_t*) (left_to_right ? query_qual.c_str() + head_positions.front().query_offset : query_qual.c_str());
     }
     
-	// pack query (downward)
-	const dz_query_s* packed_query_seq_dn = (left_to_right
+	// pack query (downward), unless we were given it
+	const dz_query_s* packed_query_seq_dn = packed_query != nullptr ? packed_query : (left_to_right
 		? pack_query_forward(pack_seq, pack_qual, full_length_bonus, qlen - head_positions.front().query_offset)
 		: pack_query_reverse(pack_seq, pack_qual, full_length_bonus, head_positions.front().query_offset)
 	);
@@ -713,8 +714,63 @@ void DozeuInterface::align_downward(Alignment& alignment, const OrderedGraph& gr
                                         forefronts, max_gap_length),
                                  left_to_right, forefronts);
     
-    // clear the memory
-	flush();
+    if (packed_query == nullptr) {
+        // clear the memory
+        flush_memory();
+    }
+}
+
+// Enough for many small tail alignments, while staying well inside the
+// memory a single large one can use.
+const size_t DozeuInterface::MAX_QUERY_CACHE_CELLS = 1024 * 1024;
+
+const dz_query_s* DozeuInterface::get_pinned_query(const Alignment& alignment, bool left_to_right, int8_t full_length_bonus)
+{
+    if (query_cache.query != nullptr && query_cache.left_to_right == left_to_right
+        && query_cache.full_length_bonus == full_length_bonus
+        && query_cache.sequence == alignment.sequence() && query_cache.quality == alignment.quality()) {
+        // We can use the query we already have
+        reused_queries++;
+        return query_cache.query;
+    }
+    
+    // Get rid of the old query and everything aligned against it
+    flush_memory();
+    
+    // Pack from our own copies, which live as long as the query does
+    query_cache.sequence = alignment.sequence();
+    query_cache.quality = alignment.quality();
+    query_cache.full_length_bonus = full_length_bonus;
+    query_cache.left_to_right = left_to_right;
+    
+    const uint8_t* pack_qual = nullptr;
+    if (!query_cache.quality.empty()) {
+        pack_qual = (const uint8_t*) query_cache.quality.c_str();
+    }
+    query_cache.query = (left_to_right
+        ? pack_query_forward(query_cache.sequence.c_str(), pack_qual, full_length_bonus, query_cache.sequence.size())
+        : pack_query_reverse(query_cache.sequence.c_str(), pack_qual, full_length_bonus, query_cache.sequence.size())
+    );
+    packed_queries++;
+    
+    return query_cache.query;
+}
+
+void DozeuInterface::flush_memory()
+{
+    flush();
+    query_cache.query = nullptr;
+    query_cache.cells = 0;
+}
+
+size_t DozeuInterface::packed_query_count() const
+{
+    return packed_queries;
+}
+
+size_t DozeuInterface::reused_query_count() const
+{
+    return reused_queries;
 }
 
 void DozeuInterface::align_pinned(Alignment& alignment, const HandleGraph& g, bool pin_left,
@@ -757,8 +813,23 @@ void DozeuInterface::align_pinned(Alignment& alignment, const HandleGraph& g, bo
     // construct node_id -> index mapping table
     vector<const dz_forefront_s*> forefronts(ordered.order.size(), nullptr);
     
+    // The whole sequence is aligned, so we may be able to reuse the query
+    // from the last pinned alignment.
+    const dz_query_s* packed_query = get_pinned_query(alignment, pin_left, full_length_bonus);
+    
     // Do the left-to-right alignment from the fixed head_pos seed, and then do the traceback.
-    align_downward(alignment, ordered, head_positions, pin_left, forefronts, full_length_bonus, max_gap_length);
+    align_downward(alignment, ordered, head_positions, pin_left, forefronts, full_length_bonus, max_gap_length,
+                   packed_query);
+    
+    // Keep dozeu's memory, and the query in it, unless we've used a lot.
+    size_t graph_length = 0;
+    for (const handle_t& handle : order) {
+        graph_length += g.get_length(handle);
+    }
+    query_cache.cells += graph_length * alignment.sequence().size();
+    if (query_cache.cells >= MAX_QUERY_CACHE_CELLS) {
+        flush_memory();
+    }
 }
 
 /**
@@ -114,6 +114,13 @@ public:
     void align_pinned(Alignment& alignment, const HandleGraph& g, bool pin_left,
                       int8_t full_length_bonus, uint16_t max_gap_length = default_xdrop_max_gap_length);
     
+    /// Get the number of times a query has been packed for a pinned alignment.
+    size_t packed_query_count() const;
+    
+    /// Get the number of times a pinned alignment reused the query packed for
+    /// the previous one, because it was for the same sequence.
+    size_t reused_query_count() const;
+    
 protected:
     /**
      * Represents a correspondance between a position in the subgraph we are
@@ -234,10 +241,53 @@ protected:
     /// the downward alignment pass and traceback. If left_to_right is
     /// set, goes left to right and traces back the other way. If it is
     /// unset, goes right to left and traces back the other way.
+    ///
+    /// If packed_query is set, it is used instead of packing the query, and
+    /// dozeu's memory is not flushed afterward, so it stays usable.
     void align_downward(Alignment &alignment, const OrderedGraph& graph,
                         const vector<graph_pos_s>& head_positions,
                         bool left_to_right, vector<const dz_forefront_s*>& forefronts,
-                        int8_t full_length_bonus, uint16_t max_gap_length);
+                        int8_t full_length_bonus, uint16_t max_gap_length,
+                        const dz_query_s* packed_query = nullptr);
+    
+    /// Get the packed query for a pinned alignment of the whole sequence of
+    /// the given Alignment, reusing the one from the previous pinned alignment
+    /// if it was of the same sequence. Otherwise, flushes dozeu's memory and
+    /// packs a new one.
+    const dz_query_s* get_pinned_query(const Alignment& alignment, bool left_to_right, int8_t full_length_bonus);
+    
+    /// Flush dozeu's memory, forgetting any cached query.
+    void flush_memory();
+    
+    /**
+     * Pinned alignments of the same sequence, such as a read tail against
+     * each tree in a tail forest, can share a packed query, as long as we
+     * don't flush dozeu's memory in between. This holds the query we packed
+     * last, and what it was packed from.
+     */
+    struct QueryCache {
+        /// The packed query, in dozeu's memory, or null if there isn't one
+        const dz_query_s* query = nullptr;
+        /// The sequence and qualities it was packed from. Dozeu may point
+        /// into these, so they have to live as long as the query.
+        string sequence;
+        string quality;
+        int8_t full_length_bonus = 0;
+        bool left_to_right = true;
+        /// About how many DP cells have been filled in since the last flush
+        size_t cells = 0;
+    };
+    
+    /// Stop reusing a packed query once this many DP cells have been filled
+    /// in since the last flush, to bound dozeu's memory use.
+    static const size_t MAX_QUERY_CACHE_CELLS;
+    
+    /// The query we can reuse
+    QueryCache query_cache;
+    
+    /// How many queries have we packed and reused for pinned alignments?
+    size_t packed_queries = 0;
+    size_t reused_queries = 0;
     
     
     /// The core dozeu class, which does the alignments
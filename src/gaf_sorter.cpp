@@ -0,0 +1,332 @@
+/**
+ * \file gaf_sorter.cpp
+ * Implements sorting and indexing of GAF text alignment files by node ID.
+ */
+
+#include "gaf_sorter.hpp"
+#include "utility.hpp"
+
+#include <htslib/kstring.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <queue>
+
+namespace vg {
+
+using namespace std;
+
+/// Get the path column of a GAF line, as a (start, length) pair, or (0, 0)
+/// if the line has too few columns.
+static pair<size_t, size_t> gaf_path_column(const string& line) {
+    // The path is the 6th column
+    size_t start = 0;
+    for (size_t column = 0; column < 5; column++) {
+        start = line.find('\t', start);
+        if (start == string::npos) {
+            return make_pair(0, 0);
+        }
+        start++;
+    }
+    size_t end = line.find('\t', start);
+    if (end == string::npos) {
+        end = line.size();
+    }
+    return make_pair(start, end - start);
+}
+
+bool for_each_gaf_node_id(const string& line, const function<bool(id_t)>& iteratee) {
+    pair<size_t, size_t> path = gaf_path_column(line);
+    if (path.second == 0 || (line[path.first] != '>' && line[path.first] != '<')) {
+        // Unmapped, or a path given by name
+        return true;
+    }
+    size_t path_end = path.first + path.second;
+
+    // Make sure the whole path is node visits before reporting any of them,
+    // since stable path segments also start with orientations.
+    for (size_t i = path.first; i < path_end; i++) {
+        char c = line[i];
+        if (c == '>' || c == '<') {
+            if (i + 1 == path_end || line[i + 1] == '>' || line[i + 1] == '<') {
+                return true;
+            }
+        } else if (c < '0' || c > '9') {
+            return true;
+        }
+    }
+
+    for (size_t i = path.first; i < path_end;) {
+        // Skip the orientation and read the ID
+        i++;
+        id_t node_id = 0;
+        for (; i < path_end && line[i] != '>' && line[i] != '<'; i++) {
+            node_id = node_id * 10 + (line[i] - '0');
+        }
+        if (!iteratee(node_id)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+pair<id_t, id_t> gaf_node_range(const string& line) {
+    id_t min_id = numeric_limits<id_t>::max();
+    id_t max_id = 0;
+    for_each_gaf_node_id(line, [&](id_t node_id) {
+        min_id = min(min_id, node_id);
+        max_id = max(max_id, node_id);
+        return true;
+    });
+    if (max_id == 0) {
+        // We didn't see any nodes
+        min_id = 0;
+    }
+    return make_pair(min_id, max_id);
+}
+
+GAFSorter::GAFSorter(bool show_progress) {
+    this->show_progress = show_progress;
+}
+
+void GAFSorter::set_memory_budget(size_t bytes) {
+    memory_budget = bytes;
+}
+
+void GAFSorter::sort(vector<string>& records) const {
+    // Parse each record's path only once, and sort the keys with the
+    // original index as a tiebreaker.
+    vector<pair<id_t, size_t>> keyed(records.size());
+    #pragma omp parallel for
+    for (size_t i = 0; i < records.size(); i++) {
+        keyed[i] = make_pair(gaf_node_range(records[i]).first, i);
+    }
+    std::sort(keyed.begin(), keyed.end());
+
+    vector<string> sorted;
+    sorted.reserve(records.size());
+    for (auto& key_and_index : keyed) {
+        sorted.emplace_back(std::move(records[key_and_index.second]));
+    }
+    records = std::move(sorted);
+}
+
+void GAFSorter::stream_sort(const string& gaf_in_name, const string& gaf_out_name, StreamIndexBase* index_to) {
+
+    // htslib reads plain or bgzipped text, and treats "-" as standard input.
+    BGZF* gaf_in = bgzf_open(gaf_in_name.c_str(), "r");
+    if (gaf_in == nullptr) {
+        cerr << "error:[vg::GAFSorter] Could not open " << gaf_in_name << " for reading" << endl;
+        exit(1);
+    }
+
+    // We number the chunks as we read them, so we can merge them in input
+    // order and keep records with the same key in input order.
+    map<size_t, string> temp_name_by_chunk;
+    size_t next_chunk = 0;
+    size_t total_records = 0;
+
+    // Each thread sorts its own chunk, so they have to share the memory.
+    size_t max_buf_size = max<size_t>(memory_budget / get_thread_count(), 1);
+
+    #pragma omp parallel
+    {
+        kstring_t line = {0, 0, nullptr};
+        while (true) {
+            vector<string> records;
+            size_t chunk;
+
+            #pragma omp critical (gaf_input)
+            {
+                // Each thread fights for the file and the winner takes some data
+                size_t buffered_bytes = 0;
+                int length = 0;
+                while (buffered_bytes < max_buf_size && (length = bgzf_getline(gaf_in, '\n', &line)) >= 0) {
+                    if (length == 0) {
+                        continue;
+                    }
+                    records.emplace_back(line.s, length);
+                    buffered_bytes += length;
+                }
+                if (length < -1) {
+                    cerr << "error:[vg::GAFSorter] Could not read " << gaf_in_name << endl;
+                    exit(1);
+                }
+                chunk = next_chunk++;
+            }
+
+            if (records.empty()) {
+                // No data was found
+                break;
+            }
+
+            sort(records);
+
+            string temp_name = temp_file::create();
+            ofstream temp_stream(temp_name);
+            for (auto& record : records) {
+                temp_stream << record << '\n';
+            }
+
+            #pragma omp critical (gaf_temp_files)
+            {
+                temp_name_by_chunk[chunk] = temp_name;
+                total_records += records.size();
+            }
+        }
+        free(line.s);
+    }
+    bgzf_close(gaf_in);
+
+    vector<string> temp_names;
+    for (auto& chunk_and_name : temp_name_by_chunk) {
+        temp_names.push_back(chunk_and_name.second);
+    }
+
+    while (temp_names.size() > max_fan_in) {
+        // We can't merge them all at once, so merge consecutive runs of them,
+        // which keeps ties in input order.
+        vector<string> merged_names;
+        for (size_t start = 0; start < temp_names.size(); start += max_fan_in) {
+            size_t end = min(start + max_fan_in, temp_names.size());
+            merged_names.push_back(merge_to_temp(vector<string>(temp_names.begin() + start, temp_names.begin() + end)));
+        }
+        temp_names = std::move(merged_names);
+    }
+
+    // htslib treats "-" as standard output.
+    BGZF* gaf_out = bgzf_open(gaf_out_name.c_str(), "w");
+    if (gaf_out == nullptr) {
+        cerr << "error:[vg::GAFSorter] Could not open " << gaf_out_name << " for writing" << endl;
+        exit(1);
+    }
+
+    create_progress("merge " + to_string(temp_names.size()) + " files", total_records == 0 ? 1 : total_records);
+    merge_to_output(temp_names, gaf_out, index_to);
+    update_progress(total_records == 0 ? 1 : total_records);
+    destroy_progress();
+
+    if (bgzf_close(gaf_out) != 0) {
+        cerr << "error:[vg::GAFSorter] Could not finish writing " << gaf_out_name << endl;
+        exit(1);
+    }
+}
+
+void GAFSorter::merge(const vector<string>& temp_names_in, const function<void(const string&)>& emit) const {
+    vector<ifstream> streams(temp_names_in.size());
+    vector<string> heads(temp_names_in.size());
+
+    // Order the files by the minimum node ID of their next record, with ties
+    // going to the earlier file.
+    using head_t = pair<id_t, size_t>;
+    priority_queue<head_t, vector<head_t>, greater<head_t>> queue;
+
+    for (size_t i = 0; i < temp_names_in.size(); i++) {
+        streams[i].open(temp_names_in[i]);
+        if (getline(streams[i], heads[i])) {
+            queue.emplace(gaf_node_range(heads[i]).first, i);
+        }
+    }
+
+    while (!queue.empty()) {
+        size_t winner = queue.top().second;
+        queue.pop();
+        emit(heads[winner]);
+        if (getline(streams[winner], heads[winner])) {
+            queue.emplace(gaf_node_range(heads[winner]).first, winner);
+        }
+    }
+
+    streams.clear();
+    for (auto& temp_name : temp_names_in) {
+        temp_file::remove(temp_name);
+    }
+}
+
+string GAFSorter::merge_to_temp(const vector<string>& temp_names_in) const {
+    string temp_name = temp_file::create();
+    ofstream temp_stream(temp_name);
+    merge(temp_names_in, [&](const string& record) {
+        temp_stream << record << '\n';
+    });
+    return temp_name;
+}
+
+void GAFSorter::merge_to_output(const vector<string>& temp_names_in, BGZF* out, StreamIndexBase* index_to) {
+
+    // Records go out in groups, which are what the index can find.
+    size_t group_records = 0;
+    id_t group_min_id = 0;
+    id_t group_max_id = 0;
+    int64_t group_start = bgzf_tell(out);
+    size_t observed_records = 0;
+
+    auto finish_group = [&]() {
+        if (index_to != nullptr && group_records > 0) {
+            index_to->add_group(group_min_id, group_max_id, group_start, bgzf_tell(out));
+        }
+        group_records = 0;
+    };
+
+    merge(temp_names_in, [&](const string& record) {
+        pair<id_t, id_t> node_range = gaf_node_range(record);
+        if (group_records == 0) {
+            // The records are sorted, so the first one has the group's min ID.
+            group_start = bgzf_tell(out);
+            group_min_id = node_range.first;
+            group_max_id = node_range.second;
+        } else {
+            group_max_id = max(group_max_id, node_range.second);
+        }
+
+        if (bgzf_write(out, record.c_str(), record.size()) < 0 || bgzf_write(out, "\n", 1) < 0) {
+            cerr << "error:[vg::GAFSorter] Could not write sorted GAF" << endl;
+            exit(1);
+        }
+
+        group_records++;
+        if (group_records == records_per_group) {
+            finish_group();
+        }
+
+        observed_records++;
+        update_progress(observed_records);
+    });
+    finish_group();
+}
+
+void find_gaf_records(BGZF* sorted_gaf, const StreamIndexBase& index, id_t min_node, id_t max_node,
+                      const function<void(const string&)>& handle_record) {
+
+    kstring_t line = {0, 0, nullptr};
+    index.find(min_node, max_node, [&](int64_t start_vo, int64_t past_end_vo) -> bool {
+        // For each run of groups that might have relevant records
+        if (bgzf_seek(sorted_gaf, start_vo, SEEK_SET) != 0) {
+            cerr << "error:[vg::find_gaf_records] Could not seek in sorted GAF" << endl;
+            exit(1);
+        }
+        while (bgzf_tell(sorted_gaf) < past_end_vo && bgzf_getline(sorted_gaf, '\n', &line) >= 0) {
+            string record(line.s, line.l);
+            if (gaf_node_range(record).first > max_node) {
+                // This and everything after it starts past the range
+                return false;
+            }
+            bool relevant = false;
+            for_each_gaf_node_id(record, [&](id_t node_id) {
+                relevant = (node_id >= min_node && node_id <= max_node);
+                return !relevant;
+            });
+            if (relevant) {
+                handle_record(record);
+            }
+        }
+        return true;
+    });
+    free(line.s);
+}
+
+}
@@ -0,0 +1,96 @@
+#ifndef VG_GAF_SORTER_HPP_INCLUDED
+#define VG_GAF_SORTER_HPP_INCLUDED
+
+/**
+ * \file gaf_sorter.hpp
+ * Sorting and indexing of GAF text alignment files by node ID.
+ */
+
+#include "progressive.hpp"
+#include "stream_index.hpp"
+#include "types.hpp"
+
+#include <htslib/bgzf.h>
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vg {
+
+using namespace std;
+
+/**
+ * Find the minimum and maximum node IDs visited by the path of a GAF record.
+ * Records whose path is not a walk of node IDs (for example, unmapped records,
+ * or paths given by name) get 0 for both, and sort first, like unplaced GAM
+ * records.
+ */
+pair<id_t, id_t> gaf_node_range(const string& line);
+
+/**
+ * Call the given iteratee with each node ID visited by the path of a GAF
+ * record. Stops and returns false if the iteratee returns false.
+ */
+bool for_each_gaf_node_id(const string& line, const function<bool(id_t)>& iteratee);
+
+/**
+ * Sorts GAF records by the minimum node ID they visit, using sorted temp files
+ * that are merged together, and writes them as bgzipped GAF that can be
+ * indexed with a StreamIndexBase, the same way sorted GAM is indexed.
+ *
+ * Records that visit the same minimum node ID stay in input order.
+ */
+class GAFSorter : public Progressive {
+public:
+
+    /// Create a GAF sorter, showing sort progress on standard error if
+    /// show_progress is true.
+    GAFSorter(bool show_progress = false);
+
+    /// Set the approximate number of bytes of GAF text to hold in memory. It
+    /// is split between the threads sorting chunks.
+    void set_memory_budget(size_t bytes);
+
+    /// Sort the GAF records in the given file, which may be bgzipped, or "-"
+    /// for standard input. Write them as bgzipped GAF to the given file, or
+    /// "-" for standard output. If index_to is set, index the sorted file
+    /// into it.
+    void stream_sort(const string& gaf_in_name, const string& gaf_out_name, StreamIndexBase* index_to = nullptr);
+
+private:
+    /// What's the maximum size of GAF text to have in memory at once?
+    size_t memory_budget = (2048LL * 1024 * 1024);
+    /// What's the max fan-in when combining temp files?
+    size_t max_fan_in = 512;
+    /// How many records go in one indexed group of the output file?
+    size_t records_per_group = 256;
+
+    /// Sort the given records by minimum node ID, keeping ties in order.
+    void sort(vector<string>& records) const;
+
+    /// Merge the given sorted temp files into one sorted temp file, which is
+    /// returned. The input files are removed.
+    string merge_to_temp(const vector<string>& temp_names_in) const;
+
+    /// Merge the given sorted temp files and write them to the given BGZF
+    /// file, indexing them if index_to is set. The input files are removed.
+    void merge_to_output(const vector<string>& temp_names_in, BGZF* out, StreamIndexBase* index_to);
+
+    /// Merge the given sorted temp files, and call emit with each record in
+    /// order. The input files are removed.
+    void merge(const vector<string>& temp_names_in, const function<void(const string&)>& emit) const;
+};
+
+/**
+ * Call the given callback with each record in a bgzipped GAF file sorted by
+ * GAFSorter that visits a node in the given inclusive range, using the file's
+ * index to seek to only the groups of records that might be relevant.
+ */
+void find_gaf_records(BGZF* sorted_gaf, const StreamIndexBase& index, id_t min_node, id_t max_node,
+                      const function<void(const string&)>& handle_record);
+
+}
+
+#endif
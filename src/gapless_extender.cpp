@@ -6,6 +6,12 @@
 #include <set>
 #include <stack>
 
+#include <simde/x86/sse2.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
 namespace vg {
 
 //------------------------------------------------------------------------------
@@ -181,28 +187,83 @@ void set_score(GaplessExtension& extension, const Aligner* aligner) {
     extension.score += static_cast<int32_t>(extension.right_full * aligner->full_length_bonus); 
 }
 
+//------------------------------------------------------------------------------
+
+// Vectorized sequence comparison.
+
+// Sequences are compared in blocks of this many bases.
+constexpr size_t MATCH_BLOCK_SIZE = 32;
+
+// Kernel returning a bitmask of the positions where two MATCH_BLOCK_SIZE-byte
+// blocks differ. Bit i is set if a[i] != b[i].
+typedef std::uint32_t (*mismatch_kernel_type)(const char* a, const char* b);
+
+// Portable version using 16-byte vectors. With SSE2 or better this uses the
+// native instructions, and otherwise SIMDe falls back to scalar code.
+std::uint32_t mismatch_mask_sse(const char* a, const char* b) {
+    simde__m128i a_low = simde_mm_loadu_si128(reinterpret_cast<const simde__m128i*>(a));
+    simde__m128i b_low = simde_mm_loadu_si128(reinterpret_cast<const simde__m128i*>(b));
+    simde__m128i a_high = simde_mm_loadu_si128(reinterpret_cast<const simde__m128i*>(a + 16));
+    simde__m128i b_high = simde_mm_loadu_si128(reinterpret_cast<const simde__m128i*>(b + 16));
+    std::uint32_t low = static_cast<std::uint16_t>(simde_mm_movemask_epi8(simde_mm_cmpeq_epi8(a_low, b_low)));
+    std::uint32_t high = static_cast<std::uint16_t>(simde_mm_movemask_epi8(simde_mm_cmpeq_epi8(a_high, b_high)));
+    return ~(low | (high << 16));
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// AVX2 version comparing the whole block at once. Only called if the CPU
+// supports AVX2, so it can be compiled into a portable SSE4.2 binary.
+__attribute__((target("avx2")))
+std::uint32_t mismatch_mask_avx2(const char* a, const char* b) {
+    __m256i a_block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+    __m256i b_block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+    return ~static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a_block, b_block)));
+}
+#endif
+
+// Pick the best kernel the CPU we are running on supports.
+mismatch_kernel_type choose_mismatch_kernel() {
+#if defined(__x86_64__) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return mismatch_mask_avx2;
+    }
+#endif
+    return mismatch_mask_sse;
+}
+
+const mismatch_kernel_type mismatch_kernel = choose_mismatch_kernel();
+
+// Get a bitmask of the mismatching positions between a and b, which must both
+// have at least len <= MATCH_BLOCK_SIZE bytes available.
+inline std::uint32_t mismatch_mask(const char* a, const char* b, size_t len, mismatch_kernel_type kernel = mismatch_kernel) {
+    if (len == MATCH_BLOCK_SIZE) {
+        return kernel(a, b);
+    }
+    // Pad a partial block with matching zeros.
+    char a_block[MATCH_BLOCK_SIZE] = {}, b_block[MATCH_BLOCK_SIZE] = {};
+    std::memcpy(a_block, a, len);
+    std::memcpy(b_block, b, len);
+    return kernel(a_block, b_block);
+}
+
+std::uint32_t gapless_mismatch_mask(const char* a, const char* b, size_t len, bool portable_kernel) {
+    return mismatch_mask(a, b, len, portable_kernel ? mismatch_mask_sse : mismatch_kernel);
+}
+
+//------------------------------------------------------------------------------
+
 // Match the initial node, assuming that read_offset or node_offset is 0.
 // Updates internal_score and old_score; use set_score() to compute score.
 void match_initial(GaplessExtension& match, const std::string& seq, gbwtgraph::view_type target) {
     size_t node_offset = match.offset;
     size_t left = std::min(seq.length() - match.read_interval.second, target.second - node_offset);
     while (left > 0) {
-        size_t len = std::min(left, sizeof(std::uint64_t));
-        std::uint64_t a = 0, b = 0;
-        std::memcpy(&a, seq.data() + match.read_interval.second, len);
-        std::memcpy(&b, target.first + node_offset, len);
-        if (a == b) {
-            match.read_interval.second += len;
-            node_offset += len;
-        } else {
-            for (size_t i = 0; i < len; i++) {
-                if (seq[match.read_interval.second] != target.first[node_offset]) {
-                    match.internal_score++;
-                }
-                match.read_interval.second++;
-                node_offset++;
-            }
-        }
+        size_t len = std::min(left, MATCH_BLOCK_SIZE);
+        std::uint32_t mask = mismatch_mask(seq.data() + match.read_interval.second, target.first + node_offset, len);
+        match.internal_score += __builtin_popcount(mask);
+        match.read_interval.second += len;
+        node_offset += len;
         left -= len;
     }
     match.old_score = match.internal_score;
@@ -215,25 +276,19 @@ size_t match_forward(GaplessExtension& match, const std::string& seq, gbwtgraph:
     size_t node_offset = 0;
     size_t left = std::min(seq.length() - match.read_interval.second, target.second - node_offset);
     while (left > 0) {
-        size_t len = std::min(left, sizeof(std::uint64_t));
-        std::uint64_t a = 0, b = 0;
-        std::memcpy(&a, seq.data() + match.read_interval.second, len);
-        std::memcpy(&b, target.first + node_offset, len);
-        if (a == b) {
-            match.read_interval.second += len;
-            node_offset += len;
-        } else {
-            for (size_t i = 0; i < len; i++) {
-                if (seq[match.read_interval.second] != target.first[node_offset]) {
-                    if (match.internal_score + 1 >= mismatch_limit) {
-                        return node_offset;
-                    }
-                    match.internal_score++;
-                }
-                match.read_interval.second++;
-                node_offset++;
+        size_t len = std::min(left, MATCH_BLOCK_SIZE);
+        std::uint32_t mask = mismatch_mask(seq.data() + match.read_interval.second, target.first + node_offset, len);
+        // Visit the mismatches from left to right.
+        for (; mask != 0; mask &= mask - 1) {
+            if (match.internal_score + 1 >= mismatch_limit) {
+                size_t matched = __builtin_ctz(mask);
+                match.read_interval.second += matched;
+                return node_offset + matched;
             }
+            match.internal_score++;
         }
+        match.read_interval.second += len;
+        node_offset += len;
         left -= len;
     }
     return node_offset;
@@ -245,25 +300,22 @@ size_t match_forward(GaplessExtension& match, const std::string& seq, gbwtgraph:
 void match_backward(GaplessExtension& match, const std::string& seq, gbwtgraph::view_type target, uint32_t mismatch_limit) {
     size_t left = std::min(match.read_interval.first, match.offset);
     while (left > 0) {
-        size_t len = std::min(left, sizeof(std::uint64_t));
-        std::uint64_t a = 0, b = 0;
-        std::memcpy(&a, seq.data() + match.read_interval.first - len, len);
-        std::memcpy(&b, target.first + match.offset - len, len);
-        if (a == b) {
-            match.read_interval.first -= len;
-            match.offset -= len;
-        } else {
-            for (size_t i = 0; i < len; i++) {
-                if (seq[match.read_interval.first - 1] != target.first[match.offset - 1]) {
-                    if (match.internal_score + 1 >= mismatch_limit) {
-                        return;
-                    }
-                    match.internal_score++;
-                }
-                match.read_interval.first--;
-                match.offset--;
+        size_t len = std::min(left, MATCH_BLOCK_SIZE);
+        std::uint32_t mask = mismatch_mask(seq.data() + match.read_interval.first - len, target.first + match.offset - len, len);
+        // Visit the mismatches from right to left.
+        while (mask != 0) {
+            size_t position = 31 - __builtin_clz(mask);
+            if (match.internal_score + 1 >= mismatch_limit) {
+                size_t matched = len - position - 1;
+                match.read_interval.first -= matched;
+                match.offset -= matched;
+                return;
             }
+            match.internal_score++;
+            mask &= ~(static_cast<std::uint32_t>(1) << position);
         }
+        match.read_interval.first -= len;
+        match.offset -= len;
         left -= len;
     }
 }
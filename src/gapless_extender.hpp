@@ -210,6 +210,16 @@ private:
 
 //------------------------------------------------------------------------------
 
+/**
+ * Return a bitmask of the positions where the first len <= 32 characters of a
+ * and b differ, with bit i set if a[i] != b[i]. This is how GaplessExtender
+ * compares sequences, using the fastest kernel the CPU supports, or the
+ * portable 16-byte kernel if portable_kernel is set. Mostly for testing.
+ */
+std::uint32_t gapless_mismatch_mask(const char* a, const char* b, size_t len, bool portable_kernel = false);
+
+//------------------------------------------------------------------------------
+
 } // namespace vg
 
 #endif // VG_GAPLESS_EXTENDER_HPP_INCLUDED
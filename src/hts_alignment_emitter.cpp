@@ -10,8 +10,12 @@
 #include "vg/io/json2pb.h"
 #include <vg/io/hfile_cppstream.hpp>
 #include <vg/io/stream.hpp>
+#include <htslib/bgzf.h>
 
+#include <algorithm>
+#include <queue>
 #include <sstream>
+#include <tuple>
 
 //#define debug
 
@@ -21,7 +25,8 @@ using namespace std;
 unique_ptr<AlignmentEmitter> get_alignment_emitter(const string& filename, const string& format, 
                                                    const vector<path_handle_t>& paths, size_t max_threads,
                                                    const HandleGraph* graph, bool hts_raw,
-                                                   bool hts_spliced) {
+                                                   bool hts_spliced, size_t hts_compression_threads,
+                                                   size_t hts_sort_memory, const string& hts_index_filename) {
 
     
     unique_ptr<AlignmentEmitter> emitter;
@@ -39,13 +44,21 @@ unique_ptr<AlignmentEmitter> get_alignment_emitter(const string& filename, const
         // Build a path name and length list from the handles
         vector<pair<string, int64_t>> path_names_and_lengths = extract_path_metadata(paths, *path_graph);
     
+        unique_ptr<HTSAlignmentEmitter> hts_emitter;
         if (hts_spliced) {
             // Use a splicing emitter as the final emitter
-            emitter = make_unique<SplicedHTSAlignmentEmitter>(filename, format, path_names_and_lengths, *path_graph, max_threads);
+            hts_emitter = make_unique<SplicedHTSAlignmentEmitter>(filename, format, path_names_and_lengths, *path_graph, max_threads,
+                                                                  hts_compression_threads);
         } else {
             // Use a normal emitter
-            emitter = make_unique<HTSAlignmentEmitter>(filename, format, path_names_and_lengths, max_threads);
+            hts_emitter = make_unique<HTSAlignmentEmitter>(filename, format, path_names_and_lengths, max_threads,
+                                                           hts_compression_threads);
         }
+        if (hts_sort_memory != 0) {
+            // Sort the output by coordinate
+            hts_emitter->set_sorted_output(hts_sort_memory, hts_index_filename);
+        }
+        emitter = std::move(hts_emitter);
         
         if (!hts_raw) {
             // Need to surject
@@ -187,13 +200,18 @@ vector<path_handle_t> get_sequence_dictionary(const string& filename, const Path
 const size_t HTSWriter::BGZF_FOOTER_LENGTH = 28;
 
 HTSWriter::HTSWriter(const string& filename, const string& format,
-    const vector<pair<string, int64_t>>& path_order_and_length, size_t max_threads) :
+    const vector<pair<string, int64_t>>& path_order_and_length, size_t max_threads,
+    size_t compression_threads) :
     out_file(filename == "-" ? nullptr : new ofstream(filename)),
-    multiplexer(out_file.get() != nullptr ? *out_file : cout, max_threads),
+    // If we compress in a pool, the writer thread needs a stream of its own
+    multiplexer(out_file.get() != nullptr ? *out_file : cout,
+                max_threads + (compression_threads > 0 && format != "SAM" ? 1 : 0)),
     format(format), path_order_and_length(path_order_and_length), path_index(),
-    backing_files(max_threads, nullptr), sam_files(max_threads, nullptr),
+    backing_files(max_threads + (compression_threads > 0 && format != "SAM" ? 1 : 0), nullptr),
+    sam_files(max_threads + (compression_threads > 0 && format != "SAM" ? 1 : 0), nullptr),
     atomic_header(nullptr), sam_header(), header_mutex(), output_is_bgzf(format != "SAM"),
-    hts_mode() {
+    hts_mode(), compression_pool(), writer_stream(max_threads), writer_thread(), queued_batches(),
+    max_queued_batches(2 * max_threads), queue_depth(0), max_queue_depth(0), blocked_batches(0) {
     
     // We can't work with no streams to multiplex, because we need to be able
     // to write BGZF EOF blocks throught he multiplexer at destruction.
@@ -235,10 +253,44 @@ HTSWriter::HTSWriter(const string& filename, const string& format,
         path_index.emplace(it->first, it);
     }
     
+    if (compression_threads > 0 && output_is_bgzf) {
+        // Make a pool for HTSlib to compress in, and a thread to feed it the
+        // records in order.
+        compression_pool.pool = hts_tpool_init(compression_threads);
+        if (compression_pool.pool == nullptr) {
+            cerr << "[vg::HTSWriter] failed to start " << compression_threads << " compression threads" << endl;
+            exit(1);
+        }
+        writer_thread = thread(&HTSWriter::run_writer, this);
+    }
+    
     // Each thread will lazily open its samFile*, once it has a header ready
 }
 
 HTSWriter::~HTSWriter() {
+    if (writer_thread.joinable()) {
+        // Let the writer thread write everything that is queued, while we
+        // still have a header.
+        {
+            lock_guard<mutex> queue_lock(queue_mutex);
+            writer_done = true;
+        }
+        queue_not_empty.notify_one();
+        writer_thread.join();
+        
+#ifdef debug
+        cerr << "[vg::HTSWriter] compression queue held at most " << max_queued_batch_count() << " batches, and "
+             << blocked_batch_count() << " batches had to wait for room" << endl;
+#endif
+    }
+    
+    // If we were sorting and got any records, we still have to write them.
+    bool write_sorted = (sort_memory != 0 && atomic_header.load() != nullptr);
+    if (write_sorted) {
+        // Now that we have all the records, write them out in order
+        write_sorted_output();
+    }
+    
     // Note that the destructor runs in only one thread, and only when
     // destruction is safe. No need to lock the header.
     if (atomic_header.load() != nullptr) {
@@ -265,12 +317,17 @@ HTSWriter::~HTSWriter() {
         }
     }
     
-    if (output_is_bgzf) {
-        // Now put one BGZF EOF marker in thread 0's stream.
+    if (output_is_bgzf && !write_sorted) {
+        // Now put one BGZF EOF marker in thread 0's stream. (Sorted output
+        // already has one, unless there was nothing to sort.)
         // It will be the last thing, after all the barriers, and close the file.
         vg::io::finish(multiplexer.get_thread_stream(0), true);
     }
     
+    if (compression_pool.pool != nullptr) {
+        // All the samFile*s that were using the pool are closed now
+        hts_tpool_destroy(compression_pool.pool);
+    }
 }
 
 bam_hdr_t* HTSWriter::ensure_header(const string& read_group,
@@ -296,12 +353,15 @@ bam_hdr_t* HTSWriter::ensure_header(const string& read_group,
                 rg_sample[read_group] = sample_name;
             }
             
-            // Make the header
-            header = hts_string_header(sam_header, path_order_and_length, rg_sample);
+            // Make the header, which says if the records will be sorted
+            header = hts_string_header(sam_header, path_order_and_length, rg_sample, sort_memory != 0);
             
-            // Initialize the SAM file for this thread and actually keep the header
-            // we write, since we are the first thread.
-            initialize_sam_file(header, thread_number, true);
+            if (sort_memory == 0) {
+                // Initialize the SAM file for this thread and actually keep the header
+                // we write, since we are the first thread.
+                // (If we're sorting, the header is written with the sorted records.)
+                initialize_sam_file(header, thread_number, true);
+            }
             
             // Save back to the atomic only after the header has been written and
             // it is safe for other threads to use it.
@@ -315,8 +375,10 @@ bam_hdr_t* HTSWriter::ensure_header(const string& read_group,
     // Otherwise, someone else beat us to creating the header.
     // Header is ready. We just need to create the samFile* for this thread with it if it doesn't exist.
     
-    if (sam_files[thread_number] == nullptr) {
+    if (sam_files[thread_number] == nullptr && compression_pool.pool == nullptr && sort_memory == 0) {
         // The header has been created and written, but hasn't been used to initialize our samFile* yet.
+        // (If we're compressing in a pool, only the writer thread needs one,
+        // and if we're sorting, nobody does until the end.)
         initialize_sam_file(header, thread_number);
     }
     
@@ -325,9 +387,68 @@ bam_hdr_t* HTSWriter::ensure_header(const string& read_group,
 
 
 void HTSWriter::save_records(bam_hdr_t* header, vector<bam1_t*>& records, size_t thread_number) {
-    // We need a header and an extant samFile*
+    if (sort_memory != 0) {
+        // Hold on to the records to sort them
+        vector<bam1_t*> to_spill;
+        {
+            lock_guard<mutex> sort_lock(sort_mutex);
+            for (auto& b : records) {
+                sort_buffer_bytes += sizeof(bam1_t) + b->m_data;
+                sort_buffer.push_back(b);
+            }
+            if (sort_buffer_bytes >= sort_memory) {
+                // Take the full buffer to spill, so other threads can keep
+                // filling a new one while we sort and write it.
+                to_spill = std::move(sort_buffer);
+                sort_buffer.clear();
+                sort_buffer_bytes = 0;
+            }
+        }
+        records.clear();
+        
+        if (!to_spill.empty()) {
+            string run_filename = spill_sorted_run(header, to_spill);
+            lock_guard<mutex> sort_lock(sort_mutex);
+            sorted_runs.push_back(run_filename);
+        }
+        return;
+    }
+    
+    if (compression_pool.pool == nullptr) {
+        // Compress and write the records on this thread
+        write_records(header, records, thread_number);
+        return;
+    }
+    
+    // Otherwise, hand the records off to the writer thread
+    unique_lock<mutex> queue_lock(queue_mutex);
+    if (queued_batches.size() >= max_queued_batches) {
+        // The writer is behind, so we have to wait for it
+        blocked_batches++;
+        queue_not_full.wait(queue_lock, [&]() {
+            return queued_batches.size() < max_queued_batches;
+        });
+    }
+    queued_batches.emplace_back(std::move(records));
+    records.clear();
+    // Only we change the depth while holding the lock, so we can check and
+    // update the maximum without a race
+    queue_depth.store(queued_batches.size());
+    if (queued_batches.size() > max_queue_depth.load()) {
+        max_queue_depth.store(queued_batches.size());
+    }
+    queue_lock.unlock();
+    queue_not_empty.notify_one();
+}
+
+void HTSWriter::write_records(bam_hdr_t* header, vector<bam1_t*>& records, size_t thread_number) {
+    // We need a header
     assert(header != nullptr);
-    assert(sam_files[thread_number] != nullptr);
+    
+    if (sam_files[thread_number] == nullptr) {
+        // The writer thread opens its samFile* when it gets its first records
+        initialize_sam_file(header, thread_number);
+    }
     
     for (auto& b : records) {
         // Emit each record
@@ -336,6 +457,9 @@ void HTSWriter::save_records(bam_hdr_t* header, vector<bam1_t*>& records, size_t
             cerr << "[vg::HTSWriter] error: writing to output file failed" << endl;
             exit(1);
         }
+        if (compression_pool.pool != nullptr) {
+            unflushed_bytes += sizeof(bam1_core_t) + b->l_data;
+        }
     }
     
     for (auto& b : records) {
@@ -343,6 +467,29 @@ void HTSWriter::save_records(bam_hdr_t* header, vector<bam1_t*>& records, size_t
         bam_destroy1(b);
     }
     
+    if (compression_pool.pool != nullptr && hts_get_format(sam_files[thread_number])->compression == bgzf) {
+        // With a thread pool attached, htslib's BGZF writer thread pushes
+        // compressed blocks into our stream in the background, so we can't
+        // ask the multiplexer about that stream until it has caught up.
+        // Flushing the BGZF waits for all pending blocks to be written to
+        // the hFILE*, and flushing the hFILE* gets them to the C++ stream.
+        // Batches are often a single read, and flushing after each one would
+        // make tiny blocks and stall on the pool, so we only flush and look
+        // for a breakpoint once enough has been written since the last time.
+        if (unflushed_bytes < pool_flush_bytes) {
+            return;
+        }
+        unflushed_bytes = 0;
+        if (bgzf_flush(sam_files[thread_number]->fp.bgzf) != 0) {
+            cerr << "[vg::HTSWriter] error: failed to flush compressed " << format << " output" << endl;
+            exit(1);
+        }
+        if (hflush(backing_files[thread_number]) != 0) {
+            cerr << "[vg::HTSWriter] error: failed to flush " << format << " output" << endl;
+            exit(1);
+        }
+    }
+    
     if (multiplexer.want_breakpoint(thread_number)) {
         // We have written enough that we ought to give the multiplexer a chance to multiplex soon.
         // There's no way to do this without closing and re-opening the HTS file.
@@ -351,6 +498,243 @@ void HTSWriter::save_records(bam_hdr_t* header, vector<bam1_t*>& records, size_t
     }
 }
 
+void HTSWriter::run_writer() {
+    while (true) {
+        vector<bam1_t*> records;
+        {
+            unique_lock<mutex> queue_lock(queue_mutex);
+            queue_not_empty.wait(queue_lock, [&]() {
+                return !queued_batches.empty() || writer_done;
+            });
+            if (queued_batches.empty()) {
+                // We're done and there's nothing left to write
+                break;
+            }
+            records = std::move(queued_batches.front());
+            queued_batches.pop_front();
+            queue_depth.store(queued_batches.size());
+        }
+        queue_not_full.notify_one();
+        
+        // The header must exist for these records to have been made. Writing
+        // them just fills BGZF blocks, which the pool compresses.
+        write_records(atomic_header.load(), records, writer_stream);
+    }
+}
+
+size_t HTSWriter::queued_batch_count() const {
+    return queue_depth.load();
+}
+
+size_t HTSWriter::max_queued_batch_count() const {
+    return max_queue_depth.load();
+}
+
+size_t HTSWriter::blocked_batch_count() const {
+    return blocked_batches.load();
+}
+
+void HTSWriter::set_sorted_output(size_t memory_budget, const string& index_filename) {
+    // Nothing can have been saved yet
+    assert(atomic_header.load() == nullptr);
+    
+    if (!index_filename.empty() && !output_is_bgzf) {
+        cerr << "[vg::HTSWriter] cannot index " << format << " output" << endl;
+        exit(1);
+    }
+    
+    sort_memory = max<size_t>(memory_budget, 1);
+    sort_index_filename = index_filename;
+}
+
+/// Get the key to sort a BAM record by coordinate, the way samtools sort
+/// does. Unplaced records have a tid of -1, so they come last.
+static inline tuple<uint32_t, int64_t, bool> coordinate_sort_key(const bam1_t* b) {
+    return make_tuple((uint32_t) b->core.tid, (int64_t) b->core.pos, (bool) bam_is_rev(b));
+}
+
+/// Sort BAM records by coordinate, keeping ties in order.
+static void sort_by_coordinate(vector<bam1_t*>& records) {
+    std::stable_sort(records.begin(), records.end(), [](const bam1_t* a, const bam1_t* b) {
+        return coordinate_sort_key(a) < coordinate_sort_key(b);
+    });
+}
+
+/// Open a temp file to hold a sorted run of BAM records, and write the header
+/// to it. Runs are compressed at the fastest level, which still makes them
+/// much smaller than the records are in memory.
+static samFile* open_sorted_run(const string& run_filename, bam_hdr_t* header) {
+    samFile* run = sam_open(run_filename.c_str(), "wb1");
+    if (run == nullptr || sam_hdr_write(run, header) != 0) {
+        cerr << "[vg::HTSWriter] error: failed to open temporary file " << run_filename << " for sorting" << endl;
+        exit(1);
+    }
+    return run;
+}
+
+/// Finish writing a temp file made by open_sorted_run().
+static void close_sorted_run(const string& run_filename, samFile* run) {
+    if (sam_close(run) != 0) {
+        cerr << "[vg::HTSWriter] error: failed to write temporary file " << run_filename << " for sorting" << endl;
+        exit(1);
+    }
+}
+
+string HTSWriter::spill_sorted_run(bam_hdr_t* header, vector<bam1_t*>& records) const {
+    sort_by_coordinate(records);
+    
+    string run_filename = temp_file::create();
+    samFile* run = open_sorted_run(run_filename, header);
+    for (auto& b : records) {
+        if (sam_write1(run, header, b) < 0) {
+            cerr << "[vg::HTSWriter] error: failed to write temporary file " << run_filename << " for sorting" << endl;
+            exit(1);
+        }
+        bam_destroy1(b);
+    }
+    records.clear();
+    close_sorted_run(run_filename, run);
+    
+    return run_filename;
+}
+
+void HTSWriter::merge_sorted_runs(bam_hdr_t* header, const vector<string>& run_filenames, vector<bam1_t*>& records,
+                                  samFile* out) {
+    
+    // Each run is a source of records, and the records in memory are one
+    // more, after all the runs.
+    size_t memory_source = run_filenames.size();
+    vector<samFile*> runs(run_filenames.size(), nullptr);
+    vector<bam_hdr_t*> run_headers(run_filenames.size(), nullptr);
+    vector<bam1_t*> heads(run_filenames.size() + 1, nullptr);
+    size_t next_record = 0;
+    
+    // Order the sources by the key of their next record, with ties going to
+    // the earlier source.
+    using head_t = pair<tuple<uint32_t, int64_t, bool>, size_t>;
+    priority_queue<head_t, vector<head_t>, greater<head_t>> queue;
+    
+    auto advance = [&](size_t source) {
+        if (source == memory_source) {
+            if (next_record < records.size()) {
+                heads[source] = records[next_record++];
+                queue.emplace(coordinate_sort_key(heads[source]), source);
+            }
+            return;
+        }
+        int status = sam_read1(runs[source], run_headers[source], heads[source]);
+        if (status < -1) {
+            cerr << "[vg::HTSWriter] error: failed to read temporary file " << run_filenames[source] << " for sorting" << endl;
+            exit(1);
+        }
+        if (status >= 0) {
+            queue.emplace(coordinate_sort_key(heads[source]), source);
+        }
+    };
+    
+    for (size_t i = 0; i < runs.size(); i++) {
+        runs[i] = sam_open(run_filenames[i].c_str(), "r");
+        if (runs[i] == nullptr || (run_headers[i] = sam_hdr_read(runs[i])) == nullptr) {
+            cerr << "[vg::HTSWriter] error: failed to read temporary file " << run_filenames[i] << " for sorting" << endl;
+            exit(1);
+        }
+        if (compression_pool.pool != nullptr) {
+            // Decompression can use the pool too. It's only an optimization.
+            hts_set_thread_pool(runs[i], &compression_pool);
+        }
+        heads[i] = bam_init1();
+        advance(i);
+    }
+    advance(memory_source);
+    
+    while (!queue.empty()) {
+        size_t winner = queue.top().second;
+        queue.pop();
+        if (sam_write1(out, header, heads[winner]) < 0) {
+            cerr << "[vg::HTSWriter] error: writing to output file failed" << endl;
+            exit(1);
+        }
+        advance(winner);
+    }
+    
+    for (size_t i = 0; i < runs.size(); i++) {
+        bam_destroy1(heads[i]);
+        bam_hdr_destroy(run_headers[i]);
+        sam_close(runs[i]);
+        temp_file::remove(run_filenames[i]);
+    }
+    for (auto& b : records) {
+        bam_destroy1(b);
+    }
+    records.clear();
+}
+
+void HTSWriter::write_sorted_output() {
+    bam_hdr_t* header = atomic_header.load();
+    
+    vector<string> run_filenames = std::move(sorted_runs);
+    sorted_runs.clear();
+    while (run_filenames.size() > max_sort_fan_in) {
+        // We can't merge them all at once, so merge consecutive runs of them,
+        // which keeps ties in order.
+        vector<string> merged_filenames;
+        vector<bam1_t*> no_records;
+        for (size_t start = 0; start < run_filenames.size(); start += max_sort_fan_in) {
+            size_t end = min(start + max_sort_fan_in, run_filenames.size());
+            string merged_filename = temp_file::create();
+            samFile* merged = open_sorted_run(merged_filename, header);
+            merge_sorted_runs(header, vector<string>(run_filenames.begin() + start, run_filenames.begin() + end),
+                              no_records, merged);
+            close_sorted_run(merged_filename, merged);
+            merged_filenames.push_back(merged_filename);
+        }
+        run_filenames = std::move(merged_filenames);
+    }
+    
+    // Nothing has gone through the multiplexer, so we can write the whole
+    // file from one samFile* directly on the output stream. The index needs
+    // that, because it records offsets in the file.
+    hFILE* backing_file = vg::io::hfile_wrap(out_file.get() != nullptr ? *out_file : cout);
+    samFile* out = hts_hopen(backing_file, "-", hts_mode.c_str());
+    if (out == nullptr) {
+        cerr << "[vg::HTSWriter] failed to open output stream for writing sorted " << format << " output" << endl;
+        exit(1);
+    }
+    if (compression_pool.pool != nullptr && hts_set_thread_pool(out, &compression_pool) != 0) {
+        cerr << "[vg::HTSWriter] failed to attach compression threads for writing " << format << " output" << endl;
+        exit(1);
+    }
+    if (sam_hdr_write(out, header) != 0) {
+        cerr << "[vg::HTSWriter] error: failed to write the SAM header" << endl;
+        exit(1);
+    }
+    
+    bool make_index = !sort_index_filename.empty();
+    if (make_index) {
+        // A min_shift of 0 makes a BAI (or CRAI) index, and CSI uses the
+        // usual 16 kb bins.
+        size_t suffix = sort_index_filename.size() >= 4 ? sort_index_filename.size() - 4 : 0;
+        int min_shift = sort_index_filename.substr(suffix) == ".csi" ? 14 : 0;
+        if (sam_idx_init(out, header, min_shift, sort_index_filename.c_str()) != 0) {
+            cerr << "[vg::HTSWriter] error: failed to start index " << sort_index_filename << endl;
+            exit(1);
+        }
+    }
+    
+    sort_by_coordinate(sort_buffer);
+    merge_sorted_runs(header, run_filenames, sort_buffer, out);
+    sort_buffer_bytes = 0;
+    
+    if (make_index && sam_idx_save(out) != 0) {
+        cerr << "[vg::HTSWriter] error: failed to save index " << sort_index_filename << endl;
+        exit(1);
+    }
+    if (sam_close(out) != 0) {
+        cerr << "[vg::HTSWriter] error: failed to finish writing sorted " << format << " output" << endl;
+        exit(1);
+    }
+}
+
 void HTSWriter::initialize_sam_file(bam_hdr_t* header, size_t thread_number, bool keep_header) {
     if (sam_files[thread_number] != nullptr) {
         // A samFile* has been created already. Clear it out.
@@ -380,6 +764,11 @@ void HTSWriter::initialize_sam_file(bam_hdr_t* header, size_t thread_number, boo
         exit(1);
     }
     
+    if (compression_pool.pool != nullptr && hts_set_thread_pool(sam_files[thread_number], &compression_pool) != 0) {
+        cerr << "[vg::HTSWriter] failed to attach compression threads for writing " << format << " output" << endl;
+        exit(1);
+    }
+    
     // Write the header again, which is the only way to re-initialize htslib's internals.
     // Remember that sam_hdr_write flushes the BGZF to the hFILE*, but does not flush the hFILE*.
     if (sam_hdr_write(sam_files[thread_number], header) != 0) {
@@ -404,8 +793,9 @@ void HTSWriter::initialize_sam_file(bam_hdr_t* header, size_t thread_number, boo
 }
 
 HTSAlignmentEmitter::HTSAlignmentEmitter(const string& filename, const string& format,
-                                         const vector<pair<string, int64_t>>& path_order_and_length, size_t max_threads)
-    : HTSWriter(filename, format, path_order_and_length, max_threads)
+                                         const vector<pair<string, int64_t>>& path_order_and_length, size_t max_threads,
+                                         size_t compression_threads)
+    : HTSWriter(filename, format, path_order_and_length, max_threads, compression_threads)
 {
     // nothing else to do
 }
@@ -495,7 +885,7 @@ void HTSAlignmentEmitter::emit_singles(vector<Alignment>&& aln_batch) {
     bam_hdr_t* header = ensure_header(aln_batch.front().read_group(),
                                       aln_batch.front().sample_name(), thread_number);
     assert(header != nullptr);
-    assert(sam_files[thread_number] != nullptr);
+    assert(sam_files[thread_number] != nullptr || compression_pool.pool != nullptr || sort_memory != 0);
     
     vector<bam1_t*> records;
     records.reserve(aln_batch.size());
@@ -534,7 +924,7 @@ void HTSAlignmentEmitter::emit_mapped_singles(vector<vector<Alignment>>&& alns_b
     bam_hdr_t* header = ensure_header(sniff->read_group(), sniff->sample_name(),
                                       thread_number);
     assert(header != nullptr);
-    assert(sam_files[thread_number] != nullptr);
+    assert(sam_files[thread_number] != nullptr || compression_pool.pool != nullptr || sort_memory != 0);
     
     vector<bam1_t*> records;
     records.reserve(count);
@@ -571,7 +961,7 @@ void HTSAlignmentEmitter::emit_pairs(vector<Alignment>&& aln1_batch,
     bam_hdr_t* header = ensure_header(aln1_batch.front().read_group(),
                                       aln1_batch.front().sample_name(), thread_number);
     assert(header != nullptr);
-    assert(sam_files[thread_number] != nullptr);
+    assert(sam_files[thread_number] != nullptr || compression_pool.pool != nullptr || sort_memory != 0);
     
     vector<bam1_t*> records;
     records.reserve(aln1_batch.size() * 2);
@@ -622,7 +1012,7 @@ void HTSAlignmentEmitter::emit_mapped_pairs(vector<vector<Alignment>>&& alns1_ba
     bam_hdr_t* header = ensure_header(sniff->read_group(), sniff->sample_name(),
                                       thread_number);
     assert(header != nullptr);
-    assert(sam_files[thread_number] != nullptr);
+    assert(sam_files[thread_number] != nullptr || compression_pool.pool != nullptr || sort_memory != 0);
     
     vector<bam1_t*> records;
     records.reserve(count);
@@ -641,8 +1031,8 @@ void HTSAlignmentEmitter::emit_mapped_pairs(vector<vector<Alignment>>&& alns1_ba
 SplicedHTSAlignmentEmitter::SplicedHTSAlignmentEmitter(const string& filename, const string& format,
                                                        const vector<pair<string, int64_t>>& path_order_and_length,
                                                        const PathPositionHandleGraph& graph,
-                                                       size_t max_threads) :
-    HTSAlignmentEmitter(filename, format, path_order_and_length, max_threads), graph(graph) {
+                                                       size_t max_threads, size_t compression_threads) :
+    HTSAlignmentEmitter(filename, format, path_order_and_length, max_threads, compression_threads), graph(graph) {
     
     // nothing else to do
 }
@@ -7,6 +7,8 @@
  * Defines a system for emitting alignments and groups of alignments in multiple formats.
  */
 
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include <thread>
 #include <vector>
@@ -15,6 +17,7 @@
 #include <htslib/hfile.h>
 #include <htslib/hts.h>
 #include <htslib/sam.h>
+#include <htslib/thread_pool.h>
 
 #include <vg/vg.pb.h>
 #include <vg/io/protobuf_emitter.hpp>
@@ -40,12 +43,22 @@ using namespace vg::io;
 /// alignments are spliced at known splice sites (i.e. edges in the graph), so
 /// form spliced CIGAR strings
 ///
+/// If hts_compression_threads is nonzero, BAM and CRAM records are handed off
+/// to be compressed by a dedicated pool of that many threads, instead of being
+/// compressed by the threads that emit them.
+///
+/// If hts_sort_memory is nonzero, HTSlib output is sorted by coordinate, using
+/// about that many bytes of memory and temp files beyond that, and is written
+/// when the emitter is destroyed. If hts_index_filename is also set, sorted
+/// BAM or CRAM output is indexed there.
+///
 /// Automatically applies per-thread buffering, but needs to know how many OMP
 /// threads will be in use.
 unique_ptr<AlignmentEmitter> get_alignment_emitter(const string& filename, const string& format, 
                                                    const vector<path_handle_t>& paths, size_t max_threads,
                                                    const HandleGraph* graph = nullptr, bool hts_raw = false,
-                                                   bool hts_spliced = false);
+                                                   bool hts_spliced = false, size_t hts_compression_threads = 0,
+                                                   size_t hts_sort_memory = 0, const string& hts_index_filename = "");
                                                    
 /**
  * Produce a list of path handles in a fixed order, suitable for use with
@@ -78,7 +91,13 @@ public:
     /// groups for the header will be guessed from the first reads. HTSlib
     /// positions will be read from the alignments' refpos, and the alignments
     /// must be surjected.
-    HTSWriter(const string& filename, const string& format, const vector<pair<string, int64_t>>& path_order_and_length, size_t max_threads);
+    ///
+    /// If compression_threads is nonzero and the format is compressed, the
+    /// threads calling save_records() just queue up their records, and a
+    /// single writer thread writes them in queue order, with the BGZF
+    /// compression done by a pool of compression_threads threads.
+    HTSWriter(const string& filename, const string& format, const vector<pair<string, int64_t>>& path_order_and_length,
+              size_t max_threads, size_t compression_threads = 0);
     
     /// Tear down an HTSWriter and destroy HTSlib structures.
     ~HTSWriter();
@@ -89,6 +108,27 @@ public:
     HTSWriter(HTSWriter&& other) = delete;
     HTSWriter& operator=(HTSWriter&& other) = delete;
     
+    /// Get the number of batches of records currently waiting to be written
+    /// by the compression threads. Always 0 if not using compression threads.
+    size_t queued_batch_count() const;
+    
+    /// Get the most batches of records that have been waiting to be written
+    /// by the compression threads at once.
+    size_t max_queued_batch_count() const;
+    
+    /// Get the number of times a thread had to wait to queue up its records
+    /// because the compression threads were behind.
+    size_t blocked_batch_count() const;
+    
+    /// Sort the output by coordinate, in the order of path_order_and_length,
+    /// instead of writing records as they arrive. About memory_budget bytes of
+    /// records are held in memory, and beyond that they are sorted and spilled
+    /// to temp files, which are all merged when the HTSWriter is destroyed. If
+    /// index_filename is set, the sorted BAM or CRAM output is also indexed
+    /// there (as CSI if it ends in ".csi", and otherwise as BAI or CRAI). Must
+    /// be called before any records are saved.
+    void set_sorted_output(size_t memory_budget, const string& index_filename = "");
+    
 protected:
     
     /// We hack about with htslib's BGZF EOF footers, so we need to know how long they are.
@@ -139,10 +179,81 @@ protected:
     /// Remember the HTSlib mode string we need to open our files.
     string hts_mode;
     
+    /// If we are compressing on a dedicated pool of threads, this is the pool
+    /// in the form HTSlib wants. Otherwise, its pool is null.
+    htsThreadPool compression_pool;
+    /// The writer thread uses this multiplexer stream, after all the others.
+    size_t writer_stream;
+    /// About how many bytes of records should the writer thread write between
+    /// flushes, which are when it checks for a multiplexer breakpoint?
+    size_t pool_flush_bytes = 4 * 1024 * 1024;
+    /// About how many bytes of records the writer thread has written since it
+    /// last flushed. Only the writer thread uses this.
+    size_t unflushed_bytes = 0;
+    /// The writer thread, which writes the queued records in order and hands
+    /// them off to the pool for compression.
+    thread writer_thread;
+    
+    /// Batches of records waiting for the writer thread
+    deque<vector<bam1_t*>> queued_batches;
+    /// How many batches may wait before threads have to wait to add more?
+    size_t max_queued_batches;
+    /// Set when the writer thread should stop once the queue is empty
+    bool writer_done = false;
+    /// Protects the queue and writer_done
+    mutex queue_mutex;
+    /// Signalled when a batch is added, or the writer is done
+    condition_variable queue_not_empty;
+    /// Signalled when a batch is taken out
+    condition_variable queue_not_full;
+    
+    /// Counters to watch the queue with
+    atomic<size_t> queue_depth;
+    atomic<size_t> max_queue_depth;
+    atomic<size_t> blocked_batches;
+    
+    /// If nonzero, we are sorting the output, and this is about how many bytes
+    /// of records to hold in memory before spilling them to a temp file.
+    size_t sort_memory = 0;
+    /// If sorting, where to put the index of the sorted output, if anywhere
+    string sort_index_filename;
+    /// What's the max fan-in when merging sorted temp files?
+    size_t max_sort_fan_in = 512;
+    /// Records waiting to be sorted
+    vector<bam1_t*> sort_buffer;
+    /// About how many bytes the records in sort_buffer use
+    size_t sort_buffer_bytes = 0;
+    /// Temp files holding sorted runs of records
+    vector<string> sorted_runs;
+    /// Protects sort_buffer, sort_buffer_bytes, and sorted_runs
+    mutex sort_mutex;
+    
     /// Write and deallocate a bunch of BAM records. Takes care of locking the
-    /// file. Header must have been written already.
+    /// file. Header must have been written already. If using compression
+    /// threads, may return before the records are written.
     void save_records(bam_hdr_t* header, vector<bam1_t*>& records, size_t thread_number);
     
+    /// Write and deallocate a bunch of BAM records to the samFile* for the given
+    /// multiplexer stream, opening it if necessary.
+    void write_records(bam_hdr_t* header, vector<bam1_t*>& records, size_t thread_number);
+    
+    /// Main loop for the writer thread.
+    void run_writer();
+    
+    /// Sort and deallocate a bunch of BAM records and write them to a new
+    /// temp file, which is returned.
+    string spill_sorted_run(bam_hdr_t* header, vector<bam1_t*>& records) const;
+    
+    /// Merge the given sorted temp files, and the given sorted records, and
+    /// write them to the given samFile*. The temp files are removed and the
+    /// records are deallocated.
+    void merge_sorted_runs(bam_hdr_t* header, const vector<string>& run_filenames, vector<bam1_t*>& records,
+                           samFile* out);
+    
+    /// Merge all the sorted records we have been given and write them out
+    /// directly, along with the header, bypassing the multiplexer.
+    void write_sorted_output();
+    
     /// Make sure that the HTS header has been written, and the samFile* in
     /// sam_files has been created for the given thread.
     ///
@@ -176,7 +287,8 @@ public:
     /// reads. HTSlib positions will be read from the alignments' refpos, and
     /// the alignments must be surjected.
     HTSAlignmentEmitter(const string& filename, const string& format,
-                        const vector<pair<string, int64_t>>& path_order_and_length, size_t max_threads);
+                        const vector<pair<string, int64_t>>& path_order_and_length, size_t max_threads,
+                        size_t compression_threads = 0);
     
     /// Tear down an HTSAlignmentEmitter and destroy HTSlib structures.
     ~HTSAlignmentEmitter() = default;
@@ -226,7 +338,7 @@ public:
     SplicedHTSAlignmentEmitter(const string& filename, const string& format,
                                const vector<pair<string, int64_t>>& path_order_and_length,
                                const PathPositionHandleGraph& graph,
-                               size_t max_threads);
+                               size_t max_threads, size_t compression_threads = 0);
     
     ~SplicedHTSAlignmentEmitter() = default;
     
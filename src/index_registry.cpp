@@ -10,12 +10,16 @@
 #include <random>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <chrono>
 #include <cctype>
 #include <cstdio>
 #include <cerrno>
 #include <omp.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <bdsg/hash_graph.hpp>
 #include <bdsg/packed_graph.hpp>
@@ -50,6 +54,7 @@
 #include "gfa.hpp"
 #include "job_schedule.hpp"
 #include "path.hpp"
+#include "memusage.hpp"
 
 #include "io/save_handle_graph.hpp"
 
@@ -81,6 +86,14 @@ static string to_string(const vg::IndexGroup& name) {
 namespace vg {
 
 
+// the memory that the recipe running on this thread gets, or -1 if we're not
+// running one
+static thread_local int64_t recipe_memory_target = -1;
+// the number of recipes running at once, in any registry
+static atomic<int> num_running_recipes(0);
+// the memory set aside for all of those recipes
+static atomic<int64_t> running_recipe_memory(0);
+
 IndexingParameters::MutableGraphImplementation IndexingParameters::mut_graph_impl = HashGraph;
 int IndexingParameters::max_node_size = 32;
 int IndexingParameters::pruning_max_node_degree = 128;
@@ -120,6 +133,21 @@ void copy_file(const string& from_fp, const string& to_fp) {
     to_file << from_file.rdbuf();
 }
 
+// hard link a file if we're allowed to and can, or else copy it, and report whether
+// either worked
+bool link_or_copy_file(const string& from_fp, const string& to_fp, bool allow_link) {
+    if (allow_link && link(from_fp.c_str(), to_fp.c_str()) == 0) {
+        return true;
+    }
+    ifstream from_file(from_fp, std::ios::binary);
+    ofstream to_file(to_fp, std::ios::binary);
+    if (!from_file || !to_file) {
+        return false;
+    }
+    to_file << from_file.rdbuf();
+    return bool(to_file);
+}
+
 // return file size in bytes
 int64_t get_file_size(const string& filename) {
     // get the file size
@@ -135,6 +163,44 @@ bool is_gzipped(const string& filename) {
     return false;
 }
 
+// give priority to the jobs that take at least a thread's share of the total
+// time, since they're the critical path, and shouldn't get stuck waiting
+// behind smaller jobs that happen to fit in memory
+vector<int64_t> long_job_priorities(const vector<pair<int64_t, int64_t>>& job_requirements) {
+    int64_t total_time = 0;
+    for (const auto& requirement : job_requirements) {
+        total_time += requirement.first;
+    }
+    int64_t num_threads = get_thread_count();
+    vector<int64_t> priorities(job_requirements.size(), 0);
+    for (size_t i = 0; i < job_requirements.size(); ++i) {
+        if (job_requirements[i].first * num_threads >= total_time) {
+            priorities[i] = 1;
+        }
+    }
+    return priorities;
+}
+
+// run the jobs in a schedule, with a timeline of their memory use if we're debugging
+void execute_job_schedule(JobSchedule& schedule, int64_t target_memory_usage) {
+    if (IndexingParameters::verbosity >= IndexingParameters::Debug) {
+        cerr << "[IndexRegistry]: Job schedule timeline:" << endl;
+        schedule.set_trace(&cerr);
+    }
+    // other recipes running alongside this one count against the process's
+    // memory use too, so we take out what they have set aside
+    int64_t own_memory = max<int64_t>(recipe_memory_target, 0);
+    schedule.set_rss_source([own_memory]() {
+        int64_t rss = int64_t(get_current_rss_kb()) * 1024;
+        if (num_running_recipes.load() > 1) {
+            rss -= running_recipe_memory.load() - own_memory;
+        }
+        // 0 means we don't know
+        return max<int64_t>(rss, 0);
+    });
+    schedule.execute(target_memory_usage);
+}
+
 int64_t get_num_samples(const string& vcf_filename) {
     htsFile* vcf_file = hts_open(vcf_filename.c_str(),"rb");
     bcf_hdr_t* header = bcf_hdr_read(vcf_file);
@@ -274,6 +340,31 @@ int64_t approx_graph_load_memory(const string& graph_filename) {
     return hash_graph_memory_usage * format_multiplier();
 }
 
+// estimate the memory to load all of the graphs in a recipe's first input
+int64_t approx_input_graph_load_memory(const vector<const IndexFile*>& inputs) {
+    int64_t memory = 0;
+    for (const auto& graph_filename : inputs.front()->get_filenames()) {
+        memory += approx_graph_load_memory(graph_filename);
+    }
+    return memory;
+}
+
+// estimate the memory to load all of a recipe's inputs as they are on disk
+int64_t approx_input_file_memory(const vector<const IndexFile*>& inputs) {
+    int64_t memory = 0;
+    for (const auto& input : inputs) {
+        for (const auto& filename : input->get_filenames()) {
+            memory += get_file_size(filename);
+        }
+    }
+    return memory;
+}
+
+// for recipes that pass their inputs along or stream through them
+int64_t no_recipe_memory(const vector<const IndexFile*>& inputs) {
+    return 0;
+}
+
 // returns true if the GTF/GFF has any non-header lines
 bool transcript_file_nonempty(const string& transcripts) {
     ifstream strm(transcripts);
@@ -454,7 +545,7 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
                                 const IndexGroup& constructing) {
         alias_graph.register_alias(*constructing.begin(), inputs[0]);
         return vector<vector<string>>(1, inputs.front()->get_filenames());
-    });
+    }, 1, no_recipe_memory);
     registry.register_recipe({"Chunked VCF"}, {"Chunked VCF w/ Phasing"},
                              [](const vector<const IndexFile*>& inputs,
                                 const IndexingPlan* plan,
@@ -462,7 +553,7 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
                                 const IndexGroup& constructing) {
         alias_graph.register_alias(*constructing.begin(), inputs[0]);
         return vector<vector<string>>(1, inputs.front()->get_filenames());
-    });
+    }, 1, no_recipe_memory);
     
     ////////////////////////////////////
     // Chunking Recipes
@@ -1565,8 +1656,8 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
                                                  approx_graph_load_memory(chunk_filename));
         }
         
-        JobSchedule schedule(approx_job_requirements, strip_chunk);
-        schedule.execute(plan->target_memory_usage());
+        JobSchedule schedule(approx_job_requirements, strip_chunk, long_job_priorities(approx_job_requirements));
+        execute_job_schedule(schedule, plan->target_memory_usage());
         
         // return the filename(s)
         return all_outputs;
@@ -1616,6 +1707,7 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
         auto graph = init_mutable_graph();
         
         // make the graph from GFA
+        auto load_start = chrono::steady_clock::now();
         try {
             algorithms::gfa_to_path_handle_graph(input_filename, graph.get(), true,
                                                  IndexingParameters::mut_graph_impl == IndexingParameters::ODGI);
@@ -1625,6 +1717,11 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
             cerr << e.what() << endl;
             exit(1);
         }
+        if (IndexingParameters::verbosity != IndexingParameters::None) {
+            chrono::duration<double> load_time = chrono::steady_clock::now() - load_start;
+            cerr << "[IndexRegistry]: Loaded GFA in " << load_time.count() << " seconds, peak memory "
+                 << get_max_rss_kb() / (1024.0 * 1024.0) << " GB." << endl;
+        }
         
         handlealgs::chop(*graph, IndexingParameters::max_node_size);
         
@@ -1862,8 +1959,8 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
         
         // construct the jobs in parallel, trying to use multithreading while also
         // restraining memory usage
-        JobSchedule schedule(approx_job_requirements, make_graph);
-        schedule.execute(plan->target_memory_usage());
+        JobSchedule schedule(approx_job_requirements, make_graph, long_job_priorities(approx_job_requirements));
+        execute_job_schedule(schedule, plan->target_memory_usage());
         
         // merge the ID spaces if we need to
         vector<nid_t> id_increment(1, 1 - node_id_ranges[0].first);
@@ -1904,8 +2001,8 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
                 vg::io::save_handle_graph(graph.get(), outfile);
             };
             
-            JobSchedule schedule(approx_job_requirements, increment_node_ids);
-            schedule.execute(plan->target_memory_usage());
+            JobSchedule schedule(approx_job_requirements, increment_node_ids, long_job_priorities(approx_job_requirements));
+            execute_job_schedule(schedule, plan->target_memory_usage());
         }
         
         // save the max node id as a simple text file
@@ -2122,7 +2219,7 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
             cerr << "[IndexRegistry]: Constructing XG graph from VG graph." << endl;
         }
         return make_xg_from_graph(inputs, plan, constructing);
-    });
+    }, 1, approx_input_graph_load_memory);
     
     registry.register_recipe({"Spliced XG"}, {"Spliced VG w/ Transcript Paths"},
                              [&](const vector<const IndexFile*>& inputs,
@@ -2133,7 +2230,7 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
             cerr << "[IndexRegistry]: Constructing spliced XG graph from spliced VG graph." << endl;
         }
         return make_xg_from_graph(inputs, plan, constructing);
-    });
+    }, 1, approx_input_graph_load_memory);
     
     ////////////////////////////////////
     // MaxNodeID Recipes
@@ -2354,8 +2451,8 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
         };
         
         
-        JobSchedule schedule(approx_job_requirements, gbwt_job);
-        schedule.execute(target_memory_usage);
+        JobSchedule schedule(approx_job_requirements, gbwt_job, long_job_priorities(approx_job_requirements));
+        execute_job_schedule(schedule, target_memory_usage);
         
         // merge GBWTs if necessary
         output_names.push_back(merge_gbwts(gbwt_names, plan, output_index));
@@ -2657,8 +2754,8 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
                                                  approx_graph_load_memory(graph_filenames[i]));
         }
         
-        JobSchedule schedule(approx_job_requirements, haplo_tx_job);
-        schedule.execute(target_memory_usage);
+        JobSchedule schedule(approx_job_requirements, haplo_tx_job, long_job_priorities(approx_job_requirements));
+        execute_job_schedule(schedule, target_memory_usage);
         
         // merge the GBWT chunks
         haplo_tx_gbwt_names.push_back(merge_gbwts(gbwt_chunk_names, plan, output_haplo_tx));
@@ -2713,7 +2810,7 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
         }
         all_outputs[0].push_back(output_name);
         return all_outputs;
-    });
+    }, 1, no_recipe_memory);
     
     ////////////////////////////////////
     // Pruned VG Recipes
@@ -2876,8 +2973,8 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
                                                  (using_haplotypes ? 1 : 2) * approx_graph_load_memory(graph_names[i]));
         }
         
-        JobSchedule schedule(approx_job_requirements, prune_job);
-        schedule.execute(target_memory_usage);
+        JobSchedule schedule(approx_job_requirements, prune_job, long_job_priorities(approx_job_requirements));
+        execute_job_schedule(schedule, target_memory_usage);
         
         return all_outputs;
     };
@@ -3178,6 +3275,8 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
         unique_ptr<SnarlManager> snarl_manager = unique_ptr<SnarlManager>(new SnarlManager(infile_snarls));
         
         MinimumDistanceIndex distance_index(graph.get(), snarl_manager.get());
+        // Giraffe can memory-map the flat layout instead of reading it in
+        distance_index.set_flat_layout(true);
         
         vg::io::VPKG::save(distance_index, output_name);
         
@@ -3241,7 +3340,7 @@ IndexRegistry VGIndexes::get_vg_index_registry() {
 
         output_names.push_back(output_name);
         return all_outputs;
-    });
+    }, 1, approx_input_file_memory);
 
     // This used to be a GBWTGraph recipe, but we don't want to produce GBWTGraphs anymore.
     registry.register_recipe({"Giraffe GBZ"}, {"Giraffe GBWT", "XG"},
@@ -3380,6 +3479,9 @@ bool IndexingPlan::is_intermediate(const IndexName& identifier) const {
 }
 
 int64_t IndexingPlan::target_memory_usage() const {
+    if (recipe_memory_target >= 0) {
+        return recipe_memory_target;
+    }
     return IndexingParameters::max_memory_proportion * registry->get_target_memory_usage();
 }
     
@@ -3424,7 +3526,8 @@ IndexRegistry::IndexRegistry(IndexRegistry&& other) :
     registered_suffixes(std::move(other.registered_suffixes)),
     work_dir(std::move(other.work_dir)),
     output_prefix(std::move(other.output_prefix)),
-    keep_intermediates(std::move(other.keep_intermediates)) {
+    keep_intermediates(std::move(other.keep_intermediates)),
+    cache_dir(std::move(other.cache_dir)) {
     
     // Make sure other doesn't delete our work dir when it goes away
     other.work_dir.clear();
@@ -3437,6 +3540,7 @@ IndexRegistry& IndexRegistry::operator=(IndexRegistry&& other) {
     work_dir = std::move(other.work_dir);
     output_prefix = std::move(other.output_prefix);
     keep_intermediates = std::move(other.keep_intermediates);
+    cache_dir = std::move(other.cache_dir);
     
     // Make sure other doesn't delete our work dir when it goes away
     other.work_dir.clear();
@@ -3456,6 +3560,10 @@ void IndexRegistry::set_intermediate_file_keeping(bool keep_intermediates) {
     this->keep_intermediates = keep_intermediates;
 }
 
+void IndexRegistry::set_cache_dir(const string& cache_dir) {
+    this->cache_dir = cache_dir;
+}
+
 void IndexRegistry::make_indexes(const vector<IndexName>& identifiers) {
     
     // figure out the best plan to make the objectives from the inputs
@@ -3468,20 +3576,190 @@ void IndexRegistry::make_indexes(const vector<IndexName>& identifiers) {
     // to keep track of which indexes are aliases of others
     AliasGraph alias_graph;
     
-    // execute the plan
-    for (const auto& step : plan.steps) {
-        indexing_results[step.first] = execute_recipe(step, &plan, alias_graph);
-        assert(indexing_results[step.first].size() == step.first.size());
-        auto it = step.first.begin();
-        for (const auto& results : indexing_results[step.first]) {
-            auto index = get_index(*it);
-            if (!index->is_finished()) {
-                // the index wasn't already provided directly
-                index->assign_constructed(results);
+    // the hashes that identify the indexes in the cache, if we're using it
+    map<IndexName, string> index_hashes;
+    
+    // figure out which steps of the plan need which others to finish first
+    vector<vector<size_t>> prerequisites(plan.steps.size());
+    {
+        map<IndexName, size_t> made_at_step;
+        for (size_t i = 0; i < plan.steps.size(); ++i) {
+            const auto& recipe = recipe_registry.at(plan.steps[i].first).at(plan.steps[i].second);
+            for (auto input : recipe.inputs) {
+                auto it = made_at_step.find(input->get_identifier());
+                if (it != made_at_step.end()) {
+                    prerequisites[i].push_back(it->second);
+                }
+            }
+            for (const auto& identifier : plan.steps[i].first) {
+                made_at_step[identifier] = i;
             }
-            ++it;
         }
     }
+    
+    if (!plan.steps.empty()) {
+        // make sure the recipes don't race to make this
+        get_work_dir();
+    }
+    
+    // everything below is shared with the recipes' threads, and protected by this
+    mutex step_lock;
+    condition_variable step_finished;
+    vector<bool> started(plan.steps.size(), false);
+    vector<bool> finished(plan.steps.size(), false);
+    vector<size_t> newly_finished;
+    vector<vector<vector<string>>> step_results(plan.steps.size());
+    vector<string> step_hashes(plan.steps.size());
+    exception_ptr recipe_exception;
+    
+    // the threads and memory that each running step has
+    vector<int> step_threads(plan.steps.size(), 0);
+    int total_threads = get_thread_count();
+    int free_threads = total_threads;
+    vector<int64_t> step_memory(plan.steps.size(), 0);
+    int64_t total_memory = IndexingParameters::max_memory_proportion * get_target_memory_usage();
+    int64_t free_memory = total_memory;
+    
+    vector<thread> workers;
+    size_t num_finished = 0;
+    unique_lock<mutex> lock(step_lock);
+    while (num_finished < plan.steps.size()) {
+        
+        // start everything we can, in plan order
+        for (size_t i = 0; i < plan.steps.size() && !recipe_exception; ++i) {
+            if (started[i] || !all_of(prerequisites[i].begin(), prerequisites[i].end(),
+                                      [&](size_t j) { return finished[j]; })) {
+                continue;
+            }
+            const auto& step = plan.steps[i];
+            const auto& recipe = recipe_registry.at(step.first).at(step.second);
+            int wanted_threads = recipe.max_threads == 0 ? total_threads : min(recipe.max_threads, total_threads);
+            // a recipe that wants many threads can start with fewer, but not so few that
+            // it would be better off waiting for more
+            if (free_threads < min(wanted_threads, max(total_threads / 2, 1))) {
+                continue;
+            }
+            int threads = min(wanted_threads, free_threads);
+            int64_t memory = recipe.memory_estimate ? recipe.memory_estimate(recipe.inputs)
+                                                    : int64_t(double(threads) / total_threads * total_memory);
+            if (workers.size() > num_finished) {
+                // something else is running, so we can only start if we fit
+                // in what it left, and it hasn't already gone over
+                if (memory > free_memory || int64_t(get_current_rss_kb()) * 1024 > total_memory) {
+                    continue;
+                }
+            }
+            free_threads -= threads;
+            step_threads[i] = threads;
+            free_memory -= memory;
+            step_memory[i] = memory;
+            started[i] = true;
+            
+            if (IndexingParameters::verbosity >= IndexingParameters::Debug) {
+                cerr << "[IndexRegistry]: Starting " << to_string(step.first) << " with " << threads << " threads and "
+                     << memory / (1024.0 * 1024.0 * 1024.0) << " GB of memory." << endl;
+            }
+            
+            // the recipe hashes its inputs on its own thread, from the hashes we know now
+            map<IndexName, string> input_hashes;
+            if (!cache_dir.empty()) {
+                input_hashes = index_hashes;
+            }
+            workers.emplace_back([&, i, threads, memory, input_hashes]() mutable {
+                // give the recipe its threads and memory
+                omp_set_num_threads(threads);
+                recipe_memory_target = memory;
+                ++num_running_recipes;
+                running_recipe_memory += memory;
+                
+                const auto& step = plan.steps[i];
+                vector<vector<string>> results;
+                string hash;
+                try {
+                    if (!cache_dir.empty()) {
+                        hash = recipe_hash(step, input_hashes);
+                    }
+                    bool cached = false;
+                    if (!hash.empty()) {
+                        cached = load_cached_results(hash, step, plan, results);
+                        if (cached && IndexingParameters::verbosity >= IndexingParameters::Basic) {
+                            cerr << "[IndexRegistry]: Reusing cached " << to_string(step.first) << "." << endl;
+                        }
+                    }
+                    if (!cached) {
+                        results = execute_recipe(step, &plan, alias_graph);
+                        if (!hash.empty()) {
+                            save_cached_results(hash, step, results);
+                        }
+                    }
+                }
+                catch (...) {
+                    lock_guard<mutex> guard(step_lock);
+                    if (!recipe_exception) {
+                        recipe_exception = current_exception();
+                    }
+                }
+                
+                --num_running_recipes;
+                running_recipe_memory -= memory;
+                {
+                    lock_guard<mutex> guard(step_lock);
+                    step_results[i] = std::move(results);
+                    step_hashes[i] = hash;
+                    // remember the provided inputs we hashed, so other recipes needn't
+                    index_hashes.insert(input_hashes.begin(), input_hashes.end());
+                    newly_finished.push_back(i);
+                }
+                step_finished.notify_all();
+            });
+        }
+        
+        if (recipe_exception && num_finished + newly_finished.size() == workers.size()) {
+            // all the recipes that were running have stopped, so we can pass the failure along
+            break;
+        }
+        
+        step_finished.wait(lock, [&]() { return !newly_finished.empty(); });
+        
+        for (size_t i : newly_finished) {
+            const auto& step = plan.steps[i];
+            free_threads += step_threads[i];
+            free_memory += step_memory[i];
+            finished[i] = true;
+            ++num_finished;
+            if (recipe_exception) {
+                continue;
+            }
+            
+            indexing_results[step.first] = std::move(step_results[i]);
+            assert(indexing_results[step.first].size() == step.first.size());
+            auto it = step.first.begin();
+            for (const auto& results : indexing_results[step.first]) {
+                auto index = get_index(*it);
+                if (!index->is_finished()) {
+                    // the index wasn't already provided directly
+                    index->assign_constructed(results);
+                }
+                ++it;
+            }
+            if (!cache_dir.empty()) {
+                // later recipes know these indexes by the recipe that made them
+                for (const auto& identifier : step.first) {
+                    index_hashes[identifier] = sha1sum(step_hashes[i] + "\t" + identifier);
+                }
+            }
+        }
+        newly_finished.clear();
+    }
+    lock.unlock();
+    
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (recipe_exception) {
+        rethrow_exception(recipe_exception);
+    }
+    
 #ifdef debug_index_registry
     cerr << "finished executing recipes, resolving aliases" << endl;
 #endif
@@ -3537,6 +3815,165 @@ void IndexRegistry::make_indexes(const vector<IndexName>& identifiers) {
     // different set of indexes, you will need to call reset() yourself.
 }
 
+string IndexRegistry::recipe_hash(const RecipeName& recipe_name, map<IndexName, string>& index_hashes) const {
+    
+    stringstream strm;
+    // change this if the cache stops being compatible
+    strm << "vg autoindex cache 1" << endl;
+    strm << to_string(recipe_name.first) << "\t" << recipe_name.second << endl;
+    for (auto input : recipe_registry.at(recipe_name.first).at(recipe_name.second).inputs) {
+        auto it = index_hashes.find(input->get_identifier());
+        if (it == index_hashes.end()) {
+            // we didn't make this, so it was provided, and we identify it by its contents
+            SHA1 checksum;
+            for (const auto& filename : input->get_filenames()) {
+                ifstream infile(filename, ios::binary);
+                if (!infile) {
+                    cerr << "error:[IndexRegistry] Couldn't open input file " << filename << endl;
+                    exit(1);
+                }
+                checksum.update(infile);
+                checksum.update("\n");
+            }
+            it = index_hashes.emplace(input->get_identifier(), checksum.final()).first;
+        }
+        strm << input->get_identifier() << "\t" << it->second << endl;
+    }
+    // the parameters that change what the recipes make
+    strm << IndexingParameters::mut_graph_impl << "\t"
+         << IndexingParameters::max_node_size << "\t"
+         << IndexingParameters::pruning_max_node_degree << "\t"
+         << IndexingParameters::pruning_walk_length << "\t"
+         << IndexingParameters::pruning_max_edge_count << "\t"
+         << IndexingParameters::pruning_min_component_size << "\t"
+         << IndexingParameters::gcsa_initial_kmer_length << "\t"
+         << IndexingParameters::gcsa_doubling_steps << "\t"
+         << IndexingParameters::gbwt_sampling_interval << "\t"
+         << IndexingParameters::bidirectional_haplo_tx_gbwt << "\t"
+         << IndexingParameters::gff_feature_name << "\t"
+         << IndexingParameters::gff_transcript_tag << "\t"
+         << IndexingParameters::use_bounded_syncmers << "\t"
+         << IndexingParameters::minimizer_k << "\t"
+         << IndexingParameters::minimizer_w << "\t"
+         << IndexingParameters::minimizer_s << "\t"
+         << IndexingParameters::path_cover_depth << "\t"
+         << IndexingParameters::giraffe_gbwt_downsample << "\t"
+         << IndexingParameters::downsample_context_length << "\t"
+         << IndexingParameters::downsample_threshold << endl;
+    
+    return sha1sum(strm.str());
+}
+
+bool IndexRegistry::load_cached_results(const string& hash, const RecipeName& recipe_name, const IndexingPlan& plan,
+                                        vector<vector<string>>& results) const {
+    
+    // the entry only appears once it's complete, with a manifest of its files
+    string entry = cache_dir + "/" + hash;
+    ifstream manifest(entry + "/manifest");
+    if (!manifest) {
+        return false;
+    }
+    vector<vector<string>> cached(recipe_name.first.size());
+    string line;
+    while (getline(manifest, line)) {
+        // each line is: output number, file name, file size
+        stringstream line_strm(line);
+        size_t i;
+        string filename;
+        int64_t size;
+        if (!(line_strm >> i >> filename >> size) || i >= cached.size()) {
+            return false;
+        }
+        struct stat file_stat;
+        if (stat((entry + "/" + filename).c_str(), &file_stat) != 0 || file_stat.st_size != size) {
+            // something has happened to this file since we cached it
+            return false;
+        }
+        cached[i].push_back(entry + "/" + filename);
+    }
+    
+    results.clear();
+    results.resize(cached.size());
+    auto it = recipe_name.first.begin();
+    for (size_t i = 0; i < cached.size(); ++i, ++it) {
+        // temporary files are only ever written once, so we can share them with the cache,
+        // but saved files could get overwritten by a later run
+        bool allow_link = !keep_intermediates && plan.is_intermediate(*it);
+        for (size_t j = 0; j < cached[i].size(); ++j) {
+            string filename = plan.output_filepath(*it, j, cached[i].size());
+            if (!link_or_copy_file(cached[i][j], filename, allow_link)) {
+                cerr << "error:[IndexRegistry] Couldn't copy cached file " << cached[i][j] << " to " << filename << endl;
+                exit(1);
+            }
+            results[i].push_back(filename);
+        }
+    }
+    return true;
+}
+
+void IndexRegistry::save_cached_results(const string& hash, const RecipeName& recipe_name,
+                                        const vector<vector<string>>& results) {
+    
+    // recipes that just pass along (some of) their inputs aren't worth caching
+    unordered_set<string> input_filenames;
+    for (auto input : recipe_registry.at(recipe_name.first).at(recipe_name.second).inputs) {
+        for (const auto& filename : input->get_filenames()) {
+            input_filenames.insert(filename);
+        }
+    }
+    for (const auto& filenames : results) {
+        for (const auto& filename : filenames) {
+            if (input_filenames.count(filename)) {
+                return;
+            }
+        }
+    }
+    
+    // build the entry to the side, and then move it in all at once, so that a partial
+    // entry from a run that died can never be mistaken for a complete one
+    string entry = cache_dir + "/" + hash;
+    string staging = entry + ".tmp" + to_string(getpid());
+    mkdir(cache_dir.c_str(), 0777);
+    if (mkdir(staging.c_str(), 0777) != 0) {
+        cerr << "warning:[IndexRegistry] Couldn't create cache directory " << staging << endl;
+        return;
+    }
+    
+    vector<string> cached_filenames;
+    stringstream manifest;
+    bool success = true;
+    auto it = recipe_name.first.begin();
+    for (size_t i = 0; i < results.size() && success; ++i, ++it) {
+        for (size_t j = 0; j < results[i].size() && success; ++j) {
+            string filename = sha1sum(*it) + "." + to_string(j) + "." + get_index(*it)->get_suffix();
+            // files in the work directory are never overwritten, so we can share them
+            bool allow_link = !work_dir.empty() && results[i][j].compare(0, work_dir.size() + 1, work_dir + "/") == 0;
+            success = link_or_copy_file(results[i][j], staging + "/" + filename, allow_link);
+            cached_filenames.push_back(staging + "/" + filename);
+            manifest << i << "\t" << filename << "\t" << get_file_size(results[i][j]) << endl;
+        }
+    }
+    if (success) {
+        ofstream manifest_file(staging + "/manifest");
+        manifest_file << manifest.str();
+        success = bool(manifest_file);
+        cached_filenames.push_back(staging + "/manifest");
+    }
+    if (!success || rename(staging.c_str(), entry.c_str()) != 0) {
+        // we couldn't write it, or it's already there
+        if (!success) {
+            cerr << "warning:[IndexRegistry] Couldn't save " << to_string(recipe_name.first) << " in cache" << endl;
+        }
+        for (const auto& filename : cached_filenames) {
+            std::remove(filename.c_str());
+        }
+        rmdir(staging.c_str());
+    }
+    else if (IndexingParameters::verbosity >= IndexingParameters::Debug) {
+        cerr << "[IndexRegistry]: Cached " << to_string(recipe_name.first) << " in " << entry << "." << endl;
+    }
+}
+
 void IndexRegistry::register_index(const IndexName& identifier, const string& suffix) {
     // Add this index to the registry
     if (identifier.empty()) {
@@ -3621,7 +4058,9 @@ vector<IndexName> IndexRegistry::completed_indexes() const {
 
 RecipeName IndexRegistry::register_recipe(const vector<IndexName>& identifiers,
                                           const vector<IndexName>& input_identifiers,
-                                          const RecipeFunc& exec) {
+                                          const RecipeFunc& exec,
+                                          int max_threads,
+                                          const RecipeMemoryFunc& memory_estimate) {
     
     for (const IndexName& identifier : identifiers) {
         if (!index_registry.count(identifier)) {
@@ -3682,7 +4121,7 @@ RecipeName IndexRegistry::register_recipe(const vector<IndexName>& identifiers,
 #endif
     
     bool first_group_entry = !recipe_registry.count(output_group);
-    recipe_registry[output_group].emplace_back(inputs, exec);
+    recipe_registry[output_group].emplace_back(inputs, exec, max_threads, memory_estimate);
     RecipeName name(output_group, recipe_registry[output_group].size() - 1);
         
     if (output_group.size() > 1 && first_group_entry) {
@@ -3698,7 +4137,7 @@ RecipeName IndexRegistry::register_recipe(const vector<IndexName>& identifiers,
                                 AliasGraph& alias_graph,
                                 const IndexGroup& constructing) {
                 return vector<vector<string>>(1, inputs[i]->get_filenames());
-            });
+            }, 1, no_recipe_memory);
             ++it;
         }
     }
@@ -4629,8 +5068,9 @@ void IndexFile::reset() {
 }
 
 IndexRecipe::IndexRecipe(const vector<const IndexFile*>& inputs,
-                         const RecipeFunc& exec) :
-    exec(exec), inputs(inputs)
+                         const RecipeFunc& exec, int max_threads,
+                         const RecipeMemoryFunc& memory_estimate) :
+    exec(exec), inputs(inputs), max_threads(max_threads), memory_estimate(memory_estimate)
 {
     // nothing more to do
 }
@@ -4650,6 +5090,7 @@ IndexGroup IndexRecipe::input_group() const {
 
 void AliasGraph::register_alias(const IndexName& aliasor, const IndexFile* aliasee) {
     assert(aliasee->get_identifier() != aliasor);
+    lock_guard<mutex> guard(graph_lock);
     graph[aliasee->get_identifier()].emplace_back(aliasor);
 }
 
@@ -11,6 +11,7 @@
 #include <memory>
 #include <stdexcept>
 #include <limits>
+#include <mutex>
 
 namespace vg {
 
@@ -49,6 +50,12 @@ using RecipeFunc = function<vector<vector<string>>(const vector<const IndexFile*
                                                    AliasGraph&,
                                                    const IndexGroup&)>;
 
+/**
+ * Estimates how many bytes of memory a recipe will use, from its finished
+ * input indexes.
+ */
+using RecipeMemoryFunc = function<int64_t(const vector<const IndexFile*>&)>;
+
 /**
  * Is a recipe to create the files (returned by name) associated with some
  * indexes, from a series of input indexes, given the plan they are being
@@ -211,14 +218,28 @@ public:
     /// or the temp directory?
     void set_intermediate_file_keeping(bool keep_intermediates);
     
+    /// Keep the indexes that recipes make in this directory, keyed by a hash
+    /// of the recipe's inputs and the indexing parameters, and reuse them
+    /// instead of running the recipe again in later calls (or later runs)
+    /// that would make the same indexes. Empty (the default) to not cache.
+    void set_cache_dir(const string& cache_dir);
+    
     /// Register an index containing the given identifier
     void register_index(const IndexName& identifier, const string& suffix);
     
     /// Register a recipe to produce an index using other indexes
-    /// or input files. Also takes a for output as input
+    /// or input files. Also takes a for output as input. Recipes that can't
+    /// make use of many threads should give the most they can use, so that
+    /// other recipes can run alongside them, or 0 if there is no limit.
+    /// Recipes whose memory use doesn't adapt to the plan's target memory
+    /// usage should also give an estimate of how much they need, so they
+    /// only run alongside other recipes when it fits. Without one, a recipe
+    /// gets its threads' share of the target.
     RecipeName register_recipe(const vector<IndexName>& identifiers,
                                const vector<IndexName>& input_identifiers,
-                               const RecipeFunc& exec);
+                               const RecipeFunc& exec,
+                               int max_threads = 0,
+                               const RecipeMemoryFunc& memory_estimate = nullptr);
                         
 //    /// Register a recipe to produce multiple indexes.
 //    /// Individual index recipes must still be registered; this recipe will be
@@ -260,7 +281,8 @@ public:
     
     /// Create and execute a plan to make the indicated indexes using provided inputs
     /// If provided inputs cannot create the desired indexes, throws a
-    /// InsufficientInputException.
+    /// InsufficientInputException. Steps of the plan that don't depend on each
+    /// other are run at the same time, splitting up the threads and memory.
     /// When completed, all requested index files will be available via require().
     void make_indexes(const vector<IndexName>& identifiers);
     
@@ -289,6 +311,22 @@ protected:
     vector<vector<string>> execute_recipe(const RecipeName& recipe_name, const IndexingPlan* plan,
                                           AliasGraph& alias_graph);
     
+    /// Get the hash that identifies the results of a recipe in the cache, from
+    /// the recipe, the hashes of its inputs, and the indexing parameters. Inputs
+    /// that aren't in the table of known hashes must have been provided, and
+    /// get added to it, hashed by content.
+    string recipe_hash(const RecipeName& recipe_name, map<IndexName, string>& index_hashes) const;
+    
+    /// Find the results of the recipe with this hash in the cache, and put
+    /// them where the plan says the indexes go. Returns false if they aren't
+    /// in the cache, or aren't intact.
+    bool load_cached_results(const string& hash, const RecipeName& recipe_name, const IndexingPlan& plan,
+                             vector<vector<string>>& results) const;
+    
+    /// Add the results of the recipe with this hash to the cache.
+    void save_cached_results(const string& hash, const RecipeName& recipe_name,
+                             const vector<vector<string>>& results);
+    
     /// access index file
     IndexFile* get_index(const IndexName& identifier);
     
@@ -324,6 +362,9 @@ protected:
     /// should intermediate files end up in the scratch or the output directory?
     bool keep_intermediates = false;
     
+    /// directory to cache the results of recipes in, or empty to not cache
+    string cache_dir;
+    
     /// the max memory we will *attempt* to use
     int64_t target_memory_usage = numeric_limits<int64_t>::max();
 };
@@ -381,13 +422,19 @@ private:
  */
 struct IndexRecipe {
     IndexRecipe(const vector<const IndexFile*>& inputs,
-                const RecipeFunc& exec);
+                const RecipeFunc& exec, int max_threads = 0,
+                const RecipeMemoryFunc& memory_estimate = nullptr);
     // execute the recipe and return the filename(s) of the indexes created
     vector<vector<string>> execute(const IndexingPlan* plan, AliasGraph& alias_graph,
                                    const IndexGroup& constructing) const;
     IndexGroup input_group() const;
     vector<const IndexFile*> inputs;
     RecipeFunc exec;
+    // the most threads the recipe can use, or 0 for no limit
+    int max_threads;
+    // estimates the memory the recipe needs, or null if it uses its share
+    // of the target memory usage
+    RecipeMemoryFunc memory_estimate;
 };
 
 /**
@@ -412,6 +459,9 @@ private:
     // graph aliasees to their aliasors
     unordered_map<IndexName, vector<IndexName>> graph;
     
+    // recipes running at the same time may register aliases together
+    mutex graph_lock;
+    
 };
 
 
@@ -19,9 +19,16 @@ void register_loader_saver_distance_index() {
     // The distance index header is just a text string. We need to make sure
     // this looks like a bare distance index file if we are going to load it
     // without type-tagged message deserialization.
-    Registry::register_bare_loader_saver_with_magic<MinimumDistanceIndex>("DISTANCE", "distance index", [](istream& input) -> void* {
-        // Allocate an index and hand it the stream
-        MinimumDistanceIndex* index = new MinimumDistanceIndex(input);
+    Registry::register_bare_loader_saver_with_magic<MinimumDistanceIndex>("DISTANCE", "distance index", [](istream& input, const string& filename) -> void* {
+        // Allocate an index
+        MinimumDistanceIndex* index = new MinimumDistanceIndex();
+
+        // Map it from the file if we can, so the flat layout can be used in
+        // place and shared with other processes through the page cache.
+        // Otherwise, including for pipes, hand it the stream we already have.
+        if (filename.empty() || filename == "-" || !index->load_mapped(filename)) {
+            index->load(input);
+        }
         
         // Return it so the caller owns it.
         return (void*) index;
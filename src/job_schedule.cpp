@@ -6,77 +6,209 @@
 #include <thread>
 #include <chrono>
 #include <mutex>
-#include <atomic>
+#include <condition_variable>
+#include <unordered_map>
+#include <algorithm>
 
 #include "utility.hpp"
+#include "memusage.hpp"
 
 namespace vg {
 
 using namespace std;
 
+const int64_t JobSchedule::rss_sample_interval_ms = 250;
+const double JobSchedule::min_memory_scale = 0.1;
+const double JobSchedule::max_memory_scale = 10.0;
+
 JobSchedule::JobSchedule(const vector<pair<int64_t, int64_t>>& job_requirements,
-                         const function<void(int64_t)>& job_func)
-    : job_func(job_func)
+                         const function<void(int64_t)>& job_func,
+                         const vector<int64_t>& job_priorities)
+    : job_func(job_func), rss_source([]() { return int64_t(get_current_rss_kb()) * 1024; })
 {
-    for (int64_t i = 0; i < job_requirements.size(); ++i) {
-        queue.emplace_back(job_requirements[i].second, i);
+    for (size_t i = 0; i < job_requirements.size(); ++i) {
+        queue.emplace_back(job_priorities.empty() ? 0 : job_priorities[i], job_requirements[i].second, i);
     }
-    // sort in decreasing order by time required
-    queue.sort([&](const pair<int64_t, int64_t>& a,
-                   const pair<int64_t, int64_t>& b) {
-        return job_requirements[a.second].first > job_requirements[b.second].first;
+    // sort in decreasing order by priority, and then by time required
+    queue.sort([&](const tuple<int64_t, int64_t, int64_t>& a,
+                   const tuple<int64_t, int64_t, int64_t>& b) {
+        if (get<0>(a) != get<0>(b)) {
+            return get<0>(a) > get<0>(b);
+        }
+        return job_requirements[get<2>(a)].first > job_requirements[get<2>(b)].first;
     });
 }
 
+void JobSchedule::set_trace(ostream* trace_stream) {
+    trace = trace_stream;
+}
+
+void JobSchedule::set_rss_source(const function<int64_t()>& rss_source) {
+    this->rss_source = rss_source;
+}
+
 void JobSchedule::execute(int64_t target_memory_usage) {
     
-    atomic<int64_t> est_memory_usage(0);
+    // memory that's in use before we start doesn't count against the jobs
+    int64_t baseline_rss = rss_source();
+    // we can't learn anything if we can't measure memory
+    bool measure_rss = baseline_rss != 0;
+    auto start_time = chrono::steady_clock::now();
+    auto seconds_since_start = [&]() {
+        return chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    };
+    
+    // everything below is protected by the queue lock
     mutex queue_lock;
+    // notified when a job finishes or memory is sampled, since either may
+    // let us start another job
+    condition_variable job_finished;
+    // notified when the sampler should stop
+    condition_variable all_done;
+    bool done = false;
+    
+    // the sum of the memory estimates of the running jobs
+    int64_t est_memory_usage = 0;
+    int64_t num_running = 0;
+    // the most recently sampled resident set size, if it could be measured
+    int64_t current_rss = baseline_rss;
+    bool rss_known = measure_rss;
+    // the learned ratio of real to estimated memory use, as the average of
+    // what we've seen from the finished jobs
+    double memory_scale = 1.0;
+    double observed_scale_sum = 0.0;
+    int64_t num_observed = 0;
+    
+    struct RunningJob {
+        double start = 0.0;
+        // the highest ratio of real (above baseline) to estimated memory use
+        // of all the running jobs seen while this one ran
+        double peak_scale = 0.0;
+        int64_t peak_rss = 0;
+        // whether memory couldn't be measured at some point while it ran
+        bool unmeasured = false;
+    };
+    unordered_map<int64_t, RunningJob> running_jobs;
+    
+    // record a sample of the resident set size, with the queue locked
+    auto record_rss = [&](int64_t rss) {
+        rss_known = rss != 0;
+        if (!rss_known) {
+            // we can't learn anything about the jobs that are running now
+            for (auto& running : running_jobs) {
+                running.second.unmeasured = true;
+            }
+            return;
+        }
+        current_rss = rss;
+        if (est_memory_usage > 0) {
+            double scale = double(max<int64_t>(rss - baseline_rss, 0)) / est_memory_usage;
+            for (auto& running : running_jobs) {
+                running.second.peak_scale = max(running.second.peak_scale, scale);
+                running.second.peak_rss = max(running.second.peak_rss, rss);
+            }
+        }
+    };
+    
+    if (trace) {
+        *trace << "#job\tpriority\tstart\tend\testimated_bytes\tpeak_rss_bytes\tmemory_scale" << endl;
+    }
+    
+    // watch the memory use while jobs are running
+    thread sampler;
+    if (measure_rss) {
+        sampler = thread([&]() {
+            while (true) {
+                int64_t rss = rss_source();
+                unique_lock<mutex> lock(queue_lock);
+                if (done) {
+                    break;
+                }
+                record_rss(rss);
+                // a job may have been waiting for memory that's now free
+                job_finished.notify_all();
+                all_done.wait_for(lock, chrono::milliseconds(rss_sample_interval_ms));
+            }
+        });
+    }
+    
     int num_threads = get_thread_count();
     vector<thread> workers;
     for (int i = 0; i < num_threads; ++i) {
         workers.emplace_back([&]() {
             while (true) {
                 
-                int64_t job_memory = -1, job_idx = -1;
-                queue_lock.lock();
+                int64_t priority = 0, job_memory = -1, job_idx = -1;
+                unique_lock<mutex> lock(queue_lock);
                 if (queue.empty()) {
                     // the queue emptied out while we were waiting
-                    queue_lock.unlock();
                     break;
                 }
-                if (est_memory_usage.load() == 0) {
+                if (num_running == 0) {
                     // even if we don't have the memory budget to do this job, we're
                     // going to have to at some point and the memory situation will
                     // never get any better than this
-                    tie(job_memory, job_idx) = queue.front();
+                    tie(priority, job_memory, job_idx) = queue.front();
                     queue.pop_front();
-                    est_memory_usage.fetch_add(job_memory);
                 }
                 else {
+                    // the running jobs use what we expect them to, given how far
+                    // off the estimates have been, or what they're actually using,
+                    // whichever is more
+                    int64_t memory_in_use = memory_scale * est_memory_usage;
+                    if (measure_rss && rss_known) {
+                        memory_in_use = max(memory_in_use, current_rss - baseline_rss);
+                    }
                     // find the longest-running job that can be done with the available
-                    // memory budget
-                    for (auto it = queue.begin(); it != queue.end(); ++it) {
-                        if (it->first + est_memory_usage.load() <= target_memory_usage) {
-                            tie(job_memory, job_idx) = *it;
+                    // memory budget, without passing over a higher priority job
+                    int64_t top_priority = get<0>(queue.front());
+                    for (auto it = queue.begin(); it != queue.end() && get<0>(*it) == top_priority; ++it) {
+                        if (memory_in_use + memory_scale * get<1>(*it) <= target_memory_usage) {
+                            tie(priority, job_memory, job_idx) = *it;
                             queue.erase(it);
-                            est_memory_usage.fetch_add(job_memory);
                             break;
                         }
                     }
                 }
-                queue_lock.unlock();
                 
                 if (job_idx == -1) {
-                    // there's nothing we can do right now, so back off a second
-                    // before trying again
-                    this_thread::sleep_for(chrono::seconds(1));
+                    // there's nothing we can do right now, so wait for something to
+                    // finish, or at least back off a second before trying again
+                    job_finished.wait_for(lock, chrono::seconds(1));
+                    continue;
                 }
-                else {
-                    // we think we have enough memory available to attempt this job
-                    job_func(job_idx);
-                    est_memory_usage.fetch_sub(job_memory);
+                
+                // we think we have enough memory available to attempt this job
+                est_memory_usage += job_memory;
+                ++num_running;
+                running_jobs[job_idx].start = seconds_since_start();
+                running_jobs[job_idx].unmeasured = !rss_known;
+                lock.unlock();
+                
+                job_func(job_idx);
+                
+                // see how much memory we ended up with, while we still count this job
+                int64_t rss = measure_rss ? rss_source() : 0;
+                lock.lock();
+                if (measure_rss) {
+                    record_rss(rss);
+                }
+                RunningJob finished = running_jobs[job_idx];
+                running_jobs.erase(job_idx);
+                est_memory_usage -= job_memory;
+                --num_running;
+                if (measure_rss && job_memory > 0 && !finished.unmeasured) {
+                    // learn from how far off the estimate was
+                    observed_scale_sum += min(max(finished.peak_scale, min_memory_scale), max_memory_scale);
+                    ++num_observed;
+                    memory_scale = observed_scale_sum / num_observed;
                 }
+                if (trace) {
+                    *trace << job_idx << '\t' << priority << '\t' << finished.start << '\t' << seconds_since_start()
+                           << '\t' << job_memory << '\t' << finished.peak_rss << '\t' << memory_scale << endl;
+                }
+                lock.unlock();
+                job_finished.notify_all();
             }
         });
     }
@@ -84,6 +216,13 @@ void JobSchedule::execute(int64_t target_memory_usage) {
     for (auto& worker : workers) {
         worker.join();
     }
+    if (sampler.joinable()) {
+        {
+            lock_guard<mutex> lock(queue_lock);
+            done = true;
+        }
+        all_done.notify_all();
+        sampler.join();
+    }
 }
 }
-
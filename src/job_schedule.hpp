@@ -10,6 +10,8 @@
 #include <queue>
 #include <cstdint>
 #include <list>
+#include <ostream>
+#include <tuple>
 
 namespace vg {
 
@@ -19,26 +21,59 @@ using namespace std;
  * A parallel job scheduler that tries to (if possible) respect a
  * cap on memory usage. Works best with a moderate number of
  * relatively large jobs.
+ *
+ * Memory estimates are checked against the process's actual resident
+ * set size while jobs run. The ratio of real to estimated memory use is
+ * learned as jobs finish, and used to scale the estimates of the jobs
+ * still waiting, so that bad estimates don't make us either run out of
+ * memory or leave it unused.
  */
 class JobSchedule {
 public:
-    
+
     // job requirements are given in pairs of (time estimate, memory estimate)
     // with the memory estimate being in bytes, and the time estimate in
     // arbitrary units
     // the job function should execute the i-th job when called
+    // optionally, jobs can be given priorities; a waiting job is never passed
+    // over for a job with lower priority (e.g. because it is on the critical
+    // path of some larger computation), and jobs are otherwise started
+    // longest first
     JobSchedule(const vector<pair<int64_t, int64_t>>& job_requirements,
-                const function<void(int64_t)>& job_func);
+                const function<void(int64_t)>& job_func,
+                const vector<int64_t>& job_priorities = vector<int64_t>());
     ~JobSchedule() = default;
-    
+
     // execute the job schedule with a target maximum memory usage
     void execute(int64_t target_memory_usage);
+
+    // write a timeline of the jobs to the given stream as they finish, as TSV
+    // with one line per job, giving its start and end time in seconds, its
+    // memory estimate, and the peak resident memory of the process while it
+    // ran, in bytes
+    void set_trace(ostream* trace_stream);
     
+    // measure the resident set size of the process in bytes with the given
+    // function instead of asking the OS, returning 0 if it's not known (e.g.
+    // because other work in the process would make it misleading), in which
+    // case the jobs running at the time aren't learned from
+    void set_rss_source(const function<int64_t()>& rss_source);
+
 private:
-    
+
     function<void(int64_t)> job_func;
-    list<pair<int64_t, int64_t>> queue;
+    // (priority, memory estimate, job index), in the order to try them
+    list<tuple<int64_t, int64_t, int64_t>> queue;
+
+    ostream* trace = nullptr;
     
+    function<int64_t()> rss_source;
+
+    // how often to sample the resident set size while jobs run
+    static const int64_t rss_sample_interval_ms;
+    // bounds on the learned ratio of real to estimated memory use
+    static const double min_memory_scale;
+    static const double max_memory_scale;
 };
 
 }
@@ -225,5 +225,15 @@ using namespace std;
                                                           const std::function<bool(const step_handle_t&, const bool&, const size_t&)>& iteratee) const {
         return graph->for_each_step_position_on_handle(handle, iteratee);
     }
+    
+    void MemoizingGraph::clear_memos() {
+        get_handle_memo.clear();
+        steps_of_handle_memo.clear();
+    }
+    
+    bool MemoizingGraph::memos_full() const {
+        return (get_handle_memo.size() >= max_handle_memo_size
+                || steps_of_handle_memo.size() >= max_steps_of_handle_memo_size);
+    }
 }
 
@@ -196,6 +196,12 @@ using namespace std;
         
     public:
         
+        /// Forget all of the memoized results
+        void clear_memos();
+        
+        /// Returns true if any of the memos has reached its maximum size
+        bool memos_full() const;
+        
         /// The largest number of calls to get_handle we will memoize
         size_t max_handle_memo_size = 500;
         
@@ -94,5 +94,21 @@ size_t get_current_vmem_kb() {
     return result;
 }
 
+size_t get_current_rss_kb() {
+    string value = get_proc_status_value("VmRSS");
+    
+    if (value == "") {
+        return 0;
+    }
+    
+    stringstream sstream(value);
+    
+    size_t result = 0;
+    
+    sstream >> result;
+    
+    return result;
+}
+
 
 }
@@ -4,6 +4,11 @@
 
 #include "min_distance.hpp"
 
+#include <fstream>
+#include <iterator>
+#include <mio/mmap.hpp>
+#include <sys/stat.h>
+
 using namespace std;
 namespace vg {
 
@@ -28,30 +33,30 @@ MinimumDistanceIndex::MinimumDistanceIndex(const HandleGraph* graph,
     max_node_id = graph->max_node_id();
 
     node_to_component.resize(max_node_id - min_node_id + 1);
-    sdsl::util::set_to_value(node_to_component, 0);
+    node_to_component.set_to_value(0);
 
     component_to_chain_index.resize(24);
-    sdsl::util::set_to_value(component_to_chain_index, 0);
+    component_to_chain_index.set_to_value(0);
 
     component_to_chain_length.resize(24);
-    sdsl::util::set_to_value(component_to_chain_length, 0);
+    component_to_chain_length.set_to_value(0);
 
     primary_snarl_assignments.resize(max_node_id - min_node_id + 1);
     primary_snarl_ranks.resize(max_node_id - min_node_id + 1);
-    sdsl::util::set_to_value(primary_snarl_assignments, 0);
-    sdsl::util::set_to_value(primary_snarl_ranks, 0);
+    primary_snarl_assignments.set_to_value(0);
+    primary_snarl_ranks.set_to_value(0);
 
     secondary_snarl_assignments.resize(max_node_id - min_node_id + 1);
     secondary_snarl_ranks.resize(max_node_id - min_node_id + 1);
-    sdsl::util::set_to_value(secondary_snarl_assignments, 0);
-    sdsl::util::set_to_value(secondary_snarl_ranks, 0);
+    secondary_snarl_assignments.set_to_value(0);
+    secondary_snarl_ranks.set_to_value(0);
     has_secondary_snarl_bv.resize(max_node_id - min_node_id + 1);
     sdsl::util::set_to_value(has_secondary_snarl_bv, 0);
 
     chain_assignments.resize(max_node_id - min_node_id + 1);
     chain_ranks.resize(max_node_id - min_node_id + 1);
-    sdsl::util::set_to_value(chain_assignments, 0);
-    sdsl::util::set_to_value(chain_ranks, 0);
+    chain_assignments.set_to_value(0);
+    chain_ranks.set_to_value(0);
     has_chain_bv.resize(max_node_id - min_node_id + 1);
     sdsl::util::set_to_value(has_chain_bv, 0);
 
@@ -65,47 +70,102 @@ MinimumDistanceIndex::MinimumDistanceIndex(const HandleGraph* graph,
     //Calculate minimum distance index
     const vector<const Snarl*> top_snarls = snarl_manager->top_level_snarls();
 
+    //Find the top-level chain of each connected component. Snarls that 
+    //aren't in a nontrivial chain are treated as chains of one snarl
+    vector<Chain> trivial_chains;
+    vector<pair<const Chain*, bool>> components;
     unordered_set<const Snarl*> seen_snarls;
-    size_t curr_component = 1;//Assign each connected component a unique identifier
     for (const Snarl* snarl : top_snarls) {
-       //Make an index for each disconnected snarl/chain
-        
         if (seen_snarls.count(snarl) == 0){
-
-            //Assign this connected component to the chain index we're about to make
-            if (component_to_chain_index.size() < curr_component) {
-                component_to_chain_index.resize(curr_component);
-            }
-            component_to_chain_index[curr_component-1] = chain_indexes.size();
-            int64_t chain_length;
-
-            //Calculate the index for this connected component
             if (snarl_manager->in_nontrivial_chain(snarl)){
                 //If this is an actual chain
                 const Chain* chain = snarl_manager->chain_of(snarl);
-
-                chain_length = calculate_min_index(graph, snarl_manager, chain, 
-                       0, false, false, 0, curr_component);
+                components.emplace_back(chain, false);
                 for (auto s : *chain) {
-                    //TODO: Do this earlier instead of another sweep through the chain
                     seen_snarls.insert(s.first);
                 }
             } else {
                 //If this is a trivial chain, pretend that its a chain
-                Chain curr_chain;
-                curr_chain.emplace_back(snarl, false);
-                chain_length = calculate_min_index(graph, snarl_manager, &curr_chain,
-                             0, false, true, 0, curr_component);
+                trivial_chains.emplace_back();
+                trivial_chains.back().emplace_back(snarl, false);
+                components.emplace_back(nullptr, true);
                 seen_snarls.insert(snarl);
             }
+        }
+    }
+    //Now that trivial_chains won't move, point to them
+    for (size_t i = 0, j = 0 ; i < components.size() ; i++) {
+        if (components[i].second) {
+            components[i].first = &trivial_chains[j++];
+        }
+    }
 
-            //Give this connected component a length
-            if (component_to_chain_length.size() < curr_component) {
-                component_to_chain_length.resize(curr_component+1);
-            }
-            component_to_chain_length[curr_component-1] = chain_length;
-            curr_component++;
+    //Connected components don't share any nodes, so they can be indexed in
+    //parallel, each into its own records
+    vector<ComponentBuild> builds(components.size());
+    vector<int64_t> chain_lengths(components.size());
+#pragma omp parallel for schedule(dynamic, 1)
+    for (size_t i = 0 ; i < components.size() ; i++) {
+        //Assign each connected component a unique identifier
+        chain_lengths[i] = calculate_min_index(graph, snarl_manager, components[i].first,
+                       0, false, components[i].second, 0, i + 1, builds[i]);
+    }
+
+    //Put the components' records together in order, and shift their nodes'
+    //assignments to point to where the records ended up
+    vector<size_t> snarl_offsets(components.size());
+    vector<size_t> chain_offsets(components.size());
+    size_t curr_component = 1;
+    for (size_t i = 0 ; i < components.size() ; i++) {
+        ComponentBuild& build = builds[i];
+        snarl_offsets[i] = snarl_indexes.size();
+        chain_offsets[i] = chain_indexes.size();
+
+        //Assign this connected component to its chain index
+        if (component_to_chain_index.size() < curr_component) {
+            component_to_chain_index.resize(curr_component);
+        }
+        component_to_chain_index[curr_component-1] = chain_indexes.size();
 
+        std::move(build.snarl_indexes.begin(), build.snarl_indexes.end(), std::back_inserter(snarl_indexes));
+        std::move(build.chain_indexes.begin(), build.chain_indexes.end(), std::back_inserter(chain_indexes));
+        for (size_t offset : build.chain_bits) {
+            has_chain_bv[offset] = 1;
+        }
+        for (size_t offset : build.secondary_snarl_bits) {
+            has_secondary_snarl_bv[offset] = 1;
+        }
+        tree_depth = std::max(tree_depth, build.tree_depth);
+        build = ComponentBuild();
+
+        //Give this connected component a length
+        if (component_to_chain_length.size() < curr_component) {
+            component_to_chain_length.resize(curr_component+1);
+        }
+        component_to_chain_length[curr_component-1] = chain_lengths[i];
+        curr_component++;
+    }
+    if (components.size() > 1) {
+#pragma omp parallel for
+        for (size_t j = 0 ; j < node_to_component.size() ; j++) {
+            size_t component = node_to_component[j];
+            if (component == 0) {
+                #ifdef debugIndex
+                assert(primary_snarl_assignments[j] == 0);
+                assert(secondary_snarl_assignments[j] == 0);
+                assert(chain_assignments[j] == 0);
+                #endif
+                continue;
+            }
+            if (primary_snarl_assignments[j] != 0) {
+                primary_snarl_assignments[j] = primary_snarl_assignments[j] + snarl_offsets[component-1];
+            }
+            if (secondary_snarl_assignments[j] != 0) {
+                secondary_snarl_assignments[j] = secondary_snarl_assignments[j] + snarl_offsets[component-1];
+            }
+            if (chain_assignments[j] != 0) {
+                chain_assignments[j] = chain_assignments[j] + chain_offsets[component-1];
+            }
         }
     }
 
@@ -135,7 +195,7 @@ MinimumDistanceIndex::MinimumDistanceIndex(const HandleGraph* graph,
             primary_snarl_ranks[id - min_node_id] = 1;
 
             snarl_indexes.emplace_back(0, false, id, id, false, 0, 1, false);
-            snarl_indexes.back().distances[0]  = node_len + 1; 
+            snarl_indexes.back().distances.set(0, node_len + 1); 
         }
         return true;
                
@@ -178,7 +238,8 @@ MinimumDistanceIndex::MinimumDistanceIndex(const HandleGraph* graph,
                   (has_secondary_snarl.rank(max_node_id-min_node_id)+1, 0);
 
     size_t i = 0;
-    for (auto x : secondary_snarl_assignments) {
+    for (size_t j = 0 ; j < secondary_snarl_assignments.size() ; j++) {
+        uint64_t x = secondary_snarl_assignments[j];
         if (x != 0) {
             filtered_secondary_assignments[i] = x;
             i++;
@@ -190,7 +251,8 @@ MinimumDistanceIndex::MinimumDistanceIndex(const HandleGraph* graph,
                   (has_secondary_snarl.rank(max_node_id-min_node_id)+1, 0); 
 
     i = 0;
-    for (auto x : secondary_snarl_ranks) {
+    for (size_t j = 0 ; j < secondary_snarl_ranks.size() ; j++) {
+        uint64_t x = secondary_snarl_ranks[j];
         if (x != 0) {
             filtered_secondary_ranks[i] = x;
             i++;
@@ -201,7 +263,8 @@ MinimumDistanceIndex::MinimumDistanceIndex(const HandleGraph* graph,
     int_vector<> filtered_chain_assignments 
                     (has_chain.rank(max_node_id-min_node_id)+1, 0);
     i = 0;
-    for (auto x : chain_assignments) {
+    for (size_t j = 0 ; j < chain_assignments.size() ; j++) {
+        uint64_t x = chain_assignments[j];
         if (x != 0) {
             filtered_chain_assignments[i] = x;
             i++;
@@ -212,7 +275,8 @@ MinimumDistanceIndex::MinimumDistanceIndex(const HandleGraph* graph,
     int_vector<> filtered_chain_ranks 
                     (has_chain.rank(max_node_id-min_node_id)+1, 0);
     i = 0;
-    for (auto x : chain_ranks) {
+    for (size_t j = 0 ; j < chain_ranks.size() ; j++) {
+        uint64_t x = chain_ranks[j];
         if (x != 0) {
             filtered_chain_ranks[i] = x;
             i++;
@@ -220,17 +284,17 @@ MinimumDistanceIndex::MinimumDistanceIndex(const HandleGraph* graph,
     }
     chain_ranks = move(filtered_chain_ranks);
 
-    util::bit_compress(primary_snarl_assignments);
-    util::bit_compress(primary_snarl_ranks);
-    util::bit_compress(secondary_snarl_assignments);
-    util::bit_compress(secondary_snarl_ranks);
-    util::bit_compress(chain_assignments);
-    util::bit_compress(chain_ranks);
+    primary_snarl_assignments.bit_compress();
+    primary_snarl_ranks.bit_compress();
+    secondary_snarl_assignments.bit_compress();
+    secondary_snarl_ranks.bit_compress();
+    chain_assignments.bit_compress();
+    chain_ranks.bit_compress();
     util::bit_compress(has_chain_bv);
     util::bit_compress(has_secondary_snarl_bv);
-    util::bit_compress(node_to_component);
-    util::bit_compress(component_to_chain_index);
-    util::bit_compress(component_to_chain_length);
+    node_to_component.bit_compress();
+    component_to_chain_index.bit_compress();
+    component_to_chain_length.bit_compress();
 
 
     if (cap > 0) {
@@ -276,13 +340,28 @@ void MinimumDistanceIndex::load(istream& in){
     } else {
         //Check that the header is correct
         size_t char_index = 0;
-        //TODO: We're only checking up to the last two so if the header changes this needs to change too
-        while (in.peek() != EOF && char_index < file_header.size()-2) {
+        //TODO: We're only checking up to the last three (the version number) so if the header changes this needs to change too
+        while (in.peek() != EOF && char_index < file_header.size()-3) {
             if ( (char) in.get() != file_header[char_index]) {
                 throw runtime_error ("Distance index file is outdated");
             }
             char_index ++;
         }
+        if (in.peek() == flat_file_header[char_index]) {
+            //This is the flat layout, which has its own loader
+            while (char_index < flat_file_header.size()) {
+                if ( (char) in.get() != flat_file_header[char_index]) {
+                    throw runtime_error ("Distance index file is outdated");
+                }
+                char_index ++;
+            }
+            load_flat(in);
+            return;
+        }
+        if ( (char) in.get() != file_header[char_index]) {
+            throw runtime_error ("Distance index file is outdated");
+        }
+        char_index ++;
         if (in.peek() == '.') {
             if ((char) in.get() != '.' || (char)in.get() != '2') {
                 throw runtime_error ("Distance index file is outdated");
@@ -352,6 +431,11 @@ void MinimumDistanceIndex::load(istream& in){
 
 void MinimumDistanceIndex::serialize(ostream& out) const {
 
+    if (flat_layout) {
+        serialize_flat(out);
+        return;
+    }
+
     //Serialize snarls
 
     //Write the header to the serialized file
@@ -395,6 +479,390 @@ void MinimumDistanceIndex::serialize(ostream& out) const {
 
 };
 
+/* The flat layout is the header, padded with 0s to a multiple of 8 bytes,
+ * followed by 64-bit words: 
+ *  the number of words that follow
+ *  the number of snarls, and a fixed-size record for each snarl
+ *  the number of chains, and a fixed-size record for each chain
+ *  descriptors of the per-node vectors, and the remaining scalars
+ *  the number of words in the arena, and the arena
+ * Each packed vector is described by three words: its offset in words into
+ * the arena, its length, and its width in bits. The arena holds the snarl
+ * and chain vectors in a preorder traversal of the snarl tree, followed by
+ * the per-node vectors, each starting on a word boundary.
+ */
+
+namespace {
+
+/// A packed vector of integers to write into the arena of a flat index
+struct FlatVector {
+    const uint64_t* words;
+    size_t length;
+    uint8_t width;
+
+    size_t word_count() const {
+        return (length * width + 63) / 64;
+    }
+};
+
+template<uint8_t Width>
+FlatVector flat_vector(const sdsl::int_vector<Width>& vec) {
+    return {vec.data(), vec.size(), vec.width()};
+}
+
+/// Copy a packed vector out of the arena of a flat index
+template<uint8_t Width>
+void copy_flat_vector(const uint64_t* arena, size_t arena_words, const uint64_t* descriptor, sdsl::int_vector<Width>& vec) {
+    size_t offset = descriptor[0];
+    size_t length = descriptor[1];
+    uint8_t width = descriptor[2];
+    if (width == 0 || width > 64 || (Width != 0 && width != Width)
+        || offset + (length * width + 63) / 64 > arena_words) {
+        throw runtime_error("Distance index file is corrupt");
+    }
+    vec = sdsl::int_vector<Width>(length, 0, width);
+    std::copy(arena + offset, arena + offset + (length * width + 63) / 64, vec.data());
+}
+
+}
+
+void MinimumDistanceIndex::PackedVector::load(istream& in) {
+    util::clear(owned);
+    view_words = nullptr;
+    owned.load(in);
+}
+
+void MinimumDistanceIndex::PackedVector::serialize(ostream& out) const {
+    if (view_words == nullptr) {
+        owned.serialize(out);
+    } else {
+        //Make an int_vector to write it in the same format
+        sdsl::int_vector<> copy(view_length, 0, view_width);
+        std::copy(view_words, view_words + word_count(), copy.data());
+        copy.serialize(out);
+    }
+}
+
+vector<pair<bool, size_t>> MinimumDistanceIndex::flat_record_order() const {
+
+    //Find the children of each snarl and chain, and the records at the roots
+    //of the snarl tree. Anything whose parent we can't find is a root
+    vector<vector<pair<bool, size_t>>> snarl_children (snarl_indexes.size());
+    vector<vector<pair<bool, size_t>>> chain_children (chain_indexes.size());
+    vector<pair<bool, size_t>> roots;
+
+    auto snarl_of = [&](id_t id) {
+        if (id < min_node_id || (size_t) (id - min_node_id) >= primary_snarl_assignments.size()
+            || primary_snarl_assignments[id - min_node_id] == 0) {
+            return snarl_indexes.size();
+        }
+        return get_primary_assignment(id);
+    };
+    auto chain_of = [&](id_t id) {
+        if (id < min_node_id || (size_t) (id - min_node_id) >= has_chain_bv.size()
+            || !has_chain_bv[id - min_node_id]) {
+            return chain_indexes.size();
+        }
+        return get_chain_assignment(id);
+    };
+
+    for (size_t i = 0 ; i < chain_indexes.size() ; i++) {
+        size_t parent = chain_indexes[i].parent_id == 0 ? snarl_indexes.size() 
+                                                      : snarl_of(chain_indexes[i].parent_id);
+        if (parent < snarl_indexes.size()) {
+            snarl_children[parent].emplace_back(true, i);
+        } else {
+            roots.emplace_back(true, i);
+        }
+    }
+    for (size_t i = 0 ; i < snarl_indexes.size() ; i++) {
+        const SnarlIndex& snarl_index = snarl_indexes[i];
+        if (snarl_index.parent_id != 0 && snarl_index.in_chain) {
+            size_t parent = chain_of(snarl_index.parent_id);
+            if (parent < chain_indexes.size()) {
+                chain_children[parent].emplace_back(false, i);
+                continue;
+            }
+        } else if (snarl_index.parent_id != 0) {
+            size_t parent = snarl_of(snarl_index.parent_id);
+            if (parent < snarl_indexes.size() && parent != i) {
+                snarl_children[parent].emplace_back(false, i);
+                continue;
+            }
+        }
+        roots.emplace_back(false, i);
+    }
+
+    //Walk the tree in preorder
+    vector<pair<bool, size_t>> order;
+    order.reserve(snarl_indexes.size() + chain_indexes.size());
+    vector<bool> seen_snarls (snarl_indexes.size(), false);
+    vector<bool> seen_chains (chain_indexes.size(), false);
+    vector<pair<bool, size_t>> stack (roots.rbegin(), roots.rend());
+    while (!stack.empty()) {
+        pair<bool, size_t> record = stack.back();
+        stack.pop_back();
+        vector<bool>& seen = record.first ? seen_chains : seen_snarls;
+        if (seen[record.second]) {
+            continue;
+        }
+        seen[record.second] = true;
+        order.push_back(record);
+        auto& children = record.first ? chain_children[record.second] : snarl_children[record.second];
+        stack.insert(stack.end(), children.rbegin(), children.rend());
+    }
+
+    //Anything unreachable from a root goes at the end
+    for (size_t i = 0 ; i < snarl_indexes.size() ; i++) {
+        if (!seen_snarls[i]) {
+            order.emplace_back(false, i);
+        }
+    }
+    for (size_t i = 0 ; i < chain_indexes.size() ; i++) {
+        if (!seen_chains[i]) {
+            order.emplace_back(true, i);
+        }
+    }
+    return order;
+}
+
+void MinimumDistanceIndex::serialize_flat(ostream& out) const {
+
+    //Decide where each packed vector goes in the arena
+    vector<FlatVector> arena_vectors;
+    vector<size_t> snarl_offsets (snarl_indexes.size());
+    vector<size_t> chain_offsets (chain_indexes.size());
+    size_t arena_words = 0;
+    auto add_to_arena = [&](const FlatVector& vec) {
+        size_t offset = arena_words;
+        arena_vectors.push_back(vec);
+        arena_words += vec.word_count();
+        return offset;
+    };
+    auto packed = [](const PackedVector& vec) -> FlatVector {
+        return {vec.words(), vec.size(), vec.width()};
+    };
+    for (auto& record : flat_record_order()) {
+        if (record.first) {
+            const ChainIndex& chain_index = chain_indexes[record.second];
+            chain_offsets[record.second] = add_to_arena(packed(chain_index.prefix_sum));
+            add_to_arena(packed(chain_index.loop_fd));
+            add_to_arena(packed(chain_index.loop_rev));
+        } else {
+            snarl_offsets[record.second] = add_to_arena(packed(snarl_indexes[record.second].distances));
+        }
+    }
+    vector<FlatVector> node_vectors {
+        packed(primary_snarl_assignments), packed(primary_snarl_ranks),
+        packed(secondary_snarl_assignments), packed(secondary_snarl_ranks),
+        flat_vector(has_secondary_snarl_bv), packed(node_to_component),
+        packed(component_to_chain_index), packed(component_to_chain_length),
+        packed(chain_assignments), packed(chain_ranks), flat_vector(has_chain_bv),
+        packed(min_distances), packed(max_distances)};
+    vector<size_t> node_offsets;
+    for (auto& vec : node_vectors) {
+        node_offsets.push_back(add_to_arena(vec));
+    }
+
+    //Put together everything before the arena
+    vector<uint64_t> words;
+    words.push_back(0);
+    words.push_back(snarl_indexes.size());
+    for (size_t i = 0 ; i < snarl_indexes.size() ; i++) {
+        const SnarlIndex& snarl_index = snarl_indexes[i];
+        words.insert(words.end(), {snarl_offsets[i], snarl_index.distances.size(), snarl_index.distances.width(),
+            snarl_index.in_chain, (uint64_t) snarl_index.parent_id, snarl_index.rev_in_parent,
+            (uint64_t) snarl_index.id_in_parent, (uint64_t) snarl_index.end_id, snarl_index.num_nodes,
+            snarl_index.depth, snarl_index.is_unary_snarl, snarl_index.is_simple_snarl,
+            (uint64_t) snarl_index.max_width});
+    }
+    words.push_back(chain_indexes.size());
+    for (size_t i = 0 ; i < chain_indexes.size() ; i++) {
+        const ChainIndex& chain_index = chain_indexes[i];
+        size_t offset = chain_offsets[i];
+        for (const PackedVector* vec : {&chain_index.prefix_sum, &chain_index.loop_fd, &chain_index.loop_rev}) {
+            words.insert(words.end(), {offset, vec->size(), vec->width()});
+            offset += vec->word_count();
+        }
+        words.insert(words.end(), {(uint64_t) chain_index.parent_id, chain_index.rev_in_parent,
+            (uint64_t) chain_index.id_in_parent, (uint64_t) chain_index.end_id,
+            chain_index.is_looping_chain, (uint64_t) chain_index.max_width});
+    }
+    for (size_t i = 0 ; i < node_vectors.size() ; i++) {
+        words.insert(words.end(), {node_offsets[i], node_vectors[i].length, node_vectors[i].width});
+    }
+    words.insert(words.end(), {(uint64_t) min_node_id, (uint64_t) max_node_id, tree_depth, include_maximum});
+    words.push_back(arena_words);
+    words[0] = words.size() - 1 + arena_words;
+
+    //Write the header, padded to a whole number of words
+    out << flat_file_header;
+    for (size_t i = flat_file_header.size() ; i % sizeof(uint64_t) != 0 ; i++) {
+        out.put('\0');
+    }
+    out.write((const char*) words.data(), words.size() * sizeof(uint64_t));
+
+    //Write the arena, clearing the unused bits at the end of each vector
+    for (auto& vec : arena_vectors) {
+        size_t count = vec.word_count();
+        if (count == 0) {
+            continue;
+        }
+        out.write((const char*) vec.words, (count - 1) * sizeof(uint64_t));
+        uint64_t last = vec.words[count - 1];
+        size_t used_bits = (vec.length * vec.width) % 64;
+        if (used_bits != 0) {
+            last &= sdsl::bits::lo_set[used_bits];
+        }
+        out.write((const char*) &last, sizeof(uint64_t));
+    }
+}
+
+void MinimumDistanceIndex::load_flat(istream& in) {
+    //Skip the padding after the header
+    for (size_t i = flat_file_header.size() ; i % sizeof(uint64_t) != 0 ; i++) {
+        in.get();
+    }
+
+    //Read all the words into one block that the records can point into
+    uint64_t word_count = 0;
+    in.read((char*) &word_count, sizeof(uint64_t));
+    auto words = make_shared<vector<uint64_t>>(word_count);
+    in.read((char*) words->data(), word_count * sizeof(uint64_t));
+    if (!in) {
+        throw runtime_error("Distance index file is truncated");
+    }
+    flat_storage = words;
+    load_flat_words(words->data(), words->size());
+}
+
+bool MinimumDistanceIndex::load_mapped(const string& filename) {
+    //Pipes and the like can't be mapped, and can't be opened a second time
+    struct stat file_stats;
+    if (stat(filename.c_str(), &file_stats) != 0 || !S_ISREG(file_stats.st_mode)) {
+        return false;
+    }
+
+    //Map the whole file, read-only and shared with anyone else mapping it
+    auto mapping = make_shared<mio::mmap_source>();
+    std::error_code error;
+    mapping->map(filename, error);
+
+    size_t header_bytes = (flat_file_header.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+    if (error || mapping->size() < header_bytes + sizeof(uint64_t)
+        || string(mapping->data(), flat_file_header.size()) != flat_file_header) {
+        //This isn't a flat index, so it has to be loaded the usual way
+        return false;
+    }
+
+    //The mapping is page-aligned, so the words after the header are aligned
+    const uint64_t* words = (const uint64_t*) (mapping->data() + header_bytes);
+    size_t word_count = words[0];
+    if (word_count > (mapping->size() - header_bytes) / sizeof(uint64_t) - 1) {
+        throw runtime_error("Distance index file is truncated");
+    }
+    flat_storage = mapping;
+    load_flat_words(words + 1, word_count);
+    return true;
+}
+
+void MinimumDistanceIndex::load_flat_words(const uint64_t* words, size_t word_count) {
+
+    size_t next_word = 0;
+    //Get the next n words, making sure they're really there
+    auto take = [&](size_t n) {
+        if (next_word + n > word_count) {
+            throw runtime_error("Distance index file is truncated");
+        }
+        const uint64_t* taken = words + next_word;
+        next_word += n;
+        return taken;
+    };
+
+    //Records point into the arena, which comes last, so find it first
+    vector<const uint64_t*> snarl_records (*take(1));
+    for (auto& record : snarl_records) {
+        record = take(13);
+    }
+    vector<const uint64_t*> chain_records (*take(1));
+    for (auto& record : chain_records) {
+        record = take(15);
+    }
+    const uint64_t* node_descriptors = take(13 * 3);
+    const uint64_t* scalars = take(4);
+    size_t arena_words = *take(1);
+    const uint64_t* arena = take(arena_words);
+
+    auto point_to = [&](const uint64_t* descriptor, PackedVector& vec) {
+        size_t offset = descriptor[0];
+        size_t length = descriptor[1];
+        uint8_t width = descriptor[2];
+        if (width == 0 || width > 64 || offset + (length * width + 63) / 64 > arena_words) {
+            throw runtime_error("Distance index file is corrupt");
+        }
+        vec.point_to(arena + offset, length, width);
+    };
+
+    snarl_indexes.clear();
+    snarl_indexes.resize(snarl_records.size());
+    for (size_t i = 0 ; i < snarl_records.size() ; i++) {
+        const uint64_t* record = snarl_records[i];
+        SnarlIndex& snarl_index = snarl_indexes[i];
+        point_to(record, snarl_index.distances);
+        snarl_index.in_chain = record[3];
+        snarl_index.parent_id = record[4];
+        snarl_index.rev_in_parent = record[5];
+        snarl_index.id_in_parent = record[6];
+        snarl_index.end_id = record[7];
+        snarl_index.num_nodes = record[8];
+        snarl_index.depth = record[9];
+        snarl_index.is_unary_snarl = record[10];
+        snarl_index.is_simple_snarl = record[11];
+        snarl_index.max_width = record[12];
+    }
+    chain_indexes.clear();
+    chain_indexes.resize(chain_records.size());
+    for (size_t i = 0 ; i < chain_records.size() ; i++) {
+        const uint64_t* record = chain_records[i];
+        ChainIndex& chain_index = chain_indexes[i];
+        point_to(record, chain_index.prefix_sum);
+        point_to(record + 3, chain_index.loop_fd);
+        point_to(record + 6, chain_index.loop_rev);
+        chain_index.parent_id = record[9];
+        chain_index.rev_in_parent = record[10];
+        chain_index.id_in_parent = record[11];
+        chain_index.end_id = record[12];
+        chain_index.is_looping_chain = record[13];
+        chain_index.max_width = record[14];
+    }
+
+    point_to(node_descriptors, primary_snarl_assignments);
+    point_to(node_descriptors + 3, primary_snarl_ranks);
+    point_to(node_descriptors + 6, secondary_snarl_assignments);
+    point_to(node_descriptors + 9, secondary_snarl_ranks);
+    point_to(node_descriptors + 15, node_to_component);
+    point_to(node_descriptors + 18, component_to_chain_index);
+    point_to(node_descriptors + 21, component_to_chain_length);
+    point_to(node_descriptors + 24, chain_assignments);
+    point_to(node_descriptors + 27, chain_ranks);
+    point_to(node_descriptors + 33, min_distances);
+    point_to(node_descriptors + 36, max_distances);
+
+    //The bit vectors are small and need rank support, so they are copied
+    copy_flat_vector(arena, arena_words, node_descriptors + 12, has_secondary_snarl_bv);
+    copy_flat_vector(arena, arena_words, node_descriptors + 30, has_chain_bv);
+    util::assign(has_secondary_snarl, rank_support_v<1>(&has_secondary_snarl_bv));
+    util::assign(has_chain, rank_support_v<1>(&has_chain_bv));
+
+    min_node_id = scalars[0];
+    max_node_id = scalars[1];
+    tree_depth = scalars[2];
+    include_maximum = scalars[3];
+
+    include_component = true;
+    flat_layout = true;
+}
+
 /////////////////////////    MINIMUM INDEX    ///////////////////////////////
 
 
@@ -403,14 +871,19 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
                                     const SnarlManager* snarl_manager,
                                     const Chain* chain, size_t parent_id,
                                     bool rev_in_parent, bool trivial_chain, 
-                                    size_t depth, size_t component_num) {
+                                    size_t depth, size_t component_num,
+                                    ComponentBuild& build) {
     /*Populate the MinimumDistanceIndex
      * Compute the ChainIndex for this chain and recursively calculate the 
      * SnarlIndexes for all snarls within the chain
      * parentId is the id of this chain's parent snarl where the snarl is the 
      * node's primary snarl
      * trivialChain is true if the chain is really just a single snarl
+     * The records go into the build for this chain's connected component,
+     * and the assignments point into it
     */
+    vector<SnarlIndex>& snarl_indexes = build.snarl_indexes;
+    vector<ChainIndex>& chain_indexes = build.chain_indexes;
 
     #ifdef debugIndex
         cerr << "starting ";
@@ -418,7 +891,7 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
         else {cerr << "chain at ";}
         cerr << get_start_of(*chain) << endl;
     #endif
-    tree_depth = std::max(depth, tree_depth);
+    build.tree_depth = std::max(depth, build.tree_depth);
 
 
  
@@ -433,10 +906,10 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
 
         chain_assignments[first_visit.node_id()-min_node_id] = chain_indexes.size();
         chain_ranks[first_visit.node_id()-min_node_id] = 1;
-        has_chain_bv[first_visit.node_id()-min_node_id] = 1; 
+        build.chain_bits.push_back(first_visit.node_id()-min_node_id);
 
         handle_t first_node = graph->get_handle(first_visit.node_id(), first_visit.backward());
-        chain_indexes.back().prefix_sum[0] = graph->get_length(first_node) + 1;
+        chain_indexes.back().prefix_sum.set(0, graph->get_length(first_node) + 1);
     }
     size_t curr_chain_assignment = chain_indexes.size() - 1;
     size_t curr_chain_rank = 0;
@@ -464,7 +937,7 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
             //already been seen (if the chain loops)
             chain_assignments[second_id-min_node_id] = curr_chain_assignment+1;
             chain_ranks[second_id - min_node_id] = curr_chain_rank + 2;
-            has_chain_bv[snarl_end_id - min_node_id] = 1;
+            build.chain_bits.push_back(snarl_end_id - min_node_id);
            
         } 
 
@@ -482,7 +955,7 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
                 if (curr_snarl != NULL) {
                     //If this node represents a snarl or chain, then this snarl
                     //is a secondary snarl
-                    has_secondary_snarl_bv[id-min_node_id] = 1;
+                    build.secondary_snarl_bits.push_back(id-min_node_id);
                     secondary_snarl_assignments[id - min_node_id] = snarl_assignment+1;
                     secondary_snarl_ranks[id - min_node_id] = all_nodes.size()+1;
                 } else {
@@ -537,7 +1010,7 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
             secondary_snarl_ranks[end_in_chain-min_node_id] = end_in_chain == snarl_end_id ? 
                  (snarl_end_rev ? all_nodes.size()  : all_nodes.size() - 1) :
                  (snarl_start_rev ? 1 : 0);
-            has_secondary_snarl_bv[end_in_chain-min_node_id] = 1;
+            build.secondary_snarl_bits.push_back(end_in_chain-min_node_id);
         }
 
         //Make the snarl index
@@ -553,7 +1026,7 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
                                snarl_start_id == snarl_end_id,
                                depth, all_nodes.size()/2, true);
         }
-        populate_snarl_index(graph, snarl_manager, ng, snarl, snarl_rev_in_chain, snarl_assignment, all_nodes, depth, component_num);
+        populate_snarl_index(graph, snarl_manager, ng, snarl, snarl_rev_in_chain, snarl_assignment, all_nodes, depth, component_num, build);
 #ifdef debugIndex
 
     snarl_indexes[snarl_assignment].print_self();
@@ -575,8 +1048,8 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
                 cerr << "Prefix sum before snarl: " 
                 << chain_indexes[curr_chain_assignment].prefix_sum[curr_chain_rank + 1] << endl;
             #endif
-            chain_indexes[curr_chain_assignment].prefix_sum[curr_chain_rank+1] =
-                               curr_chain_rank == 0 ? dist + 1 : chain_indexes[curr_chain_assignment].prefix_sum[curr_chain_rank]+dist;
+            chain_indexes[curr_chain_assignment].prefix_sum.set(curr_chain_rank+1,
+                               curr_chain_rank == 0 ? dist + 1 : chain_indexes[curr_chain_assignment].prefix_sum[curr_chain_rank]+dist);
 
 
             //Add the reverse loop distance
@@ -591,7 +1064,7 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
                     first_rev_dist = sd.snarl_distance( 1, 0);
                     first_rev_dist = first_rev_dist == -1 ? -1 : first_rev_dist + sd.node_length(0);
                 }
-                chain_indexes[curr_chain_assignment].loop_rev[0] = first_rev_dist + 1;
+                chain_indexes[curr_chain_assignment].loop_rev.set(0, first_rev_dist + 1);
             }
 
             int64_t rev_loop_dist;
@@ -609,7 +1082,7 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
             int64_t last_loop = chain_indexes[curr_chain_assignment].loop_rev[curr_chain_rank] - 1;
 
             if (last_loop == -1) {
-                chain_indexes[curr_chain_assignment].loop_rev[curr_chain_rank+1] = rev_loop_dist + 1;
+                chain_indexes[curr_chain_assignment].loop_rev.set(curr_chain_rank+1, rev_loop_dist + 1);
             } else {
     
                 //Push the minimum of the loop distance of the current snarl and
@@ -620,7 +1093,7 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
 
 
                 int64_t loop_distance = min_pos(rev_loop_dist, last_loop + dist_to_end);
-               chain_indexes[curr_chain_assignment].loop_rev[curr_chain_rank+1] = loop_distance + 1;
+               chain_indexes[curr_chain_assignment].loop_rev.set(curr_chain_rank+1, loop_distance + 1);
             }
             if ( c == chain_begin(*chain)) {
                 //If this is the first snarl, include the length of the start node
@@ -634,7 +1107,7 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
         }
         
         //Bit compress distance matrix of snarl index
-        util::bit_compress(snarl_indexes[snarl_assignment].distances);
+        snarl_indexes[snarl_assignment].distances.bit_compress();
 
         curr_chain_rank ++;
     }//End for loop over snarls in chain
@@ -646,7 +1119,7 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
         //Add the length of the last node to chain prefix sum
         auto last_visit = get_end_of(*chain);
         handle_t last_node = graph->get_handle(last_visit.node_id(), false);
-        cd.prefix_sum[cd.prefix_sum.size() - 1] =  cd.prefix_sum[cd.prefix_sum.size() - 2] + graph->get_length(last_node);
+        cd.prefix_sum.set(cd.prefix_sum.size() - 1, cd.prefix_sum[cd.prefix_sum.size() - 2] + graph->get_length(last_node));
     
         if (get_start_of(*chain).node_id() == get_end_of(*chain).node_id()) {
             //If the chain loops, then the reverse loop distances might include
@@ -674,7 +1147,7 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
 
                 if (cd.loop_rev[curr_chain_rank] == 0 ||
                      new_loop < cd.loop_rev[curr_chain_rank]) {
-                    cd.loop_rev[curr_chain_rank] = new_loop + 1;
+                    cd.loop_rev.set(curr_chain_rank, new_loop + 1);
                 } else {
                     //If this isn't an improvement, subsequent entries will not
                     //be improved either
@@ -742,7 +1215,7 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
                     }
                   
                 }
-                cd.loop_fd[curr_chain_rank] = loop_dist_last + 1;
+                cd.loop_fd.set(curr_chain_rank, loop_dist_last + 1);
             }
     
             int64_t fd_loop_dist;
@@ -762,7 +1235,7 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
     
             if (last_loop == -1) {
     
-                cd.loop_fd[curr_chain_rank] = fd_loop_dist + 1;
+                cd.loop_fd.set(curr_chain_rank, fd_loop_dist + 1);
     
             } else {
             //push dist to end of snarl + loop dist + dist to start of snarl 
@@ -774,13 +1247,13 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
                 int64_t dist_start_end =  sd.snarl_distance(0, sd.num_nodes * 2 - 2);
                 dist_start_end = dist_start_end == -1 ? -1 : dist_start_end + sd.node_length(0);
                 int64_t loop_distance = min_pos(fd_loop_dist, last_loop + dist_end_start + dist_start_end);
-                cd.loop_fd[curr_chain_rank] = loop_distance + 1;
+                cd.loop_fd.set(curr_chain_rank, loop_distance + 1);
             }           
           
         }
-        util::bit_compress(cd.prefix_sum);
-        util::bit_compress(cd.loop_fd);
-        util::bit_compress(cd.loop_rev);
+        cd.prefix_sum.bit_compress();
+        cd.loop_fd.bit_compress();
+        cd.loop_rev.bit_compress();
     }
  
     //return length of entire chain
@@ -792,8 +1265,11 @@ int64_t MinimumDistanceIndex::calculate_min_index(const HandleGraph* graph,
 
 void MinimumDistanceIndex::populate_snarl_index(const HandleGraph* graph, const SnarlManager* snarl_manager, const NetGraph& ng,
                                               const Snarl* snarl, bool snarl_rev_in_chain, size_t snarl_assignment, 
-                                              hash_set<pair<id_t, bool>>& all_nodes, size_t depth, size_t component_num) {
+                                              hash_set<pair<id_t, bool>>& all_nodes, size_t depth, size_t component_num,
+                                              ComponentBuild& build) {
     //Fill in the given snarl index's distances by doing a dijkstra search starting from each node in the snarl
+    vector<SnarlIndex>& snarl_indexes = build.snarl_indexes;
+    vector<ChainIndex>& chain_indexes = build.chain_indexes;
 
 
     auto cmp = [] (pair<pair<id_t, bool>,int64_t> x,
@@ -903,7 +1379,7 @@ void MinimumDistanceIndex::populate_snarl_index(const HandleGraph* graph, const
                             bool rev_in_snarl = curr_id.first == get_start_of(*curr_chain).node_id()
                                       ? get_start_of(*curr_chain).backward() : !get_end_of(*curr_chain).backward();
                             node_len = calculate_min_index(graph,  snarl_manager, curr_chain, 
-                                         start_in_chain, rev_in_snarl, false, depth + 1, component_num);
+                                         start_in_chain, rev_in_snarl, false, depth + 1, component_num, build);
 
                              chain_dists = &chain_indexes[chain_assignments[chain_start-min_node_id]-1]; 
                         }
@@ -953,7 +1429,7 @@ void MinimumDistanceIndex::populate_snarl_index(const HandleGraph* graph, const
                             curr_chain.emplace_back(curr_snarl, false);
                             bool rev_in_snarl = curr_id.first == snarl_id ? snarl_rev : !end_rev;
                             calculate_min_index(graph, snarl_manager, &curr_chain, start_in_chain,
-                                             rev_in_snarl, true, depth + 1, component_num);
+                                             rev_in_snarl, true, depth + 1, component_num, build);
 
                             snarl_dists = &snarl_indexes[primary_snarl_assignments[snarl_id-min_node_id]-1];
                         }
@@ -986,7 +1462,7 @@ void MinimumDistanceIndex::populate_snarl_index(const HandleGraph* graph, const
                 }
  
                 if (curr_id == start_id) {
-                    snarl_indexes[snarl_assignment].distances[start_node_rank/2]  = node_len + 1; 
+                    snarl_indexes[snarl_assignment].distances.set(start_node_rank/2, node_len + 1); 
                 }
    
 
@@ -1752,7 +2228,7 @@ MinimumDistanceIndex::SnarlIndex::SnarlIndex(
         nodes in a snarl */
     size_t size = num_nodes * 2;
     is_simple_snarl = true;
-    util::assign(distances, int_vector<>((((size+1)*size)/2) + (size/2), 0));
+    distances = PackedVector((((size+1)*size)/2) + (size/2), 0);
 }
 
 MinimumDistanceIndex::SnarlIndex::SnarlIndex()  {
@@ -1831,7 +2307,7 @@ void MinimumDistanceIndex::SnarlIndex::insert_distance(size_t start,
     //Assign distance between start and end
     size_t i = index(start, end);
 
-    distances[i] = dist + 1;
+    distances.set(i, dist + 1);
 }
 
 int64_t MinimumDistanceIndex::SnarlIndex::snarl_length() const {
@@ -1981,9 +2457,9 @@ MinimumDistanceIndex::ChainIndex::ChainIndex(
                 is_looping_chain(loops), rev_in_parent(rev_in_parent), max_width(0) {
     
 
-    util::assign(prefix_sum, int_vector<>(length+2, 0));
-    util::assign(loop_fd, int_vector<>(length+1, 0));
-    util::assign(loop_rev, int_vector<>(length+1, 0));
+    prefix_sum = PackedVector(length+2, 0);
+    loop_fd = PackedVector(length+1, 0);
+    loop_rev = PackedVector(length+1, 0);
 
 }
 MinimumDistanceIndex::ChainIndex::ChainIndex()  {
@@ -2149,20 +2625,20 @@ void MinimumDistanceIndex::ChainIndex::print_self() const {
     
     cerr << "Distances:" << endl;
     cerr << endl;
-    for (auto n : prefix_sum) {
-        cerr << (int64_t)n - 1 << " ";
+    for (size_t i = 0 ; i < prefix_sum.size() ; i++) {
+        cerr << (int64_t)prefix_sum[i] - 1 << " ";
     }
     cerr << endl; 
     cerr << "Loop Forward:" << endl;
     cerr << endl;
-    for (auto n : loop_fd) {
-        cerr << (int64_t)n - 1 << " ";
+    for (size_t i = 0 ; i < loop_fd.size() ; i++) {
+        cerr << (int64_t)loop_fd[i] - 1 << " ";
     }
     cerr << endl; 
     cerr << "Loop Reverse:" << endl;
     cerr << endl;
-    for (auto n : loop_rev) {
-        cerr << (int64_t)n - 1 << " ";
+    for (size_t i = 0 ; i < loop_rev.size() ; i++) {
+        cerr << (int64_t)loop_rev[i] - 1 << " ";
     }
     cerr << endl;
 }
@@ -2175,8 +2651,8 @@ void MinimumDistanceIndex::calculate_max_index(const HandleGraph* graph, int64_t
     min_distances.resize(max_node_id - min_node_id + 1);
     max_distances.resize(max_node_id - min_node_id + 1);
 
-    sdsl::util::set_to_value(min_distances, 0);
-    sdsl::util::set_to_value(max_distances, 0);
+    min_distances.set_to_value(0);
+    max_distances.set_to_value(0);
 
 
     unordered_map<id_t, pair<id_t, bool>> split_to_id;
@@ -2,6 +2,7 @@
 #define VG_MIN_DISTANCE_HPP_INCLUDED
 
 #include <unordered_set>
+#include <memory>
 #include <jansson.h>
 
 #include "snarls.hpp"
@@ -40,11 +41,32 @@ class MinimumDistanceIndex {
     MinimumDistanceIndex ();
 
     //Serialize object into out
+    //Uses the flat layout if set_flat_layout(true) was called or the index
+    //was loaded from a flat file
     void serialize(ostream& out) const;
 
     //Load serialized object from in. Does not rely on the internal graph or 
     //snarl manager pointers.
+    //Accepts both the original and the flat layout
     void load(istream& in);
+
+    //Load the index from the named file if it is a regular file in the flat
+    //layout. It is memory-mapped read-only and queried straight from the
+    //mapping, so processes on the same host that load the same index share
+    //its pages. Returns false without loading anything otherwise, in which
+    //case load() must be used on a stream instead.
+    bool load_mapped(const string& filename);
+
+    //Choose whether serialize() writes the flat layout, where all snarl and
+    //chain records share one block of memory, laid out in snarl tree order
+    void set_flat_layout(bool flat) {
+        flat_layout = flat;
+    }
+
+    //Does serialize() write the flat layout?
+    bool is_flat_layout() const {
+        return flat_layout;
+    }
     
     //Get the length of the given node
     int64_t node_length(id_t id) const;
@@ -115,6 +137,130 @@ class MinimumDistanceIndex {
 
     protected:
 
+    /** A bit-packed vector of unsigned integers, used for the distances
+     * stored in snarl and chain records and for the per-node vectors.
+     * An index that was built, or loaded from the original layout, owns an
+     * sdsl::int_vector<> for each vector. An index loaded from the flat 
+     * layout instead points each vector at its slice of one block of words
+     * shared by the whole index, which may be a read-only memory mapping of
+     * the file. Then loading doesn't allocate per record and records that
+     * are near each other in the snarl tree are near each other in memory.
+    */
+    class PackedVector {
+
+        public:
+
+            ///Proxy for a value, which can be assigned to while the vector
+            ///owns its storage, like an sdsl::int_vector<>::reference
+            class reference {
+                public:
+                    reference(PackedVector& vec, size_t i) : vec(vec), i(i) {}
+
+                    operator uint64_t() const {
+                        return ((const PackedVector&) vec)[i];
+                    }
+
+                    reference& operator=(uint64_t value) {
+                        vec.set(i, value);
+                        return *this;
+                    }
+
+                    reference& operator=(const reference& other) {
+                        return *this = (uint64_t) other;
+                    }
+
+                private:
+                    PackedVector& vec;
+                    size_t i;
+            };
+
+            PackedVector() = default;
+
+            ///Make an owned vector of size copies of value
+            PackedVector(size_t size, uint64_t value) : owned(size, value) {}
+
+            ///Take ownership of an int_vector
+            PackedVector& operator=(sdsl::int_vector<>&& vec) {
+                owned = std::move(vec);
+                view_words = nullptr;
+                return *this;
+            }
+
+            reference operator[](size_t i) {
+                return reference(*this, i);
+            }
+
+            uint64_t operator[](size_t i) const {
+                if (view_words == nullptr) {
+                    return owned[i];
+                }
+                size_t bit = i * view_width;
+                return sdsl::bits::read_int(view_words + (bit >> 6), bit & 63, view_width);
+            }
+
+            ///Set a value. Only allowed during construction, while the
+            ///vector owns its storage
+            void set(size_t i, uint64_t value) {
+                owned[i] = value;
+            }
+
+            size_t size() const {
+                return view_words == nullptr ? owned.size() : view_length;
+            }
+
+            ///Resize an owned vector
+            void resize(size_t size) {
+                owned.resize(size);
+            }
+
+            ///Set every value in an owned vector to value
+            void set_to_value(uint64_t value) {
+                util::set_to_value(owned, value);
+            }
+
+            ///Number of bits used for each value
+            uint8_t width() const {
+                return view_words == nullptr ? owned.width() : view_width;
+            }
+
+            ///The packed words, with value i at bits [i*width(), (i+1)*width())
+            const uint64_t* words() const {
+                return view_words == nullptr ? owned.data() : view_words;
+            }
+
+            ///The number of words that hold the values
+            size_t word_count() const {
+                return (size() * width() + 63) / 64;
+            }
+
+            ///Use the fewest bits per value that fit the largest value
+            void bit_compress() {
+                util::bit_compress(owned);
+            }
+
+            ///Stop owning storage and read values from the given words
+            ///instead. The words must outlive this vector.
+            void point_to(const uint64_t* words, size_t length, uint8_t width) {
+                util::clear(owned);
+                view_words = words;
+                view_length = length;
+                view_width = width;
+            }
+
+            void load(istream& in);
+
+            void serialize(ostream& out) const;
+
+        protected:
+
+            sdsl::int_vector<> owned;
+
+            ///If not null, the values are read from here instead of owned
+            const uint64_t* view_words = nullptr;
+            size_t view_length = 0;
+            uint8_t view_width = 0;
+    };
+
     /** Index for calculating minimum distances among nodes in a snarl
      * Stores minimum distances between nodes in the netgraph of a snarl
      * Also keeps track of the parent of the snarl
@@ -192,7 +338,7 @@ class MinimumDistanceIndex {
             /// For child snarls that are unary or only connected to one node
             /// in the snarl, distances between that node leaving the snarl
             /// and any other node is -1
-            int_vector<> distances;
+            PackedVector distances;
 
             ///True if this snarl is in a chain
             bool in_chain;
@@ -290,18 +436,18 @@ class MinimumDistanceIndex {
             ///the length of the first node in the chain. Similarly, an extra
             ///value is stored at the end of the vector that is the length of the
             ///entire chain
-            int_vector<> prefix_sum;
+            PackedVector prefix_sum;
 
             ///For each boundary node of snarls in the chain, the distance
             /// from the start of the node traversing forward to the end of 
             /// the same node traversing backwards -directions relative to the 
             /// direction the node is traversed in the chain
-            int_vector<> loop_fd;
+            PackedVector loop_fd;
     
             ///For each boundary node of snarls in the chain, the distance
             /// from the end of the node traversing backward to the start of 
             /// the same node traversing forward
-            int_vector<> loop_rev;
+            PackedVector loop_rev;
 
             /// id of parent snarl of the chain 
             ///0 if top level chain
@@ -345,10 +491,10 @@ class MinimumDistanceIndex {
     //Each connected component of the graph gets a unique identifier
     //Identifiers start at 1, 0 indicates that it is not in a component
     //Assigns each node to its connected component
-    sdsl::int_vector<> node_to_component;
+    PackedVector node_to_component;
     //TODO: These could be one vector but they're small enough it probably doesn't matter
-    sdsl::int_vector<> component_to_chain_length;
-    sdsl::int_vector<> component_to_chain_index;
+    PackedVector component_to_chain_length;
+    PackedVector component_to_chain_index;
 
     //Each of the ints in these vectors are offset by 1: 0 is stored as 1, etc.
     //This is so that we can store -1 as 0 instead of int max
@@ -358,7 +504,7 @@ class MinimumDistanceIndex {
     ///containing the node
     ///A primary snarl is the snarl that contains this node as an actual node,
     ///as opposed to a node representing a snarl or chain
-    sdsl::int_vector<> primary_snarl_assignments;
+    PackedVector primary_snarl_assignments;
 
     ///For each node, stores the rank of the node in the snarlIndex
     /// indicated by primary_snarl_assignments
@@ -371,7 +517,7 @@ class MinimumDistanceIndex {
     /// If the start node is traversed backwards to enter the snarl, then the
     /// rank 0 will represent the start node in reverse. The rank stored in this
     /// vector will be 1, representing the start node forward
-    sdsl::int_vector<> primary_snarl_ranks;
+    PackedVector primary_snarl_ranks;
 
     ///Similar to primary snarls, stores snarl index of secondary snarl
     ///each node belongs to, if any.
@@ -379,10 +525,10 @@ class MinimumDistanceIndex {
     ///netgraph of the parent snarl or a node that participates in multiple
     ///snarls in a chain. The primary snarl will always
     ///be the snarl that occurs first in the chain
-    sdsl::int_vector<> secondary_snarl_assignments;
+    PackedVector secondary_snarl_assignments;
 
     ///Stores the ranks of nodes in secondary snarls
-    sdsl::int_vector<> secondary_snarl_ranks;
+    PackedVector secondary_snarl_ranks;
     
     ///For each node, stores 1 if the node is in a secondary snarl and 0
     ///otherwise. Use rank to find which index into secondary_snarls
@@ -392,8 +538,8 @@ class MinimumDistanceIndex {
 
     ///For each node, store the index and rank for the chain that the node
     ///belongs to, if any
-    sdsl::int_vector<> chain_assignments;
-    sdsl::int_vector<> chain_ranks;
+    PackedVector chain_assignments;
+    PackedVector chain_ranks;
     sdsl::bit_vector has_chain_bv;
     sdsl::rank_support_v<1> has_chain;
 
@@ -412,8 +558,8 @@ class MinimumDistanceIndex {
  
     ///For each node in the graph, store the minimum and maximum
     ///distances from a tip to the node
-    sdsl::int_vector<> min_distances;
-    sdsl::int_vector<> max_distances;
+    PackedVector min_distances;
+    PackedVector max_distances;
 
 
     //Header for the serialized file
@@ -422,23 +568,67 @@ class MinimumDistanceIndex {
     //version 2.1 doesn't include snarl index.is_simple_snarl and will break if we try to load it 
     bool include_component; //TODO: This is true for version 2.2 so it includes node_to_component, etc. 
 
+    //Header for the flat layout. It is padded with 0s to a whole number of
+    //words so that everything after it is word-aligned
+    string flat_file_header = "distance index version 3.0";
+
+    ///True if serialize() should write the flat layout
+    bool flat_layout = false;
+
+    ///Owns the words of a flat index that records point into (a buffer or
+    ///a memory mapping), and keeps them alive for as long as the index (or a
+    ///copy of it) is
+    shared_ptr<const void> flat_storage;
+
     ////// Private helper functions
  
 
 
 
 
+    ///Write the index in the flat layout
+    void serialize_flat(ostream& out) const;
+
+    ///Load the flat layout from in, after the header
+    void load_flat(istream& in);
+
+    ///Populate the index from the words of a flat layout, following the
+    ///header. Snarl and chain records point into words rather than copying
+    ///them, so words must outlive the index.
+    void load_flat_words(const uint64_t* words, size_t word_count);
+
+    ///Get the snarl (false) and chain (true) records in the order that the
+    ///flat layout stores them: a preorder traversal of the snarl tree, so
+    ///that each record is followed by its descendants
+    vector<pair<bool, size_t>> flat_record_order() const;
+
+    ///The parts of the index that are built separately for each connected
+    ///component, so that components can be built in parallel. The snarl and
+    ///chain assignments of a component's nodes index into its own records
+    ///until the components are put together
+    struct ComponentBuild {
+        vector<SnarlIndex> snarl_indexes;
+        vector<ChainIndex> chain_indexes;
+        ///Offsets of nodes to set in has_chain_bv and has_secondary_snarl_bv,
+        ///which can't be written from several threads at once
+        vector<size_t> chain_bits;
+        vector<size_t> secondary_snarl_bits;
+        size_t tree_depth = 0;
+    };
+
     ///Helper function for constructor - populate the minimum distance index
     ///Given the top level snarls
     //Returns the length of the chain
     int64_t calculate_min_index(const HandleGraph* graph, 
                       const SnarlManager* snarl_manager, const Chain* chain, 
                        size_t parent_id, bool rev_in_parent, 
-                       bool trivial_chain, size_t depth, size_t component_num); 
+                       bool trivial_chain, size_t depth, size_t component_num,
+                       ComponentBuild& build); 
 
     void populate_snarl_index(const HandleGraph* graph, const SnarlManager* snarl_manager, const NetGraph& ng,
                             const Snarl* snarl, bool snarl_rev_in_chain, size_t snarl_assignment, 
-                            hash_set<pair<id_t, bool>>& all_nodes, size_t depth, size_t component_num);
+                            hash_set<pair<id_t, bool>>& all_nodes, size_t depth, size_t component_num,
+                            ComponentBuild& build);
 
     ///Compute min_distances and max_distances, which store
     /// distances needed for maximum distance calculation
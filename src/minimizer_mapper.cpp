@@ -11,6 +11,7 @@
 #include "split_strand_graph.hpp"
 #include "subgraph.hpp"
 #include "statistics.hpp"
+#include "batch_pinned_scorer.hpp"
 
 #include <bdsg/overlays/strand_split_overlay.hpp>
 #include <gbwtgraph/algorithms.h>
@@ -165,6 +166,54 @@ vector<Alignment> MinimizerMapper::map(Alignment& aln) {
     // Minimizers sorted by score in descending order.
     std::vector<Minimizer> minimizers = this->find_minimizers(aln.sequence(), funnel);
 
+    return map_from_minimizers(aln, minimizers, funnel);
+}
+
+void MinimizerMapper::map_batch(vector<Alignment>& alns, AlignmentEmitter& alignment_emitter) {
+    for (auto& mappings : map_batch(alns)) {
+        // Ship out all the aligned alignments, in input order
+        alignment_emitter.emit_mapped_single(std::move(mappings));
+    }
+}
+
+vector<vector<Alignment>> MinimizerMapper::map_batch(vector<Alignment>& alns) {
+
+    if (show_work) {
+        #pragma omp critical (cerr)
+        {
+            for (auto& aln : alns) {
+                cerr << log_name() << "Read " << aln.name() << ": " << aln.sequence() << endl;
+            }
+        }
+    }
+
+    // Make a funnel instrumenter to watch us map each read.
+    vector<Funnel> funnels(alns.size());
+    vector<const string*> sequences;
+    vector<Funnel*> funnel_pointers;
+    sequences.reserve(alns.size());
+    funnel_pointers.reserve(alns.size());
+    for (size_t i = 0; i < alns.size(); i++) {
+        funnels[i].start(alns[i].name());
+        sequences.push_back(&alns[i].sequence());
+        funnel_pointers.push_back(&funnels[i]);
+    }
+
+    // Look up the minimizers of all the reads together, so the index probes
+    // for the whole batch are issued before any read starts seeding.
+    vector<vector<Minimizer>> minimizers_by_read = this->find_minimizers_batch(sequences, funnel_pointers);
+
+    // Then map each read the normal way from its minimizers.
+    vector<vector<Alignment>> results;
+    results.reserve(alns.size());
+    for (size_t i = 0; i < alns.size(); i++) {
+        results.emplace_back(map_from_minimizers(alns[i], minimizers_by_read[i], funnels[i]));
+    }
+    return results;
+}
+
+vector<Alignment> MinimizerMapper::map_from_minimizers(Alignment& aln, std::vector<Minimizer>& minimizers, Funnel& funnel) {
+
     // Find the seeds and mark the minimizers that were located.
     std::vector<Seed> seeds = this->find_seeds(minimizers, aln, funnel);
 
@@ -393,6 +442,26 @@ vector<Alignment> MinimizerMapper::map(Alignment& aln) {
         aln.set_read_group(read_group);
     }
     
+    // Remember the minimizers of an extension set we looked at as explored.
+    auto mark_explored = [&](size_t extension_num) {
+        for (size_t i = 0 ; i < minimizer_extended_cluster_count[extension_num].size() ; i++) {
+            minimizer_extensions_count[i] += minimizer_extended_cluster_count[extension_num][i];
+            if (minimizer_extended_cluster_count[extension_num][i] > 0) {
+                // This minimizer is in an extended cluster that gave rise
+                // to at least one alignment, so it is explored.
+                minimizer_explored.insert(i);
+            }
+        }
+    };
+    
+    // If we are bounding tail alignments, alignments that can't score within
+    // this much of the best one can't bring the MAPQ below tail_bound_mapq,
+    // even all together. Each extension set makes at most 2 alignments that
+    // could count.
+    bool bound_tails = do_dp && tail_bound_mapq > 0 && max_multimaps == 1 && get_regular_aligner()->log_base > 0;
+    double tail_bound_margin = !bound_tails ? 0 :
+        (tail_bound_mapq / 10 * log(10.0) + log(2.0 * max_alignments)) / get_regular_aligner()->log_base;
+    
     // Go through the gapless extension groups in score order.
     process_until_threshold_b(cluster_extensions, cluster_extension_scores,
         extension_set_score_threshold, 2, max_alignments,
@@ -413,12 +482,47 @@ vector<Alignment> MinimizerMapper::map(Alignment& aln) {
             if (track_provenance) {
                 funnel.pass("extension-set", extension_num, cluster_extension_scores[extension_num]);
                 funnel.pass("max-alignments", extension_num);
-                funnel.processing_input(extension_num);
             }
-
             
             auto& extensions = cluster_extensions[extension_num];
             
+            if (bound_tails && !alignments.empty() && !GaplessExtender::full_length_extensions(extensions)) {
+                // See if dynamic programming could possibly find anything
+                // that matters, compared to what we have already.
+                int32_t best_score = 0;
+                for (auto& alignment : alignments) {
+                    best_score = max(best_score, alignment.score());
+                }
+                int32_t cutoff = (int32_t) floor(best_score - tail_bound_margin);
+                int32_t bound = tail_alignment_score_bound(aln, extensions, cutoff);
+                
+                if (bound <= cutoff) {
+                    if (track_provenance) {
+                        funnel.fail("tail-bound", extension_num, bound);
+                    }
+                    if (show_work) {
+                        #pragma omp critical (cerr)
+                        {
+                            cerr << log_name() << "gapless extension group " << extension_num << " failed because it can score at most " << bound << " when the best alignment scores " << best_score << endl;
+                        }
+                    }
+                    
+                    // We did look at it, though.
+                    mark_explored(extension_num);
+                    return true;
+                }
+                
+                if (track_provenance) {
+                    funnel.pass("tail-bound", extension_num, bound);
+                }
+            } else if (bound_tails && track_provenance) {
+                funnel.pass("tail-bound", extension_num);
+            }
+            
+            if (track_provenance) {
+                funnel.processing_input(extension_num);
+            }
+            
             // Collect the top alignments. Make sure we have at least one always, starting with unaligned.
             vector<Alignment> best_alignments(1, aln);
 
@@ -515,14 +619,7 @@ vector<Alignment> MinimizerMapper::map(Alignment& aln) {
                 funnel.processed_input();
             }
 
-            for (size_t i = 0 ; i < minimizer_extended_cluster_count[extension_num].size() ; i++) {
-                minimizer_extensions_count[i] += minimizer_extended_cluster_count[extension_num][i];
-                if (minimizer_extended_cluster_count[extension_num][i] > 0) {
-                    // This minimizer is in an extended cluster that gave rise
-                    // to at least one alignment, so it is explored.
-                    minimizer_explored.insert(i);
-                }
-            }
+            mark_explored(extension_num);
             
             return true;
         }, [&](size_t extension_num) {
@@ -918,9 +1015,9 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
     }
     
     // Minimizers for both reads, sorted by score in descending order.
-    std::vector<std::vector<Minimizer>> minimizers_by_read(2);
-    minimizers_by_read[0] = this->find_minimizers(aln1.sequence(), funnels[0]);
-    minimizers_by_read[1] = this->find_minimizers(aln2.sequence(), funnels[1]);
+    // Look them up in the index together so the probes for the two mates overlap.
+    std::vector<std::vector<Minimizer>> minimizers_by_read =
+        this->find_minimizers_batch({ &aln1.sequence(), &aln2.sequence() }, { &funnels[0], &funnels[1] });
 
     // Seeds for both reads, stored in separate vectors.
     std::vector<std::vector<Seed>> seeds_by_read(2);
@@ -2746,53 +2843,94 @@ void MinimizerMapper::extension_to_alignment(const GaplessExtension& extension,
 //-----------------------------------------------------------------------------
 
 std::vector<MinimizerMapper::Minimizer> MinimizerMapper::find_minimizers(const std::string& sequence, Funnel& funnel) const {
+    std::vector<std::vector<Minimizer>> result = this->find_minimizers_batch({ &sequence }, { &funnel });
+    return std::move(result.front());
+}
+
+std::vector<std::vector<MinimizerMapper::Minimizer>> MinimizerMapper::find_minimizers_batch(const std::vector<const std::string*>& sequences,
+                                                                                           const std::vector<Funnel*>& funnels) const {
+
+    assert(sequences.size() == funnels.size());
 
     if (this->track_provenance) {
         // Start the minimizer finding stage
-        funnel.stage("minimizer");
+        for (Funnel* funnel : funnels) {
+            funnel->stage("minimizer");
+        }
     }
 
-    std::vector<Minimizer> result;
-    double base_score = 1.0 + std::log(this->hard_hit_cap);
-    // Get minimizers and their window agglomeration starts and lengths
+    // Get minimizers and their window agglomeration starts and lengths for
+    // every read. This only looks at the reads, not the index.
     // Starts and lengths are all 0 if we are using syncmers.
-    vector<tuple<gbwtgraph::DefaultMinimizerIndex::minimizer_type, size_t, size_t>> minimizers =
-        this->minimizer_index.minimizer_regions(sequence);
-    for (auto& m : minimizers) {
-        double score = 0.0;
-        auto hits = this->minimizer_index.count_and_find(get<0>(m));
-        if (hits.first > 0) {
-            if (hits.first <= this->hard_hit_cap) {
-                score = base_score - std::log(hits.first);
-            } else {
-                score = 1.0;
+    std::vector<std::vector<tuple<gbwtgraph::DefaultMinimizerIndex::minimizer_type, size_t, size_t>>> regions_by_read(sequences.size());
+    size_t total_minimizers = 0;
+    for (size_t i = 0; i < sequences.size(); i++) {
+        regions_by_read[i] = this->minimizer_index.minimizer_regions(*sequences[i]);
+        total_minimizers += regions_by_read[i].size();
+    }
+
+    // Now probe the index for all the minimizers of all the reads in one
+    // tight loop. The hash table lookups are independent, so the cache misses
+    // for different minimizers can be in flight at the same time. While we
+    // are at it, prefetch the start of each hit list that seeding might
+    // decode, so it is in cache by the time find_seeds() gets there.
+    const size_t cache_line_bytes = 64;
+    std::vector<std::pair<size_t, const gbwtgraph::hit_type*>> hits_by_minimizer;
+    hits_by_minimizer.reserve(total_minimizers);
+    for (auto& regions : regions_by_read) {
+        for (auto& m : regions) {
+            hits_by_minimizer.emplace_back(this->minimizer_index.count_and_find(get<0>(m)));
+            auto& hits = hits_by_minimizer.back();
+            if (hits.first > 0 && hits.first <= this->hard_hit_cap) {
+                size_t bytes = std::min(hits.first, this->hit_cap) * sizeof(gbwtgraph::hit_type);
+                for (size_t offset = 0; offset < bytes; offset += cache_line_bytes) {
+                    __builtin_prefetch(reinterpret_cast<const char*>(hits.second) + offset, 0, 1);
+                }
             }
         }
-        
-        // Length of the match from this minimizer or syncmer
-        int32_t match_length = (int32_t) minimizer_index.k();
-        // Number of candidate kmers that this minimizer is minimal of
-        int32_t candidate_count = this->minimizer_index.uses_syncmers() ? 1 : (int32_t) minimizer_index.w();
-        
-        auto& value = std::get<0>(m);
-        size_t agglomeration_start = std::get<1>(m);
-        size_t agglomeration_length = std::get<2>(m);
-        if (this->minimizer_index.uses_syncmers()) {
-            // The index says the start and length are 0. Really they should be where the k-mer is.
-            // So start where the k-mer is on the forward strand
-            agglomeration_start = value.is_reverse ? (value.offset - (match_length - 1)) : value.offset;
-            // And run for the k-mer length
-            agglomeration_length = match_length;
-        }
-        
-        result.push_back({ value, agglomeration_start, agglomeration_length, hits.first, hits.second,
-                            match_length, candidate_count, score });
     }
-    std::sort(result.begin(), result.end());
 
-    if (this->track_provenance) {
-        // Record how many we found, as new lines.
-        funnel.introduce(result.size());
+    // Length of the match from this minimizer or syncmer
+    int32_t match_length = (int32_t) minimizer_index.k();
+    // Number of candidate kmers that this minimizer is minimal of
+    int32_t candidate_count = this->minimizer_index.uses_syncmers() ? 1 : (int32_t) minimizer_index.w();
+    double base_score = 1.0 + std::log(this->hard_hit_cap);
+
+    std::vector<std::vector<Minimizer>> result(sequences.size());
+    size_t next_hits = 0;
+    for (size_t i = 0; i < sequences.size(); i++) {
+        result[i].reserve(regions_by_read[i].size());
+        for (auto& m : regions_by_read[i]) {
+            auto& hits = hits_by_minimizer[next_hits++];
+            double score = 0.0;
+            if (hits.first > 0) {
+                if (hits.first <= this->hard_hit_cap) {
+                    score = base_score - std::log(hits.first);
+                } else {
+                    score = 1.0;
+                }
+            }
+            
+            auto& value = std::get<0>(m);
+            size_t agglomeration_start = std::get<1>(m);
+            size_t agglomeration_length = std::get<2>(m);
+            if (this->minimizer_index.uses_syncmers()) {
+                // The index says the start and length are 0. Really they should be where the k-mer is.
+                // So start where the k-mer is on the forward strand
+                agglomeration_start = value.is_reverse ? (value.offset - (match_length - 1)) : value.offset;
+                // And run for the k-mer length
+                agglomeration_length = match_length;
+            }
+            
+            result[i].push_back({ value, agglomeration_start, agglomeration_length, hits.first, hits.second,
+                                  match_length, candidate_count, score });
+        }
+        std::sort(result[i].begin(), result[i].end());
+
+        if (this->track_provenance) {
+            // Record how many we found, as new lines.
+            funnels[i]->introduce(result[i].size());
+        }
     }
 
     return result;
@@ -3304,6 +3442,107 @@ int32_t flank_penalty(size_t length, const std::vector<pareto_point>& frontier,
     return result;
 }
 
+// Upper bound on the score of a pinned tail alignment of the given length,
+// when aligning all of it takes at least the given number of edits.
+int32_t tail_score_bound(size_t length, size_t edits, const Aligner* aligner) {
+    if (length == 0) {
+        return 0;
+    }
+    // Every edit costs at least this much, relative to matching a base
+    int32_t edit_cost = std::min<int32_t>(aligner->match + aligner->mismatch, std::min<int32_t>(aligner->gap_open, aligner->gap_extension));
+    if (edit_cost <= 0) {
+        // Edits might not cost anything, so all we know is the perfect score.
+        edits = 0;
+    }
+    // Aligning the whole tail gets the full length bonus
+    int32_t result = (int32_t) length * aligner->match + aligner->full_length_bonus - (int32_t) edits * edit_cost;
+    // Soft clipping the far end means aligning a shorter prefix, which still
+    // needs at least edits - (length - aligned) edits. The best of those is
+    // either as short as possible with no edits needed, or as long as
+    // possible. Clipping everything scores 0.
+    size_t no_edit_length = edits >= length ? 0 : length - edits;
+    size_t max_clipped_length = length - 1;
+    for (size_t aligned : {std::min(no_edit_length, max_clipped_length), max_clipped_length}) {
+        size_t needed_edits = edits > length - aligned ? edits - (length - aligned) : 0;
+        result = std::max<int32_t>(result, (int32_t) aligned * aligner->match - (int32_t) needed_edits * edit_cost);
+    }
+    return std::max<int32_t>(result, 0);
+}
+
+int32_t MinimizerMapper::tail_alignment_score_bound(const Alignment& aln, const vector<GaplessExtension>& extended_seeds,
+    int32_t cutoff) const {
+    
+    const Aligner* aligner = this->get_regular_aligner();
+    size_t seq_len = aln.sequence().size();
+    
+    int32_t best_bound = numeric_limits<int32_t>::min();
+    for (const GaplessExtension& extension : extended_seeds) {
+        size_t left_length = extension.left_full ? 0 : extension.read_interval.first;
+        size_t right_length = extension.right_full ? 0 : seq_len - extension.read_interval.second;
+        
+        // Start out assuming the tails match perfectly
+        int32_t left_bound = tail_score_bound(left_length, 0, aligner);
+        int32_t right_bound = tail_score_bound(right_length, 0, aligner);
+        
+        for (bool left : {true, false}) {
+            if (extension.score + left_bound + right_bound <= cutoff) {
+                // This extension can't beat the cutoff
+                break;
+            }
+            size_t tail_length = left ? left_length : right_length;
+            if (tail_length == 0) {
+                continue;
+            }
+            // Tighten the bound for this tail. Left tails are aligned
+            // reverse complemented, against trees reading left.
+            auto forest = get_tail_forest(extension, seq_len, left);
+            string tail_sequence = left ? reverse_complement(aln.sequence().substr(0, tail_length))
+                                        : aln.sequence().substr(extension.read_interval.second);
+            size_t edits = tail_edit_distance(MyersEditDistance(tail_sequence), forest);
+            (left ? left_bound : right_bound) = tail_score_bound(tail_length, edits, aligner);
+        }
+        
+        int32_t bound = extension.score + left_bound + right_bound;
+        best_bound = std::max(best_bound, bound);
+        if (best_bound > cutoff) {
+            // We know the answer now.
+            break;
+        }
+    }
+    
+    return best_bound;
+}
+
+size_t MinimizerMapper::tail_edit_distance(const MyersEditDistance& pattern, const vector<TreeSubgraph>& trees) const {
+    // Not aligning any of the tree means inserting the whole pattern.
+    int64_t best = pattern.pattern_length();
+    
+    // Walk each tree depth first, copying the column at branches.
+    vector<pair<handle_t, MyersEditDistance::Column>> stack;
+    for (auto& tree : trees) {
+        if (tree.get_node_count() == 0) {
+            continue;
+        }
+        stack.emplace_back(tree.get_root(), pattern.start());
+        while (!stack.empty() && best > 0) {
+            handle_t here = stack.back().first;
+            MyersEditDistance::Column column = std::move(stack.back().second);
+            stack.pop_back();
+            
+            for (char base : tree.get_sequence(here)) {
+                pattern.advance(column, base);
+                best = std::min(best, column.score);
+            }
+            tree.follow_edges(here, false, [&](const handle_t& next) {
+                stack.emplace_back(next, column);
+            });
+        }
+        stack.clear();
+    }
+    
+    return best;
+}
+
 void MinimizerMapper::find_optimal_tail_alignments(const Alignment& aln, const vector<GaplessExtension>& extended_seeds, Alignment& best, Alignment& second_best) const {
 
     // This assumes that full-length extensions have the highest scores.
@@ -3631,9 +3870,46 @@ pair<Path, size_t> MinimizerMapper::get_best_alignment_against_any_tree(const ve
         }
     }
     
+    // If pinning right, we need to reverse the sequence, since we are
+    // always pinning left to the left edge of the tree subgraph.
+    string pinned_sequence = pin_left ? sequence : reverse_complement(sequence);
+    
+    // Bound the score against each tree, if we can
+    vector<int32_t> tree_bounds;
+    if (bound_tail_trees && trees.size() > 1) {
+        tree_bounds = tail_tree_score_bounds(trees, pinned_sequence);
+    }
+    
+    // Try the most promising trees first, so we can skip the rest. Ties stay
+    // in tree order.
+    vector<size_t> tree_order = range_vector(trees.size());
+    if (!tree_bounds.empty()) {
+        std::stable_sort(tree_order.begin(), tree_order.end(), [&](size_t a, size_t b) {
+            return tree_bounds[a] > tree_bounds[b];
+        });
+    }
+    // Which tree gave the best alignment, if any? Without bounds, the first
+    // tree to get the best score wins, so we keep that rule when reordering.
+    size_t best_tree = numeric_limits<size_t>::max();
+    
     // We can align it once per target tree
-    for (auto& subgraph : trees) {
+    for (size_t tree_num : tree_order) {
         // For each tree we can map against, map pinning the correct edge of the sequence to the root.
+        auto& subgraph = trees[tree_num];
+        
+        if (!tree_bounds.empty() && (tree_bounds[tree_num] < best_score ||
+            (tree_bounds[tree_num] == best_score && tree_num > best_tree))) {
+            // Dynamic programming can't find anything good enough here to
+            // replace what we have.
+            if (show_work) {
+                #pragma omp critical (cerr)
+                {
+                    cerr << log_name() << "Skip tree " << tree_num << " with score bound "
+                        << tree_bounds[tree_num] << endl;
+                }
+            }
+            continue;
+        }
         
         if (subgraph.get_node_count() != 0) {
             // This path has bases in it and could potentially be better than
@@ -3641,9 +3917,7 @@ pair<Path, size_t> MinimizerMapper::get_best_alignment_against_any_tree(const ve
 
             // Do alignment to the subgraph with GSSWAligner.
             Alignment current_alignment;
-            // If pinning right, we need to reverse the sequence, since we are
-            // always pinning left to the left edge of the tree subgraph.
-            current_alignment.set_sequence(pin_left ? sequence : reverse_complement(sequence));
+            current_alignment.set_sequence(pinned_sequence);
             
             if (show_work) {
                 #pragma omp critical (cerr)
@@ -3694,8 +3968,11 @@ pair<Path, size_t> MinimizerMapper::get_best_alignment_against_any_tree(const ve
                 }
             }
             
-            if (current_alignment.score() > best_score) {
-                // This is a new best alignment.
+            if (current_alignment.score() > best_score ||
+                (current_alignment.score() == best_score && best_tree != numeric_limits<size_t>::max()
+                 && tree_num < best_tree)) {
+                // This is a new best alignment, or the one earlier in tree
+                // order we would have found first without reordering.
                 best_path = current_alignment.path();
                 
                 if (!pin_left) {
@@ -3708,6 +3985,7 @@ pair<Path, size_t> MinimizerMapper::get_best_alignment_against_any_tree(const ve
                 // Translate from subgraph into base graph and keep it.
                 best_path = subgraph.translate_down(best_path);
                 best_score = current_alignment.score();
+                best_tree = tree_num;
                 
                 if (show_work) {
                     #pragma omp critical (cerr)
@@ -3723,6 +4001,60 @@ pair<Path, size_t> MinimizerMapper::get_best_alignment_against_any_tree(const ve
     return make_pair(best_path, best_score);
 }
 
+vector<int32_t> MinimizerMapper::tail_tree_score_bounds(const vector<TreeSubgraph>& trees, const string& sequence) const {
+    
+    // Any pinned alignment to a tree follows one path from its root to a
+    // leaf, so spell all those paths out, and remember the tree of each.
+    vector<string> paths;
+    vector<size_t> path_trees;
+    vector<pair<handle_t, string>> stack;
+    for (size_t i = 0; i < trees.size(); i++) {
+        auto& tree = trees[i];
+        if (tree.get_node_count() == 0) {
+            continue;
+        }
+        stack.emplace_back(tree.get_root(), "");
+        while (!stack.empty()) {
+            handle_t here = stack.back().first;
+            string spelled = std::move(stack.back().second);
+            stack.pop_back();
+            
+            spelled += tree.get_sequence(here);
+            bool is_leaf = true;
+            tree.follow_edges(here, false, [&](const handle_t& next) {
+                is_leaf = false;
+                stack.emplace_back(next, spelled);
+            });
+            if (is_leaf) {
+                if (paths.size() >= max_tail_tree_paths) {
+                    // Too bushy to be worth it.
+                    return vector<int32_t>();
+                }
+                paths.emplace_back(std::move(spelled));
+                path_trees.push_back(i);
+            }
+        }
+    }
+    
+    // Score all the paths together, a batch of paths to a vector.
+    const Aligner* aligner = get_regular_aligner();
+    int8_t score_matrix[16];
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 4; j++) {
+            // The aligner keeps a 5x5 matrix with a row and column for N.
+            score_matrix[i * 4 + j] = aligner->score_matrix[i * 5 + j];
+        }
+    }
+    BatchPinnedScorer scorer(score_matrix, aligner->gap_open, aligner->gap_extension, aligner->full_length_bonus);
+    vector<int32_t> path_scores = scorer.score(sequence, paths);
+    
+    vector<int32_t> bounds(trees.size(), 0);
+    for (size_t i = 0; i < paths.size(); i++) {
+        bounds[path_trees[i]] = std::max(bounds[path_trees[i]], path_scores[i]);
+    }
+    return bounds;
+}
+
 vector<TreeSubgraph> MinimizerMapper::get_tail_forest(const GaplessExtension& extended_seed,
     size_t read_length, bool left_tails, size_t* longest_detectable_gap) const {
 
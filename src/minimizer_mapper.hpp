@@ -12,6 +12,7 @@
 #include "gapless_extender.hpp"
 #include "mapper.hpp"
 #include "min_distance.hpp"
+#include "myers_edit_distance.hpp"
 #include "seed_clusterer.hpp"
 #include "snarls.hpp"
 #include "tree_subgraph.hpp"
@@ -50,6 +51,20 @@ public:
      */
     vector<Alignment> map(Alignment& aln);
     
+    /**
+     * Map a batch of independent reads, and send output to the given
+     * AlignmentEmitter in input order. The minimizers of all the reads are
+     * looked up in the index together before any read is seeded, so the index
+     * cache misses for the batch overlap. May be run from any thread.
+     */
+    void map_batch(vector<Alignment>& alns, AlignmentEmitter& alignment_emitter);
+    
+    /**
+     * Map a batch of independent reads. Return, for each read in input order,
+     * a vector of alignments that it maps to, winner first.
+     */
+    vector<vector<Alignment>> map_batch(vector<Alignment>& alns);
+    
     // The idea here is that the subcommand feeds all the reads to the version
     // of map_paired that takes a buffer, and then empties the buffer by
     // iterating over it in parallel with the version that doesn't.
@@ -130,6 +145,30 @@ public:
 
     size_t max_multimaps = 1;
     size_t distance_limit = 200;
+    
+    /// If nonzero, before doing dynamic programming on an extension set for
+    /// single-end reads, bound its best possible alignment score with
+    /// bit-parallel edit distances of its tails against their haplotypes, and
+    /// skip it if it can't score close enough to the best alignment so far to
+    /// bring the MAPQ below this. Skipped sets fail the "tail-bound" filter.
+    double tail_bound_mapq = 0;
+    
+    /// If set, before X-drop aligning a tail against each tree of its tail
+    /// forest, score it against all of the trees' paths at once with
+    /// full dynamic programming, a path to a vector lane, and only align to
+    /// the trees that could beat the best alignment found so far.
+    bool bound_tail_trees = false;
+    
+    /// Don't bound tail alignments to tail forests with more than this many
+    /// root-to-leaf paths in total.
+    size_t max_tail_tree_paths = 256;
+
+    /// If a read (or pair) has at least this many seeds, cluster independent
+    /// parts of the snarl tree in parallel. 0 means never. Must not be called
+    /// while mapping.
+    void set_parallel_cluster_seeds(size_t seed_count) {
+        clusterer.parallel_seed_threshold = seed_count;
+    }
     bool do_dp = true;
     string sample_name;
     string read_group;
@@ -276,6 +315,16 @@ protected:
      */
     std::vector<Minimizer> find_minimizers(const std::string& sequence, Funnel& funnel) const;
 
+    /**
+     * Find the minimizers in each of the given sequences, using the
+     * corresponding funnel for each. All the index lookups for the batch are
+     * done together, and the hit lists that seeding will read are prefetched.
+     * Returns the minimizers for each sequence sorted in descending order by
+     * score.
+     */
+    std::vector<std::vector<Minimizer>> find_minimizers_batch(const std::vector<const std::string*>& sequences,
+                                                              const std::vector<Funnel*>& funnels) const;
+
     /**
      * Find seeds for all minimizers passing the filters.
      */
@@ -301,6 +350,12 @@ protected:
      */
     std::vector<int> score_extensions(const std::vector<std::pair<std::vector<GaplessExtension>, size_t>>& extensions, const Alignment& aln, Funnel& funnel) const;
 
+    /**
+     * Do all the stages of single-end mapping after the minimizers have been
+     * found, for a read whose funnel has already been started.
+     */
+    vector<Alignment> map_from_minimizers(Alignment& aln, std::vector<Minimizer>& minimizers, Funnel& funnel);
+
 //-----------------------------------------------------------------------------
 
     // Rescue.
@@ -495,6 +550,26 @@ protected:
      */
     void find_optimal_tail_alignments(const Alignment& aln, const vector<GaplessExtension>& extended_seeds, Alignment& best, Alignment& second_best) const; 
     
+    /**
+     * Get an upper bound on the score of the best alignment that
+     * find_optimal_tail_alignments() could produce for the given extended
+     * seeds, without doing any dynamic programming. Tails are bounded with the
+     * bit-parallel edit distance to their tail forests.
+     *
+     * Stops early and returns a bound greater than cutoff as soon as one is
+     * found, since then the extended seeds have to be aligned anyway.
+     */
+    int32_t tail_alignment_score_bound(const Alignment& aln, const vector<GaplessExtension>& extended_seeds,
+        int32_t cutoff) const;
+    
+    /**
+     * Get the minimum edit distance between the given pattern and any
+     * sequence spelled from the root of any of the given trees, as
+     * get_tail_forest() produces them. The pattern has to be aligned
+     * completely, but may end anywhere in the tree.
+     */
+    size_t tail_edit_distance(const MyersEditDistance& pattern, const vector<TreeSubgraph>& trees) const;
+    
     /**
      * Find for each pair of extended seeds all the haplotype-consistent graph
      * paths against which the intervening read sequence needs to be aligned.
@@ -559,6 +634,14 @@ protected:
      */
     pair<Path, size_t> get_best_alignment_against_any_tree(const vector<TreeSubgraph>& trees, const string& sequence,
         const Position& default_position, bool pin_left, size_t longest_detectable_gap) const;
+    
+    /**
+     * Get an upper bound on the score of a left-pinned alignment of the given
+     * sequence to each of the given trees, including the full length bonus.
+     * Returns an empty vector if the trees have more than
+     * max_tail_tree_paths root-to-leaf paths.
+     */
+    vector<int32_t> tail_tree_score_bounds(const vector<TreeSubgraph>& trees, const string& sequence) const;
         
     /// We define a type for shared-tail lists of Mappings, to avoid constantly
     /// copying Path objects.
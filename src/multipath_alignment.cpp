@@ -1760,6 +1760,7 @@ namespace vg {
         
         // remove subpaths to avoid duplicating
         rev_comp_out.clear_subpath();
+        rev_comp_out.mutable_subpath()->reserve(multipath_aln.subpath_size());
         
         // add subpaths in reverse order to maintain topological ordering
         for (int64_t i = multipath_aln.subpath_size() - 1; i >= 0; i--) {
@@ -1981,7 +1982,8 @@ namespace vg {
         multipath_aln_out.clear_start();
         transfer_read_metadata(proto_multipath_aln, multipath_aln_out);
         multipath_aln_out.set_mapping_quality(proto_multipath_aln.mapping_quality());
-        for (auto subpath : proto_multipath_aln.subpath()) {
+        multipath_aln_out.mutable_subpath()->reserve(proto_multipath_aln.subpath_size());
+        for (const auto& subpath : proto_multipath_aln.subpath()) {
             auto subpath_copy = multipath_aln_out.add_subpath();
             subpath_copy->set_score(subpath.score());
             for (auto next : subpath.next()) {
@@ -1993,7 +1995,7 @@ namespace vg {
                 connection_copy->set_score(connection.score());
             }
             if (subpath.has_path()) {
-                auto path = subpath.path();
+                const auto& path = subpath.path();
                 auto path_copy = subpath_copy->mutable_path();
                 from_proto_path(path, *path_copy);
             }
@@ -95,9 +95,11 @@ namespace vg {
         inline const string& sequence() const;
         inline string* mutable_sequence();
         inline void set_sequence(const string& s);
+        inline void set_sequence(string&& s);
         inline const string& quality() const;
         inline string* mutable_quality();
         inline void set_quality(const string& q);
+        inline void set_quality(string&& q);
         inline const vector<subpath_t>& subpath() const;
         inline const subpath_t& subpath(size_t i) const;
         inline vector<subpath_t>* mutable_subpath();
@@ -486,6 +488,9 @@ namespace vg {
     inline void multipath_alignment_t::set_sequence(const string& s) {
         _sequence = s;
     }
+    inline void multipath_alignment_t::set_sequence(string&& s) {
+        _sequence = std::move(s);
+    }
     inline const string& multipath_alignment_t::quality() const {
         return _quality;
     }
@@ -495,6 +500,9 @@ namespace vg {
     inline void multipath_alignment_t::set_quality(const string& q) {
         _quality = q;
     }
+    inline void multipath_alignment_t::set_quality(string&& q) {
+        _quality = std::move(q);
+    }
     inline const vector<subpath_t>& multipath_alignment_t::subpath() const {
         return _subpath;
     }
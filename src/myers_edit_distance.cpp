@@ -0,0 +1,120 @@
+/**
+ * \file myers_edit_distance.cpp
+ *
+ * Implements the bit-parallel edit distance computation.
+ */
+
+#include "myers_edit_distance.hpp"
+
+#include <algorithm>
+
+namespace vg {
+
+using namespace std;
+
+MyersEditDistance::MyersEditDistance(const string& pattern) : length(pattern.size()), last_bit((pattern.size() + 63) % 64) {
+    size_t words = (length + 63) / 64;
+    for (size_t i = 0; i < 4; i++) {
+        matches[i].resize(words, 0);
+    }
+    // Anything that isn't ACGT in the text matches everything, including the
+    // padding at the end of the last word, which is never read.
+    matches[4].resize(words, ~(uint64_t) 0);
+
+    for (size_t i = 0; i < length; i++) {
+        size_t which = char_class(pattern[i]);
+        uint64_t bit = (uint64_t) 1 << (i % 64);
+        if (which == 4) {
+            // Matches all the text characters
+            for (size_t j = 0; j < 4; j++) {
+                matches[j][i / 64] |= bit;
+            }
+        } else {
+            matches[which][i / 64] |= bit;
+        }
+    }
+}
+
+size_t MyersEditDistance::char_class(char c) {
+    switch (c) {
+    case 'A':
+    case 'a':
+        return 0;
+    case 'C':
+    case 'c':
+        return 1;
+    case 'G':
+    case 'g':
+        return 2;
+    case 'T':
+    case 't':
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+MyersEditDistance::Column MyersEditDistance::start() const {
+    Column column;
+    // Row i of the first column is i: going down, everything goes up by 1.
+    column.plus.resize(matches[0].size(), ~(uint64_t) 0);
+    column.minus.resize(matches[0].size(), 0);
+    column.score = length;
+    return column;
+}
+
+void MyersEditDistance::advance(Column& column, char text_char) const {
+    const vector<uint64_t>& eq_words = matches[char_class(text_char)];
+    size_t words = eq_words.size();
+
+    // The alignment has to start at the start of the text, so the top row
+    // counts the text characters skipped, and always goes up by 1.
+    int carry_in = 1;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t pv = column.plus[i];
+        uint64_t mv = column.minus[i];
+        uint64_t eq = eq_words[i];
+        uint64_t carry_is_negative = (carry_in < 0) ? 1 : 0;
+
+        uint64_t xv = eq | mv;
+        eq |= carry_is_negative;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+
+        int carry_out;
+        if (i + 1 == words) {
+            // The last row may be in the middle of the word. Rows below it
+            // are padding, and never affect the rows above.
+            carry_out = (int) ((ph >> last_bit) & 1) - (int) ((mh >> last_bit) & 1);
+            column.score += carry_out;
+        } else {
+            carry_out = (int) (ph >> 63) - (int) (mh >> 63);
+        }
+
+        ph <<= 1;
+        mh <<= 1;
+        mh |= carry_is_negative;
+        ph |= (carry_in > 0) ? 1 : 0;
+
+        column.plus[i] = mh | ~(xv | ph);
+        column.minus[i] = ph & xv;
+        carry_in = carry_out;
+    }
+}
+
+size_t MyersEditDistance::prefix_distance(const string& text) const {
+    Column column = start();
+    int64_t best = column.score;
+    for (size_t i = 0; i < text.size() && best > 0; i++) {
+        advance(column, text[i]);
+        best = min(best, column.score);
+    }
+    return best;
+}
+
+size_t MyersEditDistance::pattern_length() const {
+    return length;
+}
+
+}
@@ -0,0 +1,84 @@
+#ifndef VG_MYERS_EDIT_DISTANCE_HPP_INCLUDED
+#define VG_MYERS_EDIT_DISTANCE_HPP_INCLUDED
+
+/**
+ * \file myers_edit_distance.hpp
+ *
+ * Defines a bit-parallel edit distance computation, for cheaply bounding how
+ * well a sequence could possibly align before doing real dynamic programming.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vg {
+
+using namespace std;
+
+/**
+ * Computes edit distances between a fixed DNA pattern and texts, with Myers'
+ * bit-parallel algorithm, as extended to patterns longer than a machine word
+ * by Hyyrö. Each character of text costs one pass over ceil(m / 64) words.
+ *
+ * The whole pattern must be aligned, starting at the start of the text, but
+ * the alignment can stop anywhere in the text (edlib's "prefix" mode). That
+ * is the shape of a tail alignment pinned at one end.
+ *
+ * N (or any other non-ACGT character) in either sequence matches anything, so
+ * the distance is never more than the number of edits an aligner would have
+ * to pay for.
+ *
+ * The text can be fed in a character at a time, and a Column can be copied
+ * to explore several texts that share a prefix, such as the branches of a
+ * tree.
+ */
+class MyersEditDistance {
+public:
+
+    /// Prepare to compute edit distances for the given pattern.
+    MyersEditDistance(const string& pattern);
+
+    /// One column of the dynamic programming matrix, for the text read so far.
+    struct Column {
+        /// Bits for the rows where the value goes up by 1 from the row above
+        vector<uint64_t> plus;
+        /// Bits for the rows where the value goes down by 1 from the row above
+        vector<uint64_t> minus;
+        /// Edit distance between the whole pattern and the text read so far
+        int64_t score;
+    };
+
+    /// Get the column for an empty text, where every pattern character is an
+    /// insertion.
+    Column start() const;
+
+    /// Update the column to account for one more character of text.
+    void advance(Column& column, char text_char) const;
+
+    /// Get the minimum edit distance between the whole pattern and any prefix
+    /// of the given text.
+    size_t prefix_distance(const string& text) const;
+
+    /// Get the length of the pattern.
+    size_t pattern_length() const;
+
+private:
+
+    /// How long is the pattern?
+    size_t length;
+
+    /// Which bit of the last word holds the last row of the pattern?
+    size_t last_bit;
+
+    /// For each text character class (A, C, G, T, and anything else), the
+    /// words of bits for the pattern positions it matches.
+    vector<uint64_t> matches[5];
+
+    /// Get the character class for a character.
+    static size_t char_class(char c);
+};
+
+}
+
+#endif
@@ -30,7 +30,7 @@ size_t Packer::estimate_bin_count(size_t num_threads) {
 
 Packer::Packer(const HandleGraph* graph) : graph(graph), data_width(8), cov_bin_size(0), edge_cov_bin_size(0), num_bases_dynamic(0), base_locks(nullptr), num_edges_dynamic(0), edge_locks(nullptr), node_quality_locks(nullptr), tmpfstream_locks(nullptr) { }
 
-Packer::Packer(const HandleGraph* graph, bool record_bases, bool record_edges, bool record_edits, bool record_qualities, size_t bin_size, size_t coverage_bins, size_t data_width) :
+Packer::Packer(const HandleGraph* graph, bool record_bases, bool record_edges, bool record_edits, bool record_qualities, size_t bin_size, size_t coverage_bins, size_t data_width, size_t thread_buffer_size) :
     graph(graph), data_width(data_width), bin_size(bin_size), record_bases(record_bases), record_edges(record_edges), record_edits(record_edits), record_qualities(record_qualities) {
     // get the size of the base coverage counter
     num_bases_dynamic = 0;
@@ -101,6 +101,12 @@ Packer::Packer(const HandleGraph* graph, bool record_bases, bool record_edges, b
     for (size_t i = 0; i < get_thread_count(); ++i) {
         quality_cache.push_back(new LRUCache<pair<int, int>, int>(lru_cache_size));
     }
+
+    // let each thread collect its own coverage between merges
+    this->thread_buffer_size = thread_buffer_size;
+    if (thread_buffer_size > 0) {
+        thread_buffers.resize(get_thread_count());
+    }
     
 #ifdef debug
     cerr << "Packing across " << num_edges_dynamic << " edge slots and " << num_bases_dynamic << " base slots in " << coverage_bins << " bins" << endl;
@@ -128,6 +134,7 @@ void Packer::clear() {
     node_quality_locks = nullptr;
     delete [] tmpfstream_locks;
     tmpfstream_locks = nullptr;
+    thread_buffers.clear();
     close_edit_tmpfiles();
     remove_edit_tmpfiles();
     for (auto& lru_cache : quality_cache) {
@@ -200,6 +207,7 @@ void Packer::merge_from_dynamic(vector<Packer*>& packers) {
     bool first = true;
     for (auto& p : packers) {
         auto& c = *p;
+        c.flush_thread_buffers();
         c.close_edit_tmpfiles(); // flush and close temporaries
         // take bin size and counts from the first, assume they are all the same
         if (first) {
@@ -253,6 +261,9 @@ void Packer::write_edits(ostream& out, size_t bin) const {
 void Packer::collect_coverage(const vector<Packer*>& packers) {
     // assume the same basis vector
     assert(!is_compacted);
+    for (auto& packer : packers) {
+        packer->flush_thread_buffers();
+    }
     if (record_bases) {
 #pragma omp parallel for
         for (size_t i = 0; i < coverage_dynamic.size(); ++i) {
@@ -328,6 +339,7 @@ void Packer::make_compact(void) {
 #endif
     }
     // sync edit file
+    flush_thread_buffers();
     close_edit_tmpfiles();
     
     // temporaries for construction
@@ -461,6 +473,8 @@ void Packer::add(const Alignment& aln, int min_mapq, int min_baseq) {
     if (mapping_quality < min_mapq) {
         return;
     }
+    // collect coverage in this thread's buffer if we have one
+    ThreadBuffer* buffer = get_thread_buffer();
     // count the nodes, edges, and edits
     Mapping prev_mapping;
     bool has_prev_mapping = false;
@@ -501,7 +515,11 @@ void Packer::add(const Alignment& aln, int min_mapq, int min_baseq) {
                         ++bq_count;
                         // base quality threshold filter (only if we found some kind of quality)
                         if (base_quality < 0 || base_quality >= min_baseq) {
-                            increment_coverage(coverage_idx);
+                            if (buffer != nullptr) {
+                                buffer->bases.emplace_back(coverage_idx, 1);
+                            } else {
+                                increment_coverage(coverage_idx);
+                            }
                             if (record_qualities && mapping_quality > 0) {
                                 total_node_quality += mapping_quality;
                             }
@@ -512,8 +530,13 @@ void Packer::add(const Alignment& aln, int min_mapq, int min_baseq) {
                     string pos_repr = pos_key(i);
                     string edit_repr = edit_value(edit, mapping.position().is_reverse());
                     size_t bin = bin_for_position(i);
-                    std::lock_guard<std::mutex> guard(tmpfstream_locks[bin]);
-                    *tmpfstreams[bin] << pos_repr << edit_repr;
+                    if (buffer != nullptr) {
+                        buffer->edit_bytes += pos_repr.size() + edit_repr.size();
+                        buffer->edits.emplace_back(bin, pos_repr + edit_repr);
+                    } else {
+                        std::lock_guard<std::mutex> guard(tmpfstream_locks[bin]);
+                        *tmpfstreams[bin] << pos_repr << edit_repr;
+                    }
                 } 
                 if (mapping.position().is_reverse()) {
                     i -= edit.from_length();
@@ -525,7 +548,11 @@ void Packer::add(const Alignment& aln, int min_mapq, int min_baseq) {
                 }
             }
             if (total_node_quality > 0) {
-                increment_node_quality(node_quality_index, total_node_quality);
+                if (buffer != nullptr) {
+                    buffer->qualities.emplace_back(node_quality_index, total_node_quality);
+                } else {
+                    increment_node_quality(node_quality_index, total_node_quality);
+                }
             }
         }
         
@@ -553,7 +580,11 @@ void Packer::add(const Alignment& aln, int min_mapq, int min_baseq) {
                 }
                 // base quality threshold filter (only if we found some kind of quality)
                 if (avg_base_quality < 0 || avg_base_quality >= min_baseq) {
-                    increment_edge_coverage(edge_idx);
+                    if (buffer != nullptr) {
+                        buffer->edges.emplace_back(edge_idx, 1);
+                    } else {
+                        increment_edge_coverage(edge_idx);
+                    }
                 }
             }
         }
@@ -561,6 +592,81 @@ void Packer::add(const Alignment& aln, int min_mapq, int min_baseq) {
         prev_mapping = mapping;
         has_prev_mapping = true;
     }
+
+    if (buffer != nullptr) {
+        flush_thread_buffer(*buffer, true);
+    }
+}
+
+Packer::ThreadBuffer* Packer::get_thread_buffer() {
+    size_t thread_num = omp_get_thread_num();
+    if (thread_num < thread_buffers.size()) {
+        return &thread_buffers[thread_num];
+    }
+    return nullptr;
+}
+
+void Packer::flush_thread_buffers() {
+#pragma omp parallel for
+    for (size_t i = 0; i < thread_buffers.size(); ++i) {
+        flush_thread_buffer(thread_buffers[i], false);
+    }
+}
+
+void Packer::flush_thread_buffer(ThreadBuffer& buffer, bool full_only) {
+    if (!full_only || buffer.bases.size() >= thread_buffer_size) {
+        flush_increments(buffer.bases, coverage_dynamic, base_locks,
+                         &Packer::coverage_bin_offset, &Packer::init_coverage_bin);
+    }
+    if (!full_only || buffer.edges.size() >= thread_buffer_size) {
+        flush_increments(buffer.edges, edge_coverage_dynamic, edge_locks,
+                         &Packer::edge_coverage_bin_offset, &Packer::init_edge_coverage_bin);
+    }
+    if (!full_only || buffer.qualities.size() >= thread_buffer_size) {
+        flush_increments(buffer.qualities, node_quality_dynamic, node_quality_locks,
+                         &Packer::node_quality_bin_offset, &Packer::init_node_quality_bin);
+    }
+    // edits get about as much memory as a full coverage buffer
+    if (!buffer.edits.empty() && (!full_only || buffer.edit_bytes >= thread_buffer_size * sizeof(pair<size_t, size_t>))) {
+        // keep this thread's edits in order within each bin
+        std::stable_sort(buffer.edits.begin(), buffer.edits.end(),
+                         [](const pair<size_t, string>& a, const pair<size_t, string>& b) {
+                             return a.first < b.first;
+                         });
+        for (size_t j = 0; j < buffer.edits.size();) {
+            size_t bin = buffer.edits[j].first;
+            std::lock_guard<std::mutex> guard(tmpfstream_locks[bin]);
+            for (; j < buffer.edits.size() && buffer.edits[j].first == bin; ++j) {
+                *tmpfstreams[bin] << buffer.edits[j].second;
+            }
+        }
+        buffer.edits.clear();
+        buffer.edit_bytes = 0;
+    }
+}
+
+void Packer::flush_increments(vector<pair<size_t, size_t>>& increments, vector<gcsa::CounterArray*>& counters,
+                              std::mutex* locks, pair<size_t, size_t> (Packer::*bin_offset)(size_t) const,
+                              void (Packer::*init_bin)(size_t)) {
+    if (increments.empty()) {
+        return;
+    }
+    // sorting puts each bin's increments together, and repeated positions next to each other
+    std::sort(increments.begin(), increments.end());
+    for (size_t j = 0; j < increments.size();) {
+        size_t bin = (this->*bin_offset)(increments[j].first).first;
+        std::lock_guard<std::mutex> guard(locks[bin]);
+        (this->*init_bin)(bin);
+        while (j < increments.size() && (this->*bin_offset)(increments[j].first).first == bin) {
+            size_t position = increments[j].first;
+            size_t total = 0;
+            for (; j < increments.size() && increments[j].first == position; ++j) {
+                total += increments[j].second;
+            }
+            counters[bin]->increment((this->*bin_offset)(position).second, total);
+        }
+    }
+    increments.clear();
 }
 
 // find the position on the forward strand in the sequence vector
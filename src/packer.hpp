@@ -49,8 +49,11 @@ public:
     /// coverage_bins : Use this many coverage objects.  Using one / thread allows faster merge
     /// coverage_locks : Number of mutexes to use for each of node and edge coverage.
     /// data_width : Number of bits per entry in the dynamic coverage vector.  Higher values get stored in a map
+    /// thread_buffer_size : If nonzero, each thread buffers this many coverage increments (and about as many
+    ///                      bytes of edits) from add() and merges them into the shared bins in sorted order,
+    ///                      taking each bin's lock once per flush instead of once per base
     Packer(const HandleGraph* graph, bool record_bases, bool record_edges, bool record_edits, bool record_qualities,
-           size_t bin_size = 0, size_t coverage_bins = 1, size_t data_width = 8);
+           size_t bin_size = 0, size_t coverage_bins = 1, size_t data_width = 8, size_t thread_buffer_size = 0);
     ~Packer();
     void clear();
 
@@ -60,6 +63,10 @@ public:
     /// min_baseq : ignore bases in the alignment if their read quality is below this value
     void add(const Alignment& aln, int min_mapq = 0, int min_baseq = 0);
 
+    /// Merge everything buffered by add() into the coverage bins and edit files.
+    /// Must not run at the same time as add(). Done automatically before compacting or merging.
+    void flush_thread_buffers();
+
     void merge_from_files(const vector<string>& file_names);
     void merge_from_dynamic(vector<Packer*>& packers);
     void load_from_file(const string& file_name);
@@ -126,6 +133,28 @@ private:
     void init_edge_coverage_bin(size_t i);
     void init_node_quality_bin(size_t i);
     
+    /// Coverage and edits from add() that one thread has not yet merged
+    struct ThreadBuffer {
+        /// (position, increment) pairs for each kind of counter
+        vector<pair<size_t, size_t>> bases;
+        vector<pair<size_t, size_t>> edges;
+        vector<pair<size_t, size_t>> qualities;
+        /// (bin, record) pairs of serialized edits
+        vector<pair<size_t, string>> edits;
+        size_t edit_bytes = 0;
+    };
+    /// One buffer per thread, or empty if we aren't buffering
+    vector<ThreadBuffer> thread_buffers;
+    size_t thread_buffer_size = 0;
+    /// Get the calling thread's buffer, or nullptr if it should write directly
+    ThreadBuffer* get_thread_buffer();
+    /// Merge a thread's buffers. If full_only is set, only merge those that are full.
+    void flush_thread_buffer(ThreadBuffer& buffer, bool full_only);
+    /// Sort (position, increment) pairs and add them to the given counters, locking each bin once
+    void flush_increments(vector<pair<size_t, size_t>>& increments, vector<gcsa::CounterArray*>& counters,
+                          std::mutex* locks, pair<size_t, size_t> (Packer::*bin_offset)(size_t) const,
+                          void (Packer::*init_bin)(size_t));
+
     void ensure_edit_tmpfiles_open(void);
     void close_edit_tmpfiles(void);
     void remove_edit_tmpfiles(void);
@@ -2522,6 +2522,7 @@ void from_proto_mapping(const Mapping& proto_mapping, path_mapping_t& mapping) {
     position_copy->set_node_id(position.node_id());
     position_copy->set_offset(position.offset());
     position_copy->set_is_reverse(position.is_reverse());
+    mapping.mutable_edit()->reserve(mapping.edit_size() + proto_mapping.edit_size());
     for (const auto& edit : proto_mapping.edit()) {
         from_proto_edit(edit, *mapping.add_edit());
     }
@@ -2539,6 +2540,7 @@ void to_proto_mapping(const path_mapping_t& mapping, Mapping& proto_mapping) {
 }
 
 void from_proto_path(const Path& proto_path, path_t& path) {
+    path.mutable_mapping()->reserve(path.mapping_size() + proto_path.mapping_size());
     for (const auto& mapping : proto_path.mapping()) {
         from_proto_mapping(mapping, *path.add_mapping());
     }
@@ -2596,17 +2598,10 @@ void reverse_complement_mapping_in_place(path_mapping_t* m,
         edit_t* e1 = m->mutable_edit(i);
         edit_t* e2 = m->mutable_edit(j);
         
-        int64_t from_length_tmp = e1->from_length();
-        int64_t to_length_tmp = e1->to_length();
-        string sequence_tmp = e1->sequence();
-        
-        e1->set_from_length(e2->from_length());
-        e1->set_to_length(e2->to_length());
-        e1->set_sequence(reverse_complement(e2->sequence()));
-        
-        e2->set_from_length(from_length_tmp);
-        e2->set_to_length(to_length_tmp);
-        e2->set_sequence(reverse_complement(sequence_tmp));
+        // swap the edits without copying their sequences
+        std::swap(*e1, *e2);
+        reverse_complement_in_place(*e1->mutable_sequence());
+        reverse_complement_in_place(*e2->mutable_sequence());
     }
     
     
@@ -2620,6 +2615,7 @@ path_mapping_t reverse_complement_mapping(const path_mapping_t& m,
                                           const function<int64_t(id_t)>& node_length) {
     
     path_mapping_t reversed;
+    reversed.mutable_edit()->reserve(m.edit_size());
     position_t* rev_pos = reversed.mutable_position();
     rev_pos->set_node_id(m.position().node_id());
     rev_pos->set_is_reverse(!m.position().is_reverse());
@@ -2641,6 +2637,7 @@ path_t reverse_complement_path(const path_t& path,
     
     // Make a new reversed path
     path_t reversed;
+    reversed.mutable_mapping()->reserve(path.mapping_size());
     
     for (int64_t i = path.mapping_size() - 1; i >= 0; i--) {
         // For each mapping in reverse order, put it in reverse complemented and
@@ -387,6 +387,7 @@ public:
     inline void set_to_length(int32_t l);
     inline const string& sequence() const;
     inline void set_sequence(const string& s);
+    inline void set_sequence(string&& s);
     inline string* mutable_sequence();
     inline bool operator==(const edit_t& other) const;
     inline bool operator!=(const edit_t& other) const;
@@ -505,6 +506,9 @@ inline const string& edit_t::sequence() const {
 inline void edit_t::set_sequence(const string& s) {
     _sequence = s;
 }
+inline void edit_t::set_sequence(string&& s) {
+    _sequence = std::move(s);
+}
 inline string* edit_t::mutable_sequence() {
     return &_sequence;
 }
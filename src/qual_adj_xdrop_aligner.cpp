@@ -37,6 +37,9 @@ QualAdjXdropAligner& QualAdjXdropAligner::operator=(const QualAdjXdropAligner& o
             dz_destroy(dz);
         }
         
+        // We get our own dozeu memory, without the other aligner's query
+        query_cache = QueryCache();
+        
         // TODO: a bit of an arcane step
         // we need to pull out the 0-padded quality adjusted matrices from dz into a contiguous array
         int8_t* qual_adj_matrix = (int8_t*) malloc(DZ_QUAL_MATRIX_SIZE * sizeof(int8_t));
@@ -68,6 +71,10 @@ QualAdjXdropAligner& QualAdjXdropAligner::operator=(QualAdjXdropAligner&& other)
         }
         dz = other.dz;
         other.dz = nullptr;
+        // The cached query may point into the strings, which don't
+        // necessarily keep their buffers when moved
+        query_cache = QueryCache();
+        other.query_cache = QueryCache();
     }
 
 	return *this;
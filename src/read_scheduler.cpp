@@ -0,0 +1,287 @@
+/**
+ * \file read_scheduler.cpp
+ * Implements a work-stealing scheduler for handing batches of reads to mapping threads.
+ */
+
+#include "read_scheduler.hpp"
+
+#include <vg/io/protobuf_iterator.hpp>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace vg {
+
+using namespace std;
+
+ReadBatchScheduler::ReadBatchScheduler(size_t thread_count, size_t batch_size, size_t max_batches_per_thread) :
+    thread_count(max<size_t>(thread_count, 1)), batch_size(max<size_t>(batch_size, 1)),
+    max_batches_in_flight(max<size_t>(thread_count, 1) * max<size_t>(max_batches_per_thread, 1)),
+    batch_seconds_by_thread(max<size_t>(thread_count, 1)), stolen_by_thread(max<size_t>(thread_count, 1), 0) {
+
+    // Nothing to do!
+}
+
+template<typename Item>
+size_t ReadBatchScheduler::run(const function<bool(Item&)>& get_item, const function<void(Item&)>& process,
+                               const function<bool(void)>& single_threaded_until_true) {
+
+    size_t single_threaded_count = 0;
+
+    // Until we are allowed to go parallel, do one item at a time on this thread.
+    while (!single_threaded_until_true()) {
+        Item item;
+        if (!get_item(item)) {
+            // We ran out of input before we could go parallel.
+            return single_threaded_count;
+        }
+        process(item);
+        single_threaded_count++;
+    }
+
+    typedef vector<Item> Batch;
+
+    // Each thread owns a deque of batches, with its own lock.
+    struct BatchDeque {
+        mutex lock;
+        deque<unique_ptr<Batch>> batches;
+    };
+    vector<BatchDeque> deques(thread_count);
+
+    // Only one thread at a time may read input.
+    mutex input_lock;
+    atomic<bool> input_done(false);
+    // Batches that have been read but not finished.
+    atomic<size_t> in_flight(0);
+    atomic<size_t> parallel_count(0);
+
+    // Idle threads sleep until something they could be waiting for happens:
+    // a batch is queued or finished, or the input runs out. The counter only
+    // changes under the lock, so a thread that saw it before looking for work
+    // can't miss the event that would give it some.
+    mutex idle_lock;
+    condition_variable idle_wakeup;
+    atomic<size_t> events(0);
+    auto signal_idle = [&](bool wake_all) {
+        {
+            lock_guard<mutex> idle_guard(idle_lock);
+            events++;
+        }
+        if (wake_all) {
+            idle_wakeup.notify_all();
+        } else {
+            idle_wakeup.notify_one();
+        }
+    };
+
+    // Try to read a batch into the given thread's deque. Returns false if
+    // another thread is reading, too many batches are in flight, or the
+    // input is exhausted.
+    auto try_read = [&](size_t thread_num) {
+        unique_lock<mutex> input_guard(input_lock, try_to_lock);
+        if (!input_guard.owns_lock() || input_done.load() || in_flight.load() >= max_batches_in_flight) {
+            return false;
+        }
+
+        unique_ptr<Batch> batch(new Batch());
+        batch->reserve(batch_size);
+        bool exhausted = false;
+        while (batch->size() < batch_size) {
+            batch->emplace_back();
+            if (!get_item(batch->back())) {
+                batch->pop_back();
+                exhausted = true;
+                break;
+            }
+        }
+
+        bool read_any = !batch->empty();
+        if (read_any) {
+            // Count the batch as in flight before anyone can see that the
+            // input is done, so nobody leaves while it is still queued.
+            in_flight++;
+            parallel_count += batch->size();
+            lock_guard<mutex> deque_guard(deques[thread_num].lock);
+            deques[thread_num].batches.emplace_back(std::move(batch));
+        }
+        if (exhausted) {
+            input_done.store(true);
+            // Everyone waiting for the end needs to hear about it.
+            signal_idle(true);
+        } else if (read_any) {
+            // Someone can steal the new batch.
+            signal_idle(false);
+        }
+        return read_any;
+    };
+
+    // Try to get a batch to work on, from the front of our own deque or else
+    // from the back of someone else's.
+    auto try_take = [&](size_t thread_num, unique_ptr<Batch>& batch) {
+        {
+            BatchDeque& own = deques[thread_num];
+            lock_guard<mutex> deque_guard(own.lock);
+            if (!own.batches.empty()) {
+                batch = std::move(own.batches.front());
+                own.batches.pop_front();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < thread_count; i++) {
+            BatchDeque& victim = deques[(thread_num + i) % thread_count];
+            lock_guard<mutex> deque_guard(victim.lock);
+            if (!victim.batches.empty()) {
+                batch = std::move(victim.batches.back());
+                victim.batches.pop_back();
+                stolen_by_thread[thread_num]++;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    #pragma omp parallel num_threads(thread_count)
+    {
+        size_t thread_num = omp_get_thread_num();
+        assert(thread_num < thread_count);
+        unique_ptr<Batch> batch;
+
+        while (true) {
+            size_t seen_events = events.load();
+
+            if (in_flight.load() < thread_count) {
+                // Keep enough work around that nobody goes idle.
+                try_read(thread_num);
+            }
+
+            if (try_take(thread_num, batch)) {
+                auto start = chrono::steady_clock::now();
+                for (Item& item : *batch) {
+                    process(item);
+                }
+                chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+                batch_seconds_by_thread[thread_num].push_back(elapsed.count());
+                batch.reset();
+                in_flight--;
+                // There is room to read another batch, or we may have been the
+                // last one anyone was waiting for.
+                signal_idle(true);
+            } else if (!try_read(thread_num)) {
+                if (input_done.load() && in_flight.load() == 0) {
+                    // Nothing left to read and nothing left to do.
+                    break;
+                }
+                // Someone else is reading or finishing the last batches, so
+                // sleep instead of competing with them for the CPU.
+                unique_lock<mutex> idle_guard(idle_lock);
+                idle_wakeup.wait(idle_guard, [&]() { return events.load() != seen_events; });
+            }
+        }
+    }
+
+    return single_threaded_count + parallel_count.load();
+}
+
+size_t ReadBatchScheduler::for_each_parallel(const function<bool(Alignment&)>& get_read,
+                                             const function<void(Alignment&)>& lambda) {
+    return run<Alignment>(get_read, lambda, []() { return true; });
+}
+
+size_t ReadBatchScheduler::for_each_pair_parallel_after_wait(const function<bool(Alignment&, Alignment&)>& get_pair,
+                                                             const function<void(Alignment&, Alignment&)>& lambda,
+                                                             const function<bool(void)>& single_threaded_until_true) {
+    function<bool(pair<Alignment, Alignment>&)> get_item = [&](pair<Alignment, Alignment>& item) {
+        return get_pair(item.first, item.second);
+    };
+    function<void(pair<Alignment, Alignment>&)> process = [&](pair<Alignment, Alignment>& item) {
+        lambda(item.first, item.second);
+    };
+    return run<pair<Alignment, Alignment>>(get_item, process, single_threaded_until_true);
+}
+
+size_t ReadBatchScheduler::for_each_parallel(istream& in, const function<void(Alignment&)>& lambda) {
+    vg::io::ProtobufIterator<Alignment> cursor(in);
+    function<bool(Alignment&)> get_read = [&](Alignment& aln) {
+        if (!cursor.has_current()) {
+            return false;
+        }
+        aln = *cursor;
+        cursor.advance();
+        return true;
+    };
+    return for_each_parallel(get_read, lambda);
+}
+
+size_t ReadBatchScheduler::for_each_interleaved_pair_parallel_after_wait(istream& in,
+                                                                         const function<void(Alignment&, Alignment&)>& lambda,
+                                                                         const function<bool(void)>& single_threaded_until_true) {
+    vg::io::ProtobufIterator<Alignment> cursor(in);
+    function<bool(Alignment&, Alignment&)> get_pair = [&](Alignment& mate1, Alignment& mate2) {
+        if (!cursor.has_current()) {
+            return false;
+        }
+        mate1 = *cursor;
+        cursor.advance();
+        if (!cursor.has_current()) {
+            cerr << "error[vg::ReadBatchScheduler]: Interleaved input ended with an unpaired read " << mate1.name() << endl;
+            exit(1);
+        }
+        mate2 = *cursor;
+        cursor.advance();
+        return true;
+    };
+    return for_each_pair_parallel_after_wait(get_pair, lambda, single_threaded_until_true);
+}
+
+size_t ReadBatchScheduler::batch_count() const {
+    size_t total = 0;
+    for (auto& batch_seconds : batch_seconds_by_thread) {
+        total += batch_seconds.size();
+    }
+    return total;
+}
+
+size_t ReadBatchScheduler::stolen_count() const {
+    size_t total = 0;
+    for (auto& stolen : stolen_by_thread) {
+        total += stolen;
+    }
+    return total;
+}
+
+double ReadBatchScheduler::batch_seconds_quantile(double quantile) const {
+    vector<double> all_seconds;
+    all_seconds.reserve(batch_count());
+    for (auto& batch_seconds : batch_seconds_by_thread) {
+        all_seconds.insert(all_seconds.end(), batch_seconds.begin(), batch_seconds.end());
+    }
+    if (all_seconds.empty()) {
+        return 0.0;
+    }
+
+    // Use the nearest-rank quantile.
+    quantile = min(max(quantile, 0.0), 1.0);
+    size_t rank = (size_t) ceil(quantile * all_seconds.size());
+    size_t index = rank == 0 ? 0 : rank - 1;
+    nth_element(all_seconds.begin(), all_seconds.begin() + index, all_seconds.end());
+    return all_seconds[index];
+}
+
+void ReadBatchScheduler::report(ostream& out) const {
+    out << "Processed " << batch_count() << " batches of up to " << batch_size << " reads; "
+        << stolen_count() << " batches were stolen. Batch time: median "
+        << batch_seconds_quantile(0.5) << " s, 99th percentile "
+        << batch_seconds_quantile(0.99) << " s, max "
+        << batch_seconds_quantile(1.0) << " s" << endl;
+}
+
+}
@@ -0,0 +1,110 @@
+#ifndef VG_READ_SCHEDULER_HPP_INCLUDED
+#define VG_READ_SCHEDULER_HPP_INCLUDED
+
+/**
+ * \file read_scheduler.hpp
+ * Defines a work-stealing scheduler for handing batches of reads to mapping threads.
+ */
+
+#include <vg/vg.pb.h>
+
+#include <functional>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+namespace vg {
+
+using namespace std;
+
+/**
+ * Hands batches of reads out to a team of OpenMP threads.
+ *
+ * Each thread has its own deque of batches. A thread works from the front of
+ * its own deque and, when that runs dry, steals from the back of another
+ * thread's deque. Any idle thread may take a turn reading more input, but only
+ * while fewer than a bounded number of batches are in flight, so memory use
+ * stays bounded and a batch full of pathological reads holds up only the
+ * thread working on it, not the end of the run.
+ *
+ * The scheduler records how long each batch took to process, so the tail
+ * latency of batches can be reported.
+ */
+class ReadBatchScheduler {
+public:
+
+    /**
+     * Make a scheduler for the given number of threads, which will read
+     * batch_size reads (or pairs) at a time and have at most
+     * max_batches_per_thread batches per thread read but not yet finished.
+     */
+    ReadBatchScheduler(size_t thread_count, size_t batch_size = 256, size_t max_batches_per_thread = 4);
+
+    /**
+     * Call lambda on each read produced by get_read, in parallel, until
+     * get_read returns false. get_read is only ever called by one thread at a
+     * time. Returns the number of reads processed.
+     */
+    size_t for_each_parallel(const function<bool(Alignment&)>& get_read,
+                             const function<void(Alignment&)>& lambda);
+
+    /**
+     * Call lambda on each pair produced by get_pair until get_pair returns
+     * false. Pairs are processed one at a time on the calling thread until
+     * single_threaded_until_true returns true, and in parallel after that.
+     * Returns the number of pairs processed.
+     */
+    size_t for_each_pair_parallel_after_wait(const function<bool(Alignment&, Alignment&)>& get_pair,
+                                             const function<void(Alignment&, Alignment&)>& lambda,
+                                             const function<bool(void)>& single_threaded_until_true);
+
+    /**
+     * Call lambda on each read in the given GAM stream, in parallel.
+     */
+    size_t for_each_parallel(istream& in, const function<void(Alignment&)>& lambda);
+
+    /**
+     * Call lambda on each pair of consecutive reads in the given GAM stream.
+     * Pairs are processed one at a time until single_threaded_until_true
+     * returns true, and in parallel after that.
+     */
+    size_t for_each_interleaved_pair_parallel_after_wait(istream& in,
+                                                         const function<void(Alignment&, Alignment&)>& lambda,
+                                                         const function<bool(void)>& single_threaded_until_true);
+
+    /// Get the number of batches processed in parallel so far.
+    size_t batch_count() const;
+
+    /// Get the number of batches that were stolen from another thread's deque.
+    size_t stolen_count() const;
+
+    /// Get the given quantile (between 0 and 1) of the time taken to process
+    /// a batch, in seconds. Returns 0 if no batches have been processed.
+    double batch_seconds_quantile(double quantile) const;
+
+    /// Write a one-line summary of batch processing latency to the given stream.
+    void report(ostream& out) const;
+
+protected:
+
+    /// Drive all the threads through the items produced by get_item.
+    template<typename Item>
+    size_t run(const function<bool(Item&)>& get_item, const function<void(Item&)>& process,
+               const function<bool(void)>& single_threaded_until_true);
+
+    /// How many threads do we run?
+    size_t thread_count;
+    /// How many items go in a batch?
+    size_t batch_size;
+    /// How many batches may be read but not finished at once?
+    size_t max_batches_in_flight;
+
+    /// Seconds taken to process each batch, by the thread that processed it.
+    vector<vector<double>> batch_seconds_by_thread;
+    /// Number of batches each thread stole from another thread.
+    vector<size_t> stolen_by_thread;
+};
+
+}
+
+#endif
@@ -1,6 +1,9 @@
 #include "seed_clusterer.hpp"
 
 #include <algorithm>
+#include <functional>
+
+#include <omp.h>
 
 //#define DEBUG_CLUSTER
 namespace vg {
@@ -9,6 +12,25 @@ namespace vg {
                                             dist_index(dist_index){
     };
 
+    /// Call iteratee on each number from 0 to count. If parallel is set and
+    /// we are in a parallel region, each call is an OpenMP task, so idle
+    /// threads in the current team can help out. Outside a parallel region,
+    /// starting a new team for each level of the snarl tree would cost more
+    /// than it saves, so the calls are made in order on this thread.
+    /// Returns once all the calls are done.
+    static void for_each_task(size_t count, bool parallel, const function<void(size_t)>& iteratee) {
+        if (!parallel || count < 2 || !omp_in_parallel()) {
+            for (size_t i = 0 ; i < count ; i++) {
+                iteratee(i);
+            }
+        } else {
+            #pragma omp taskloop grainsize(1)
+            for (size_t i = 0 ; i < count ; i++) {
+                iteratee(i);
+            }
+        }
+    }
+
     vector<SnarlSeedClusterer::Cluster> SnarlSeedClusterer::cluster_seeds (const vector<Seed>& seeds, int64_t read_distance_limit) const {
         //Wrapper for single ended
 
@@ -119,6 +141,7 @@ cerr << endl << endl << endl << endl << "New cluster calculation:" << endl;
         size_t seed_count = 0;
         for (auto v : all_seeds) seed_count+= v->size();
         TreeState tree_state (&all_seeds, read_distance_limit, fragment_distance_limit, seed_count);
+        tree_state.cluster_in_parallel = parallel_seed_threshold != 0 && seed_count >= parallel_seed_threshold;
 
 
         //Populate tree_state.node_to_seeds (mapping each node to the seeds it
@@ -349,13 +372,23 @@ cerr << "Nested positions: " << endl << "\t";
 
     void SnarlSeedClusterer::cluster_snarl_level(TreeState& tree_state, size_t depth) const {
 
-        for (auto& kv : tree_state.snarl_to_nodes){
-            //Go through each of the snarls at this level, cluster them,
+        //Cluster each of the snarls at this level. They don't share any
+        //seeds, so they can be clustered at the same time
+        vector<size_t> snarls;
+        snarls.reserve(tree_state.snarl_to_nodes.size());
+        for (auto& kv : tree_state.snarl_to_nodes) {
+            snarls.push_back(kv.first);
+        }
+        vector<NodeClusters> snarl_clusters (snarls.size(), NodeClusters(tree_state.all_seeds->size()));
+        for_each_task(snarls.size(), tree_state.cluster_in_parallel, [&](size_t i) {
+            snarl_clusters[i] = cluster_one_snarl(tree_state, snarls[i]);
+        });
+
+        for (size_t i = 0 ; i < snarls.size() ; i++) {
+            //Go through each of the snarls at this level
             //and find which chains they belong to, if any
-            //key is the index of the snarl and value is a vector of pair of
-            // NetgraphNode, NodeClusters
 
-            size_t snarl_i = kv.first;
+            size_t snarl_i = snarls[i];
             MinimumDistanceIndex::SnarlIndex& snarl_index =
                                      dist_index.snarl_indexes[snarl_i];
 
@@ -376,7 +409,7 @@ cerr << "Nested positions: " << endl << "\t";
                 size_t chain_rank = dist_index.get_chain_rank(snarl_index.id_in_parent);
 
                 tree_state.chain_to_snarls[chain_assignment].emplace(
-                        chain_rank, make_pair(snarl_i, cluster_one_snarl(tree_state, snarl_i)));
+                        chain_rank, make_pair(snarl_i, std::move(snarl_clusters[i])));
 
 #ifdef DEBUG_CLUSTER
                 cerr << "Recording snarl number " << snarl_i << " headed by "
@@ -397,7 +430,7 @@ cerr << "Nested positions: " << endl << "\t";
                     size_t parent_snarl_i = dist_index.get_primary_assignment( snarl_index.parent_id);
 
                     tree_state.parent_snarl_to_nodes[parent_snarl_i].emplace_back(
-                            NetgraphNode (snarl_i, SNARL), cluster_one_snarl(tree_state, snarl_i));
+                            NetgraphNode (snarl_i, SNARL), std::move(snarl_clusters[i]));
 
 #ifdef DEBUG_CLUSTER
                     cerr << "Recording snarl number " << snarl_i
@@ -408,44 +441,48 @@ cerr << "Nested positions: " << endl << "\t";
                         << tree_state.parent_snarl_to_nodes[parent_snarl_i].size()
                         << " children now" << endl;
 #endif
-                } else {
-                    //If it doesn't have a parent, don't need to keep track of
-                    //its contents
-
-                    NodeClusters top_snarl_clusters = cluster_one_snarl(tree_state, snarl_i);
                 }
+                //If it doesn't have a parent, don't need to keep track of
+                //its contents
             }
         }
     }
 
     void SnarlSeedClusterer::cluster_chain_level(TreeState& tree_state, size_t depth) const {
         vector<bool>  seen_components( tree_state.top_level_seed_clusters.size(), false);
-        for (auto& kv : tree_state.chain_to_snarls) {
-            //For each chain at this level that has relevant child snarls in it,
-            //find the clusters.
-
-
-            // Get the chain's number
-            size_t chain_i = kv.first;
 
+        //For each chain at this level that has relevant child snarls in it,
+        //find the clusters. Chains don't share any seeds, so they can be
+        //clustered at the same time
+        vector<size_t> chains;
+        chains.reserve(tree_state.chain_to_snarls.size());
+        for (auto& kv : tree_state.chain_to_snarls) {
+            chains.push_back(kv.first);
 #ifdef DEBUG_CLUSTER
-            cerr << "At depth " << depth << " chain number " << chain_i
+            cerr << "At depth " << depth << " chain number " << kv.first
                  << " with children " << endl;
             for (auto it2 : kv.second) {
                 cerr << "\t snarl number " << it2.second.first << endl;
             }
 #endif
+        }
+        vector<NodeClusters> all_chain_clusters (chains.size(), NodeClusters(tree_state.all_seeds->size()));
+        for_each_task(chains.size(), tree_state.cluster_in_parallel, [&](size_t i) {
+            all_chain_clusters[i] = cluster_one_chain(tree_state, chains[i], depth);
+        });
+
+        for (size_t i = 0 ; i < chains.size() ; i++) {
+
+            // Get the chain's number
+            size_t chain_i = chains[i];
 
             //Mark this component as being seen
             size_t component = dist_index.get_connected_component(dist_index.chain_indexes[chain_i].id_in_parent);
             if (tree_state.component_to_index.count(component) != 0) {
                 seen_components[tree_state.component_to_index[component]] = true;
             }
-            // Compute the clusters for the chain
-            if (depth == 0) {
-                cluster_one_chain(tree_state, chain_i, depth);
-            } else {
-                NodeClusters chain_clusters = cluster_one_chain(tree_state, chain_i, depth);
+            if (depth != 0) {
+                NodeClusters& chain_clusters = all_chain_clusters[i];
 
                 // We actually have a parent
 
@@ -821,7 +858,8 @@ cerr << "Nested positions: " << endl << "\t";
 
 
         //Get the children of this snarl and their clusters
-        vector<pair<NetgraphNode, NodeClusters>>& child_nodes = tree_state.snarl_to_nodes[snarl_index_i];
+        //Look this up without inserting, since other snarls may be clustered at the same time
+        vector<pair<NetgraphNode, NodeClusters>>& child_nodes = tree_state.snarl_to_nodes.find(snarl_index_i)->second;
         int64_t start_length = snarl_index.node_length(0);
         int64_t end_length = snarl_index.node_length(snarl_index.num_nodes*2 -1);
 
@@ -1123,7 +1161,12 @@ cerr << "\t distances between ranks " << node_rank << " and " << other_rank
 
         //Maps each snarl to its clusters, in the order of the snarls in the chain
         //TODO: I think this doesn't need to be a map anymore since we're sorting later anyway, depending on the sort algorithm
-        hash_map<size_t, pair<size_t, NodeClusters>>& snarls_in_chain =tree_state.chain_to_snarls[chain_i];
+        //Look this up without inserting, since other chains may be clustered
+        //at the same time. A top-level chain with no nested seeds has no
+        //entry yet, but those are only ever clustered one at a time.
+        auto found_chain = tree_state.chain_to_snarls.find(chain_i);
+        hash_map<size_t, pair<size_t, NodeClusters>>& snarls_in_chain = found_chain != tree_state.chain_to_snarls.end() ?
+            found_chain->second : tree_state.chain_to_snarls[chain_i];
 
         size_t connected_component_num = dist_index.get_connected_component(chain_index.id_in_parent);
         int64_t chain_length = depth == 0 ? dist_index.top_level_chain_length(chain_index.id_in_parent)
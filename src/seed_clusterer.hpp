@@ -67,6 +67,13 @@ class SnarlSeedClusterer {
         vector<vector<Cluster>> cluster_seeds ( 
                 const vector<vector<Seed>>& all_seeds, int64_t read_distance_limit, int64_t fragment_distance_limit=0) const;
 
+        ///If there are at least this many seeds (in all reads together), and
+        ///the clusterer is called from within an OpenMP parallel region, the
+        ///independent snarls and chains at each depth of the snarl tree are
+        ///clustered in parallel as OpenMP tasks. 0 means always cluster on
+        ///one thread.
+        size_t parallel_seed_threshold = 0;
+
     private:
 
 
@@ -185,6 +192,10 @@ class SnarlSeedClusterer {
             int64_t read_distance_limit;
             int64_t fragment_distance_limit;
 
+            //Should the snarls and chains at each level be clustered in
+            //parallel?
+            bool cluster_in_parallel = false;
+
 
             //////////Data structures to hold clustering information
 
@@ -20,6 +20,10 @@
 #include <vector>
 #include <unordered_map>
 #include <tuple>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -70,9 +74,21 @@ public:
     // Supporting API
     //////////////////
 
-    /// Sort a vector of messages, in place.
+    /// Set the approximate number of bytes of serialized messages to hold in
+    /// memory during the streaming sort. It is split between the threads
+    /// sorting chunks, and between the input files being merged.
+    void set_memory_budget(size_t bytes);
+
+    /// Sort a vector of messages, in place. Each message's sort key is
+    /// extracted once, and the keys are sorted before the messages are moved.
     void sort(vector<Message>& msgs) const;
 
+    /// A fixed-width key that orders messages the same way less_than() does.
+    using sort_key_t = pair<uint64_t, uint64_t>;
+
+    /// Get the sort key for a message, by finding its minimum Position.
+    sort_key_t get_sort_key(const Message& msg) const;
+
     /// Return true if out of Messages a and b, a must come before b, and false otherwise.
     bool less_than(const Message& a, const Message& b) const;
     
@@ -90,10 +106,16 @@ public:
     
   private:
     /// What's the maximum size of messages in serialized, uncompressed bytes to
-    /// load into memory for a single temp file chunk, during the streaming
-    /// sort?
+    /// have in memory at once during the streaming sort? Each sorting thread
+    /// gets an equal share for its temp file chunk.
     /// For reference, a whole-genome GAM file is about 500 GB of uncompressed data
-    size_t max_buf_size = (512 * 1024 * 1024);
+    size_t memory_budget = (2048LL * 1024 * 1024);
+    /// What's the smallest batch of messages we read ahead from one file while merging?
+    size_t min_merge_batch_size = (64 * 1024);
+    /// How many batches of merged messages may wait for the writer thread?
+    size_t max_queued_write_batches = 4;
+    /// How many merged messages go to the writer thread at a time?
+    size_t write_batch_messages = 1024;
     /// What's the max fan-in when combining temp files, during the streaming sort?
     /// This will be computed based on the max file descriptor limit from the OS.
     size_t max_fan_in;
@@ -101,12 +123,19 @@ public:
     using cursor_t = vg::io::ProtobufIterator<Message>;
     using emitter_t = vg::io::ProtobufEmitter<Message>;
     
+    /// Take messages from the given cursor until it runs out or until at
+    /// least max_bytes of serialized messages have been taken.
+    vector<Message> take_batch(cursor_t& cursor, size_t max_bytes) const;
+
     /// Open all the given input files, keeping the streams and cursors in the given lists.
     /// We use lists because none of these should be allowed to move after creation.
     void open_all(const vector<string>& filenames, list<ifstream>& streams, list<cursor_t>& cursors);
     
     /// Merge all the messages from the given list of cursors into the given emitter.
     /// The total expected number of messages can be passed for progress bar purposes.
+    /// Messages are decoded ahead in batches by a pool of threads, and encoded
+    /// into the emitter by another thread, so only comparisons happen on the
+    /// calling thread.
     void streaming_merge(list<cursor_t>& cursors, emitter_t& emitter, size_t expected_messages = 0);
     
     /// Merge all the given temp input files into one or more temp output
@@ -171,11 +200,38 @@ StreamSorter<Message>::StreamSorter(bool show_progress) {
     }
 }
 
+template<typename Message>
+void StreamSorter<Message>::set_memory_budget(size_t bytes) {
+    memory_budget = bytes;
+}
+
 template<typename Message>
 void StreamSorter<Message>::sort(vector<Message>& msgs) const {
-    std::sort(msgs.begin(), msgs.end(), [&](const Message& a, const Message& b) {
-        return this->less_than(a, b);
-    });
+    // Scan each message for its min position only once, and sort the keys
+    // with the original index as a tiebreaker.
+    vector<pair<sort_key_t, size_t>> keyed(msgs.size());
+    #pragma omp parallel for
+    for (size_t i = 0; i < msgs.size(); i++) {
+        keyed[i] = make_pair(get_sort_key(msgs[i]), i);
+    }
+    std::sort(keyed.begin(), keyed.end());
+    
+    // Then put the messages in that order.
+    vector<Message> sorted;
+    sorted.reserve(msgs.size());
+    for (auto& key_and_index : keyed) {
+        sorted.emplace_back(std::move(msgs[key_and_index.second]));
+    }
+    msgs = std::move(sorted);
+}
+
+template<typename Message>
+typename StreamSorter<Message>::sort_key_t StreamSorter<Message>::get_sort_key(const Message& msg) const {
+    Position min_pos = get_min_position(msg);
+    // Flip the sign bit so signed node IDs order correctly as unsigned, and
+    // put the strand above the offset.
+    return make_pair((uint64_t) min_pos.node_id() ^ ((uint64_t) 1 << 63),
+                     ((uint64_t) min_pos.is_reverse() << 63) | (uint64_t) min_pos.offset());
 }
 
 template<typename Message>
@@ -257,6 +313,9 @@ void StreamSorter<Message>::stream_sort(istream& stream_in, ostream& stream_out,
     // This cursor will read in the input file.
     cursor_t input_cursor(stream_in);
     
+    // Each thread sorts its own chunk, so they have to share the memory.
+    size_t max_buf_size = max<size_t>(memory_budget / get_thread_count(), 1);
+    
     #pragma omp parallel shared(stream_in, input_cursor, outstanding_temp_files, messages_per_file, total_messages_read)
     {
     
@@ -376,54 +435,223 @@ void StreamSorter<Message>::open_all(const vector<string>& filenames, list<ifstr
 
 }
 
+template<typename Message>
+vector<Message> StreamSorter<Message>::take_batch(cursor_t& cursor, size_t max_bytes) const {
+    vector<Message> batch;
+    size_t batch_bytes = 0;
+    while (cursor.has_current() && batch_bytes < max_bytes) {
+        batch.emplace_back(std::move(cursor.take()));
+        batch_bytes += batch.back().ByteSize();
+    }
+    return batch;
+}
+
 template<typename Message>
 void StreamSorter<Message>::streaming_merge(list<cursor_t>& cursors, emitter_t& emitter, size_t expected_messages) {
 
     create_progress("merge " + to_string(cursors.size()) + " files", expected_messages == 0 ? 1 : expected_messages);
     // Count the messages we actually see
     size_t observed_messages = 0;
+    
+    // Each file gets a batch being merged and a batch being read ahead, and
+    // they all share the memory budget.
+    size_t batch_bytes = max(min_merge_batch_size, memory_budget / (2 * max<size_t>(cursors.size(), 1)));
+    
+    /// The state of one file being merged
+    struct MergeSource {
+        cursor_t* cursor;
+        /// Messages being merged, their sort keys, and the next one to merge
+        vector<Message> current;
+        vector<sort_key_t> current_keys;
+        size_t next = 0;
+        /// The batch after current, once it has been read
+        vector<Message> prefetched;
+        vector<sort_key_t> prefetched_keys;
+        /// Is a batch queued or being read?
+        bool prefetch_queued = false;
+        /// Is the read batch in prefetched?
+        bool prefetch_ready = false;
+        /// Has the cursor run out?
+        bool exhausted = false;
+    };
+    vector<MergeSource> sources;
+    sources.reserve(cursors.size());
+    for (auto& cursor : cursors) {
+        sources.emplace_back();
+        sources.back().cursor = &cursor;
+    }
+    
+    // Decoder threads take the numbers of sources to read ahead from here.
+    mutex source_lock;
+    condition_variable source_wanted;
+    condition_variable source_ready;
+    deque<size_t> prefetch_queue;
+    bool merge_finished = false;
+    
+    // Queue up a read of the batch after the current one. Caller must hold source_lock.
+    auto queue_prefetch = [&](size_t i) {
+        sources[i].prefetch_queued = true;
+        prefetch_queue.push_back(i);
+        source_wanted.notify_one();
+    };
+    
+    vector<thread> decoders;
+    size_t decoder_count = max(1, get_thread_count() - 2);
+    for (size_t t = 0; t < decoder_count; t++) {
+        decoders.emplace_back([&]() {
+            unique_lock<mutex> lock(source_lock);
+            while (true) {
+                source_wanted.wait(lock, [&]() { return merge_finished || !prefetch_queue.empty(); });
+                if (prefetch_queue.empty()) {
+                    return;
+                }
+                size_t i = prefetch_queue.front();
+                prefetch_queue.pop_front();
+                
+                // Nobody else touches this source's cursor until we say the batch is ready.
+                lock.unlock();
+                vector<Message> batch = take_batch(*sources[i].cursor, batch_bytes);
+                bool exhausted = !sources[i].cursor->has_current();
+                // Work out the keys here so the merge only compares integers.
+                vector<sort_key_t> keys;
+                keys.reserve(batch.size());
+                for (auto& msg : batch) {
+                    keys.push_back(get_sort_key(msg));
+                }
+                lock.lock();
+                
+                sources[i].prefetched = std::move(batch);
+                sources[i].prefetched_keys = std::move(keys);
+                sources[i].exhausted = exhausted;
+                sources[i].prefetch_ready = true;
+                source_ready.notify_all();
+            }
+        });
+    }
+    
+    // Move a source on to its next batch, waiting for it to be read if
+    // necessary. Returns false if the source has run out.
+    auto next_batch = [&](size_t i) {
+        MergeSource& source = sources[i];
+        unique_lock<mutex> lock(source_lock);
+        source_ready.wait(lock, [&]() { return source.prefetch_ready || !source.prefetch_queued; });
+        if (!source.prefetch_ready) {
+            return false;
+        }
+        source.current = std::move(source.prefetched);
+        source.current_keys = std::move(source.prefetched_keys);
+        source.prefetched.clear();
+        source.prefetched_keys.clear();
+        source.next = 0;
+        source.prefetch_ready = false;
+        source.prefetch_queued = false;
+        if (!source.exhausted) {
+            queue_prefetch(i);
+        }
+        return !source.current.empty();
+    };
+    
+    // The writer thread encodes merged messages into the emitter.
+    mutex write_lock;
+    condition_variable write_changed;
+    deque<vector<Message>> write_queue;
+    bool writes_finished = false;
+    thread writer([&]() {
+        unique_lock<mutex> lock(write_lock);
+        while (true) {
+            write_changed.wait(lock, [&]() { return writes_finished || !write_queue.empty(); });
+            if (write_queue.empty()) {
+                return;
+            }
+            vector<Message> batch = std::move(write_queue.front());
+            write_queue.pop_front();
+            write_changed.notify_all();
+            
+            lock.unlock();
+            for (auto& msg : batch) {
+                emitter.write(std::move(msg));
+            }
+            lock.lock();
+        }
+    });
+    
+    // Hand a batch of merged messages to the writer, waiting if it is too far behind.
+    auto send_to_writer = [&](vector<Message>& batch) {
+        unique_lock<mutex> lock(write_lock);
+        write_changed.wait(lock, [&]() { return write_queue.size() < max_queued_write_batches; });
+        write_queue.emplace_back(std::move(batch));
+        batch.clear();
+        write_changed.notify_all();
+    };
 
     // Put all the files in a priority queue based on which has a message that comes first.
-    // We work with pointers to cursors because we don't want to be copying the actual cursors around the heap.
+    // We work with source numbers because we don't want to be copying the sources around the heap.
     // We also *reverse* the order, because priority queues put the "greatest" element first
-    auto cursor_order = [&](cursor_t*& a, cursor_t*& b) {
-        if (b->has_current()) {
-            if(!a->has_current()) {
-                // Cursors that aren't empty come first
-                return true;
-            }
-            return less_than(*(*b), *(*a));
-        }
-        return false;
+    auto source_order = [&](size_t a, size_t b) {
+        return sources[b].current_keys[sources[b].next] < sources[a].current_keys[sources[a].next];
     };
-    priority_queue<cursor_t*, vector<cursor_t*>, decltype(cursor_order)> cursor_queue(cursor_order);
+    priority_queue<size_t, vector<size_t>, decltype(source_order)> source_queue(source_order);
 
-    for (auto& cursor : cursors) {
-        // Put the cursor pointers in the queue
-        cursor_queue.push(&cursor);
+    {
+        lock_guard<mutex> lock(source_lock);
+        for (size_t i = 0; i < sources.size(); i++) {
+            // Start reading every file
+            queue_prefetch(i);
+        }
+    }
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (next_batch(i)) {
+            // Put the files that have data in the queue
+            source_queue.push(i);
+        }
     }
     
-    while(!cursor_queue.empty() && cursor_queue.top()->has_current()) {
+    vector<Message> merged;
+    merged.reserve(write_batch_messages);
+    while (!source_queue.empty()) {
         // Until we have run out of data in all the temp files
         
-        // Pop off the winning cursor
-        cursor_t* winner = cursor_queue.top();
-        cursor_queue.pop();
+        // Pop off the winning file
+        size_t winner = source_queue.top();
+        source_queue.pop();
         
-        // Grab and emit its message, and advance it
-        emitter.write(std::move(winner->take()));
+        // Grab its message, and advance it
+        MergeSource& source = sources[winner];
+        merged.emplace_back(std::move(source.current[source.next]));
+        source.next++;
+        if (merged.size() >= write_batch_messages) {
+            send_to_writer(merged);
+        }
         
         // Put it back in the heap if it is not depleted
-        if (winner->has_current()) {
-            cursor_queue.push(winner);
+        if (source.next < source.current.size() || next_batch(winner)) {
+            source_queue.push(winner);
         }
-        // TODO: Maybe keep it off the heap for the next loop somehow if it still wins
         
         observed_messages++;
         if (expected_messages != 0) {
             update_progress(observed_messages);
         }
     }
+    if (!merged.empty()) {
+        send_to_writer(merged);
+    }
+    
+    // Let all the helper threads finish up.
+    {
+        lock_guard<mutex> lock(source_lock);
+        merge_finished = true;
+        source_wanted.notify_all();
+    }
+    for (auto& decoder : decoders) {
+        decoder.join();
+    }
+    {
+        lock_guard<mutex> lock(write_lock);
+        writes_finished = true;
+        write_changed.notify_all();
+    }
+    writer.join();
     
     // We finished the files, so say we're done.
     // TODO: Should we warn/fail if we expected the wrong number of messages?
@@ -446,7 +674,7 @@ vector<string> StreamSorter<Message>::streaming_merge(const vector<string>& temp
         // Open up cursors into all the files.
         list<ifstream> temp_ifstreams;
         list<cursor_t> temp_cursors;
-        open_all(vector<string>(&temp_files_out[start_file], &temp_files_out[start_file + file_count]), temp_ifstreams, temp_cursors);
+        open_all(vector<string>(temp_files_in.begin() + start_file, temp_files_in.begin() + start_file + file_count), temp_ifstreams, temp_cursors);
         
         // Work out how many messages to expect
         size_t expected_messages = 0;
@@ -472,7 +700,7 @@ vector<string> StreamSorter<Message>::streaming_merge(const vector<string>& temp
         // Clean up the input files we used
         temp_cursors.clear();
         temp_ifstreams.clear();
-        for (size_t i = start_file; i < file_count; i++) {
+        for (size_t i = start_file; i < start_file + file_count; i++) {
             temp_file::remove(temp_files_in.at(i));
         }
         
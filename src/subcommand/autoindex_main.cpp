@@ -110,6 +110,8 @@ void help_autoindex(char** argv) {
     << "    -a, --gff-tx-tag STR   GTF/GFF tag (in col. 9) for transcript ID (default: " << IndexingParameters::gff_transcript_tag << ")" << endl
     << "  logging and computation:" << endl
     << "    -T, --tmp-dir DIR      temporary directory to use for intermediate files" << endl
+    << "    --cache DIR            keep indexes in DIR, and reuse any that earlier runs made" << endl
+    << "                           from the same inputs and parameters" << endl
     << "    -M, --target-mem MEM   target max memory usage (not exact, formatted INT[kMG])" << endl
     << "                           (default: 1/2 of available)" << endl
     << "    -t, --threads NUM      number of threads (default: all available)" << endl
@@ -128,6 +130,7 @@ int main_autoindex(int argc, char** argv) {
 #define OPT_KEEP_INTERMEDIATE 1000
 #define OPT_FORCE_UNPHASED 1001
 #define OPT_FORCE_PHASED 1002
+#define OPT_CACHE 1003
     
     // load the registry
     IndexRegistry registry = VGIndexes::get_vg_index_registry();
@@ -163,6 +166,7 @@ int main_autoindex(int argc, char** argv) {
             {"keep-intermediate", no_argument, 0, OPT_KEEP_INTERMEDIATE},
             {"force-unphased", no_argument, 0, OPT_FORCE_UNPHASED},
             {"force-phased", no_argument, 0, OPT_FORCE_PHASED},
+            {"cache", required_argument, 0, OPT_CACHE},
             {0, 0, 0, 0}
         };
 
@@ -261,6 +265,9 @@ int main_autoindex(int argc, char** argv) {
             case OPT_FORCE_PHASED:
                 force_phased = true;
                 break;
+            case OPT_CACHE:
+                registry.set_cache_dir(optarg);
+                break;
             case 'h':
                 help_autoindex(argv);
                 return 0;
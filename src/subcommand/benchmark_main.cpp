@@ -18,6 +18,7 @@
 #include "../xg.hpp"
 #include "../integrated_snarl_finder.hpp"
 #include "../min_distance.hpp"
+#include "../aligner.hpp"
 
 
 
@@ -137,6 +138,36 @@ int main_benchmark(int argc, char** argv) {
     }));
         
     
+    // Make a small tree, like a tail forest tree, to align read tails to
+    VG tail_tree;
+    tail_tree.create_node("ACGTACGTAGCTAGCTAGGATTACA", 1);
+    tail_tree.create_node("CATTAGCATTAGGACCATAGGATCA", 2);
+    tail_tree.create_node("CATTAGCTTTAGGACCATAGGATCA", 3);
+    tail_tree.create_node("GATTACAGATTACACCATAGGATCA", 4);
+    tail_tree.create_edge(1, 2, false, false);
+    tail_tree.create_edge(1, 3, false, false);
+    tail_tree.create_edge(3, 4, false, false);
+    
+    Aligner aligner;
+    // Two tails that differ, so alternating between them defeats query reuse
+    Alignment tails[2];
+    tails[0].set_sequence("ACGTACGTAGCTAGCTAGGATTACACATTAGCTTTAGGACCATAGGATCAGATTACAGATTA");
+    tails[1].set_sequence("ACGTACGTAGCTAGCTAGGATTACACATTAGCATTAGGACCATAGGATCA");
+    
+    results.push_back(run_benchmark("dozeu pinned tail, reused query", 1000, [&]() {
+        for (size_t i = 0; i < 10; i++) {
+            Alignment aln = tails[0];
+            aligner.align_pinned(aln, tail_tree, true, true);
+        }
+    }));
+    
+    results.push_back(run_benchmark("dozeu pinned tail, new query", 1000, [&]() {
+        for (size_t i = 0; i < 10; i++) {
+            Alignment aln = tails[i % 2];
+            aligner.align_pinned(aln, tail_tree, true, true);
+        }
+    }));
+    
     // Do the control against itself
     results.push_back(run_benchmark("control", 1000, benchmark_control));
 
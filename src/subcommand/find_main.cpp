@@ -9,6 +9,7 @@
 #include <gcsa/support.h>
 #include "../region.hpp"
 #include "../stream_index.hpp"
+#include "../gaf_sorter.hpp"
 #include "../algorithms/subgraph.hpp"
 #include "../algorithms/sorted_id_ranges.hpp"
 #include "../algorithms/approx_path_distance.hpp"
@@ -48,6 +49,7 @@ void help_find(char** argv) {
          << "    -H, --gbwt FILE        when enumerating kmers from subgraphs, determine their frequencies in this GBWT haplotype index" << endl
          << "alignments:" << endl
          << "    -l, --sorted-gam FILE  use this sorted, indexed GAM file" << endl
+         << "        --sorted-gaf FILE  use this sorted, indexed, bgzipped GAF file (with -o)" << endl
          << "    -o, --alns-on N:M      write alignments which align to any of the nodes between N and M (inclusive)" << endl
          << "    -A, --to-graph VG      get alignments to the provided subgraph" << endl
          << "sequences:" << endl
@@ -88,6 +90,7 @@ int main_find(int argc, char** argv) {
     int mem_reseed_length = 0;
     bool use_fast_reseed = true;
     string sorted_gam_name;
+    string sorted_gaf_name;
     bool get_mappings = false;
     string aln_on_id_range;
     vg::id_t start_id = 0;
@@ -109,6 +112,7 @@ int main_find(int argc, char** argv) {
     string gbwt_name;
 
     constexpr int OPT_MAPPING = 1000;
+    constexpr int OPT_SORTED_GAF = 1001;
 
     int c;
     optind = 2; // force optind past command positional argument
@@ -136,6 +140,7 @@ int main_find(int argc, char** argv) {
                 {"position-in", required_argument, 0, 'P'},
                 {"node-range", required_argument, 0, 'r'},
                 {"sorted-gam", required_argument, 0, 'l'},
+                {"sorted-gaf", required_argument, 0, OPT_SORTED_GAF},
                 {"mappings", no_argument, 0, 'm'},
                 {"alns-on", required_argument, 0, 'o'},
                 {"distance", no_argument, 0, 'D'},
@@ -251,6 +256,10 @@ int main_find(int argc, char** argv) {
             sorted_gam_name = optarg;
             break;
 
+        case OPT_SORTED_GAF:
+            sorted_gaf_name = optarg;
+            break;
+
         case 'I':
             list_path_names = true;
             break;
@@ -303,8 +312,8 @@ int main_find(int argc, char** argv) {
         return 1;
     }
 
-    if (gcsa_in.empty() && xg_name.empty() && sorted_gam_name.empty()) {
-        cerr << "[vg find] find requires -g, -x, or -l to know where to find its database" << endl;
+    if (gcsa_in.empty() && xg_name.empty() && sorted_gam_name.empty() && sorted_gaf_name.empty()) {
+        cerr << "[vg find] find requires -g, -x, -l, or --sorted-gaf to know where to find its database" << endl;
         return 1;
     }
 
@@ -421,8 +430,23 @@ int main_find(int argc, char** argv) {
                 gam_index->find(cursor, start_id, end_id, vg::io::emit_to<Alignment>(cout));
             });
             
+        } else if (!sorted_gaf_name.empty()) {
+            // Find in sorted GAF, using its index to seek to the relevant blocks
+            StreamIndexBase gaf_index;
+            get_input_file(sorted_gaf_name + ".gai", [&](istream& in) {
+                gaf_index.load(in);
+            });
+            BGZF* gaf_file = bgzf_open(sorted_gaf_name.c_str(), "r");
+            if (gaf_file == nullptr) {
+                cerr << "error [vg find]: Cannot open sorted GAF " << sorted_gaf_name << endl;
+                exit(1);
+            }
+            find_gaf_records(gaf_file, gaf_index, start_id, end_id, [&](const string& record) {
+                cout << record << '\n';
+            });
+            bgzf_close(gaf_file);
         } else {
-            cerr << "error [vg find]: Cannot find alignments on range without a sorted GAM" << endl;
+            cerr << "error [vg find]: Cannot find alignments on range without a sorted GAM or GAF" << endl;
             exit(1);
         }
     }
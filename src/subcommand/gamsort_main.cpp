@@ -1,6 +1,7 @@
 #include "../stream_sorter.hpp"
 #include <vg/io/stream.hpp>
 #include "../stream_index.hpp"
+#include "../gaf_sorter.hpp"
 #include <getopt.h>
 #include "subcommand.hpp"
 
@@ -13,11 +14,13 @@ using namespace vg;
 using namespace vg::subcommand;
 void help_gamsort(char **argv)
 {
-    cerr << "gamsort: sort a GAM file, or index a sorted GAM file" << endl
+    cerr << "gamsort: sort a GAM or GAF file, or index a sorted GAM file" << endl
          << "Usage: " << argv[1] << " [Options] gamfile" << endl
          << "Options:" << endl
          << "  -i / --index FILE       produce an index of the sorted GAM file" << endl
          << "  -d / --dumb-sort        use naive sorting algorithm (no tmp files, faster for small GAMs)" << endl
+         << "  -G / --gaf-input        input is GAF (plain or bgzipped); write bgzipped GAF" << endl
+         << "  -m / --memory INT       keep about INT MB of alignments in memory while sorting [2048]" << endl
          << "  -p / --progress         Show progress." << endl
          << "  -t / --threads          Use the specified number of threads." << endl
          << endl;
@@ -27,12 +30,14 @@ int main_gamsort(int argc, char **argv)
 {
     string index_filename;
     bool easy_sort = false;
+    bool gaf_input = false;
     bool show_progress = false;
-    // We limit the max threads, and only allow thread count to be lowered, to
+    // The memory budget is split between the threads, so using more threads
+    // doesn't use more memory. But we still default to a few threads, to
     // prevent tcmalloc from giving each thread a very large heap for many
     // threads.
-    // On my machine we can keep about 4 threads busy.
     size_t num_threads = 4;
+    size_t memory_mb = 2048;
     int c;
     optind = 2; // force optind past command positional argument
     while (true)
@@ -41,12 +46,14 @@ int main_gamsort(int argc, char **argv)
             {
                 {"index", required_argument, 0, 'i'},
                 {"dumb-sort", no_argument, 0, 'd'},
+                {"gaf-input", no_argument, 0, 'G'},
                 {"rocks", required_argument, 0, 'r'},
                 {"progress", no_argument, 0, 'p'},
                 {"threads", required_argument, 0, 't'},
+                {"memory", required_argument, 0, 'm'},
                 {0, 0, 0, 0}};
         int option_index = 0;
-        c = getopt_long(argc, argv, "i:dhpt:",
+        c = getopt_long(argc, argv, "i:dGhpt:m:",
                         long_options, &option_index);
 
         // Detect the end of the options.
@@ -61,11 +68,25 @@ int main_gamsort(int argc, char **argv)
         case 'd':
             easy_sort = true;
             break;
+        case 'G':
+            gaf_input = true;
+            break;
         case 'p':
             show_progress = true;
             break;
         case 't':
-            num_threads = min(parse<size_t>(optarg), num_threads);
+            num_threads = parse<size_t>(optarg);
+            if (num_threads == 0) {
+                cerr << "error:[vg gamsort] Thread count (-t) must be a positive integer." << endl;
+                exit(1);
+            }
+            break;
+        case 'm':
+            memory_mb = parse<size_t>(optarg);
+            if (memory_mb == 0) {
+                cerr << "error:[vg gamsort] Memory budget (-m) must be a positive integer." << endl;
+                exit(1);
+            }
             break;
         case 'h':
         case '?':
@@ -83,9 +104,36 @@ int main_gamsort(int argc, char **argv)
     
     omp_set_num_threads(num_threads);
 
+    if (gaf_input) {
+        if (easy_sort) {
+            cerr << "error:[vg gamsort] Naive sorting (-d) is not available for GAF input" << endl;
+            exit(1);
+        }
+        
+        string gaf_in_name = get_input_file_name(optind, argc, argv);
+        
+        GAFSorter gs(show_progress);
+        gs.set_memory_budget(memory_mb * 1024 * 1024);
+        
+        // GAF is indexed the same way as GAM, by virtual offsets of groups of records
+        unique_ptr<StreamIndexBase> index;
+        if (!index_filename.empty()) {
+            index = unique_ptr<StreamIndexBase>(new StreamIndexBase());
+        }
+        
+        gs.stream_sort(gaf_in_name, "-", index.get());
+        
+        if (index.get() != nullptr) {
+            ofstream index_out(index_filename);
+            index->save(index_out);
+        }
+        return 0;
+    }
+
     get_input_file(optind, argc, argv, [&](istream& gam_in) {
 
         GAMSorter gs(show_progress);
+        gs.set_memory_budget(memory_mb * 1024 * 1024);
 
         // Do a normal GAMSorter sort
         unique_ptr<GAMIndex> index;
@@ -26,6 +26,7 @@
 #include "../gapless_extender.hpp"
 #include "../minimizer_mapper.hpp"
 #include "../index_registry.hpp"
+#include "../read_scheduler.hpp"
 #include <bdsg/overlays/overlay_helper.hpp>
 
 #include <gbwtgraph/gbz.h>
@@ -332,6 +333,10 @@ void help_giraffe(char** argv) {
     << "  -R, --read-group NAME         add this read group" << endl
     << "  -o, --output-format NAME      output the alignments in NAME format (gam / gaf / json / tsv / SAM / BAM / CRAM) [gam]" << endl
     << "  --ref-paths FILE              ordered list of paths in the graph, one per line or HTSlib .dict, for HTSLib @SQ headers" << endl
+    << "  --hts-threads INT             compress BAM / CRAM output on a separate pool of INT threads [0]" << endl
+    << "  --sort-output                 sort SAM / BAM / CRAM output by coordinate" << endl
+    << "  --sort-memory INT             hold up to INT MB of records in memory when sorting output [2048]" << endl
+    << "  --hts-index FILE              index sorted BAM / CRAM output to FILE (as CSI if it ends in .csi)" << endl
     << "  -n, --discard                 discard all output alignments (for profiling)" << endl
     << "  --output-basename NAME        write output to a GAM file beginning with the given prefix for each setting combination" << endl
     << "  --report-name NAME            write a TSV of output file and mapping speed to the given file" << endl
@@ -351,6 +356,8 @@ void help_giraffe(char** argv) {
     << "  -v, --extension-score INT     only align extensions if their score is within INT of the best score [1]" << endl
     << "  -w, --extension-set INT       only align extension sets if their score is within INT of the best score [20]" << endl
     << "  -O, --no-dp                   disable all gapped alignment" << endl
+    << "  --tail-bound-mapq FLOAT       skip gapped alignment of extension sets that cannot bring single-end MAPQ below FLOAT [0 = off]" << endl
+    << "  --bound-tail-trees            score each tail against all its candidate trees at once and only align to those that could win" << endl
     << "  -r, --rescue-attempts         attempt up to INT rescues per read in a pair [15]" << endl
     << "  -A, --rescue-algorithm NAME   use algorithm NAME for rescue (none / dozeu / gssw / haplotypes) [dozeu]" << endl
     << "  -L, --max-fragment-length INT assume that fragment lengths should be smaller than INT when estimating the fragment length distribution" << endl
@@ -360,6 +367,9 @@ void help_giraffe(char** argv) {
     << "  --rescue-subgraph-size FLOAT  search for rescued alignments FLOAT standard deviations greater than the mean [4.0]" << endl
     << "  --track-provenance            track how internal intermediate alignment candidates were arrived at" << endl
     << "  --track-correctness           track if internal intermediate alignment candidates are correct (implies --track-provenance)" << endl
+    << "  --batch-size INT              look up minimizers for INT single-end reads at a time in each thread [1]" << endl
+    << "  --work-stealing               hand reads to threads with a work-stealing scheduler and report batch latencies" << endl
+    << "  --parallel-cluster-seeds INT  cluster snarls in parallel for reads with at least INT seeds, 0 to disable [1000]" << endl
     << "  -t, --threads INT             number of mapping threads to use" << endl;
 }
 
@@ -382,6 +392,15 @@ int main_giraffe(int argc, char** argv) {
     #define OPT_RESCUE_STDEV 1008
     #define OPT_REF_PATHS 1009
     #define OPT_SHOW_WORK 1010
+    #define OPT_BATCH_SIZE 1011
+    #define OPT_WORK_STEALING 1012
+    #define OPT_PARALLEL_CLUSTER_SEEDS 1013
+    #define OPT_HTS_THREADS 1014
+    #define OPT_SORT_OUTPUT 1015
+    #define OPT_SORT_MEMORY 1016
+    #define OPT_HTS_INDEX 1017
+    #define OPT_TAIL_BOUND_MAPQ 1018
+    #define OPT_BOUND_TAIL_TREES 1019
     
 
     // initialize parameters with their default options
@@ -397,6 +416,10 @@ int main_giraffe(int argc, char** argv) {
     bool show_progress = false;
     // Should we try chaining or just give up if we can't find a full length gapless alignment?
     bool do_dp = true;
+    // What MAPQ should we be sure of before skipping gapped alignment on bounds?
+    double tail_bound_mapq = 0;
+    // Should we bound tail alignments against each tree before doing them?
+    bool bound_tail_trees = false;
     // What GAM should we realign?
     string gam_filename;
     // What FASTQs should we align.
@@ -455,6 +478,12 @@ int main_giraffe(int argc, char** argv) {
     bool track_correctness = false;
     // Should we log our mapping decision making?
     bool show_work = false;
+    // How many single-end reads should each thread look up minimizers for at once?
+    size_t batch_size = 1;
+    // Should we hand reads to threads with a work-stealing scheduler?
+    bool work_stealing = false;
+    // How many seeds does a read need before we cluster it in parallel?
+    size_t parallel_cluster_seeds = 1000;
 
     // Chain all the ranges and get a function that loops over all combinations.
     auto for_each_combo = distance_limit
@@ -479,6 +508,13 @@ int main_giraffe(int argc, char** argv) {
 
     // For HTSlib formats, where do we get sequence header info?
     std::string ref_paths_name;
+    // How many threads should compress HTSlib output, if not the mapping threads?
+    size_t hts_threads = 0;
+    // Should HTSlib output be sorted, and with how much memory?
+    bool sort_output = false;
+    size_t sort_memory_mb = 2048;
+    // Where should sorted HTSlib output be indexed to, if anywhere?
+    std::string hts_index_name;
 
     // Map algorithm names to rescue algorithms
     std::map<std::string, MinimizerMapper::RescueAlgorithm> rescue_algorithms = {
@@ -541,6 +577,15 @@ int main_giraffe(int argc, char** argv) {
             {"track-provenance", no_argument, 0, OPT_TRACK_PROVENANCE},
             {"track-correctness", no_argument, 0, OPT_TRACK_CORRECTNESS},
             {"show-work", no_argument, 0, OPT_SHOW_WORK},
+            {"batch-size", required_argument, 0, OPT_BATCH_SIZE},
+            {"work-stealing", no_argument, 0, OPT_WORK_STEALING},
+            {"parallel-cluster-seeds", required_argument, 0, OPT_PARALLEL_CLUSTER_SEEDS},
+            {"hts-threads", required_argument, 0, OPT_HTS_THREADS},
+            {"sort-output", no_argument, 0, OPT_SORT_OUTPUT},
+            {"sort-memory", required_argument, 0, OPT_SORT_MEMORY},
+            {"hts-index", required_argument, 0, OPT_HTS_INDEX},
+            {"tail-bound-mapq", required_argument, 0, OPT_TAIL_BOUND_MAPQ},
+            {"bound-tail-trees", no_argument, 0, OPT_BOUND_TAIL_TREES},
             {"threads", required_argument, 0, 't'},
             {0, 0, 0, 0}
         };
@@ -917,6 +962,54 @@ int main_giraffe(int argc, char** argv) {
             case OPT_SHOW_WORK:
                 show_work = true;
                 break;
+
+            case OPT_BATCH_SIZE:
+                batch_size = parse<size_t>(optarg);
+                if (batch_size == 0) {
+                    cerr << "error:[vg giraffe] Batch size (--batch-size) must be a positive integer." << endl;
+                    exit(1);
+                }
+                break;
+
+            case OPT_WORK_STEALING:
+                work_stealing = true;
+                break;
+
+            case OPT_PARALLEL_CLUSTER_SEEDS:
+                parallel_cluster_seeds = parse<size_t>(optarg);
+                break;
+                
+            case OPT_HTS_THREADS:
+                hts_threads = parse<size_t>(optarg);
+                break;
+                
+            case OPT_SORT_OUTPUT:
+                sort_output = true;
+                break;
+                
+            case OPT_SORT_MEMORY:
+                sort_memory_mb = parse<size_t>(optarg);
+                if (sort_memory_mb == 0) {
+                    cerr << "error:[vg giraffe] Sort memory (--sort-memory) must be positive" << endl;
+                    exit(1);
+                }
+                break;
+                
+            case OPT_HTS_INDEX:
+                hts_index_name = optarg;
+                break;
+                
+            case OPT_TAIL_BOUND_MAPQ:
+                tail_bound_mapq = parse<double>(optarg);
+                if (tail_bound_mapq < 0) {
+                    cerr << "error:[vg giraffe] Tail bound MAPQ (--tail-bound-mapq) cannot be negative" << endl;
+                    exit(1);
+                }
+                break;
+                
+            case OPT_BOUND_TAIL_TREES:
+                bound_tail_trees = true;
+                break;
                 
             case 't':
             {
@@ -997,6 +1090,21 @@ int main_giraffe(int argc, char** argv) {
         ref_paths_name = "";
     }
     
+    if (hts_threads != 0 && output_format != "BAM" && output_format != "CRAM") {
+        cerr << "warning:[vg giraffe] Compression threads (--hts-threads) are only used when output format (-o) is BAM or CRAM." << endl;
+        hts_threads = 0;
+    }
+    
+    if (sort_output && !hts_output) {
+        cerr << "error:[vg giraffe] Sorting output (--sort-output) requires output format (-o) SAM, BAM, or CRAM." << endl;
+        exit(1);
+    }
+    
+    if (!hts_index_name.empty() && (!sort_output || (output_format != "BAM" && output_format != "CRAM"))) {
+        cerr << "error:[vg giraffe] Indexing output (--hts-index) requires sorted (--sort-output) BAM or CRAM output (-o)." << endl;
+        exit(1);
+    }
+    
     if (output_format != "GAM" && !output_basename.empty()) {
         cerr << "error:[vg giraffe] Using an output basename (--output-basename) only makes sense for GAM format (-o)" << endl;
         exit(1);
@@ -1242,6 +1350,16 @@ int main_giraffe(int argc, char** argv) {
         }
         minimizer_mapper.do_dp = do_dp;
 
+        if (show_progress && tail_bound_mapq > 0) {
+            cerr << "--tail-bound-mapq " << tail_bound_mapq << endl;
+        }
+        minimizer_mapper.tail_bound_mapq = tail_bound_mapq;
+
+        if (show_progress && bound_tail_trees) {
+            cerr << "--bound-tail-trees " << endl;
+        }
+        minimizer_mapper.bound_tail_trees = bound_tail_trees;
+
         if (show_progress) {
             cerr << "--max-multimaps " << max_multimaps << endl;
         }
@@ -1267,6 +1385,30 @@ int main_giraffe(int argc, char** argv) {
         }
         minimizer_mapper.show_work = show_work;
 
+        if (show_progress) {
+            cerr << "--parallel-cluster-seeds " << parallel_cluster_seeds << endl;
+        }
+        minimizer_mapper.set_parallel_cluster_seeds(parallel_cluster_seeds);
+
+        if (show_progress && hts_threads > 0) {
+            cerr << "--hts-threads " << hts_threads << endl;
+        }
+        
+        if (show_progress && sort_output) {
+            cerr << "--sort-output" << endl;
+            cerr << "--sort-memory " << sort_memory_mb << endl;
+            if (!hts_index_name.empty()) {
+                cerr << "--hts-index " << hts_index_name << endl;
+            }
+        }
+
+        if (show_progress && batch_size > 1) {
+            cerr << "--batch-size " << batch_size << endl;
+            if (paired) {
+                cerr << "warning[vg::giraffe]: --batch-size only applies to single-end reads; pairs look up both mates together" << endl;
+            }
+        }
+
         if (show_progress && paired) {
             if (forced_mean && forced_stdev) {
                 cerr << "--fragment-mean " << fragment_mean << endl; 
@@ -1292,6 +1434,13 @@ int main_giraffe(int argc, char** argv) {
         // Set up counters per-thread for total reads mapped
         vector<size_t> reads_mapped_by_thread(thread_count, 0);
         
+        // If requested, hand reads to threads with a work-stealing scheduler
+        // instead of as OpenMP tasks.
+        unique_ptr<ReadBatchScheduler> scheduler;
+        if (work_stealing) {
+            scheduler = make_unique<ReadBatchScheduler>(thread_count);
+        }
+        
         // For timing, we may run one thread first and then switch to all threads. So track both start times.
         std::chrono::time_point<std::chrono::system_clock> first_thread_start;
         std::chrono::time_point<std::chrono::system_clock> all_threads_start;
@@ -1361,7 +1510,9 @@ int main_giraffe(int argc, char** argv) {
             // We send along the positional graph when we have it, and otherwise we send the GBWTGraph which is sufficient for GAF output.
             unique_ptr<AlignmentEmitter> alignment_emitter = discard_alignments ?
                 make_unique<NullAlignmentEmitter>() :
-                get_alignment_emitter("-", output_format, paths, thread_count, path_position_graph ? (const HandleGraph*)path_position_graph : (const HandleGraph*)&(gbz->graph));
+                get_alignment_emitter("-", output_format, paths, thread_count, path_position_graph ? (const HandleGraph*)path_position_graph : (const HandleGraph*)&(gbz->graph),
+                                      false, false, hts_threads,
+                                      sort_output ? sort_memory_mb * 1024 * 1024 : 0, hts_index_name);
             
 #ifdef USE_CALLGRIND
             // We want to profile the alignment, not the loading.
@@ -1453,16 +1604,20 @@ int main_giraffe(int argc, char** argv) {
                     // GAM file to remap
                     get_input_file(gam_filename, [&](istream& in) {
                         // Map pairs of reads to the emitter
-                        vg::io::for_each_interleaved_pair_parallel_after_wait<Alignment>(in, map_read_pair, distribution_is_ready);
+                        if (scheduler) {
+                            scheduler->for_each_interleaved_pair_parallel_after_wait(in, map_read_pair, distribution_is_ready);
+                        } else {
+                            vg::io::for_each_interleaved_pair_parallel_after_wait<Alignment>(in, map_read_pair, distribution_is_ready);
+                        }
                     });
                 } else if (!fastq_filename_2.empty()) {
                     //A pair of FASTQ files to map
-                    fastq_paired_two_files_for_each_parallel_after_wait(fastq_filename_1, fastq_filename_2, map_read_pair, distribution_is_ready);
+                    fastq_paired_two_files_for_each_parallel_after_wait(fastq_filename_1, fastq_filename_2, map_read_pair, distribution_is_ready, scheduler.get());
 
 
                 } else if ( !fastq_filename_1.empty()) {
                     // An interleaved FASTQ file to map, map all its pairs in parallel.
-                    fastq_paired_interleaved_for_each_parallel_after_wait(fastq_filename_1, map_read_pair, distribution_is_ready);
+                    fastq_paired_interleaved_for_each_parallel_after_wait(fastq_filename_1, map_read_pair, distribution_is_ready, scheduler.get());
                 }
 
                 // Now map all the ambiguous pairs
@@ -1487,12 +1642,32 @@ int main_giraffe(int argc, char** argv) {
                 // All the threads start at once.
                 all_threads_start = first_thread_start;
             
+                // When batching, each thread collects reads here until it has a full batch.
+                vector<vector<Alignment>> batch_by_thread(batch_size > 1 ? thread_count : 0);
+                
+                // Define how to map and output a thread's collected batch.
+                auto map_batch = [&](vector<Alignment>& batch) {
+                    minimizer_mapper.map_batch(batch, *alignment_emitter);
+                    reads_mapped_by_thread.at(omp_get_thread_num()) += batch.size();
+                    batch.clear();
+                };
+            
                 // Define how to align and output a read, in a thread.
                 auto map_read = [&](Alignment& aln) {
 #ifdef __linux__
                     ensure_perf_for_thread();
 #endif
                 
+                    if (batch_size > 1) {
+                        // Hold the read until this thread has a full batch to map together.
+                        auto& batch = batch_by_thread.at(omp_get_thread_num());
+                        batch.emplace_back(std::move(aln));
+                        if (batch.size() >= batch_size) {
+                            map_batch(batch);
+                        }
+                        return;
+                    }
+                
                     // Map the read with the MinimizerMapper.
                     minimizer_mapper.map(aln, *alignment_emitter);
                     // Record that we mapped a read.
@@ -1503,13 +1678,28 @@ int main_giraffe(int argc, char** argv) {
                     // GAM file to remap
                     get_input_file(gam_filename, [&](istream& in) {
                         // Open it and map all the reads in parallel.
-                        vg::io::for_each_parallel<Alignment>(in, map_read);
+                        if (scheduler) {
+                            scheduler->for_each_parallel(in, map_read);
+                        } else {
+                            vg::io::for_each_parallel<Alignment>(in, map_read);
+                        }
                     });
                 }
                 
                 if (!fastq_filename_1.empty()) {
                     // FASTQ file to map, map all its reads in parallel.
-                    fastq_unpaired_for_each_parallel(fastq_filename_1, map_read);
+                    fastq_unpaired_for_each_parallel(fastq_filename_1, map_read, scheduler.get());
+                }
+                
+                // Map whatever partial batches the threads were left holding.
+                #pragma omp parallel for schedule(dynamic, 1)
+                for (size_t i = 0; i < batch_by_thread.size(); i++) {
+                    if (!batch_by_thread[i].empty()) {
+#ifdef __linux__
+                        ensure_perf_for_thread();
+#endif
+                        map_batch(batch_by_thread[i]);
+                    }
                 }
             }
         
@@ -1580,6 +1770,10 @@ int main_giraffe(int argc, char** argv) {
                     << " M mapping instructions per inclusive CPU-second" << endl;
             }
 
+            if (scheduler) {
+                scheduler->report(cerr);
+            }
+
             cerr << "Memory footprint: " << gbwt::inGigabytes(gbwt::memoryUsage()) << " GB" << endl;
         }
         
@@ -81,7 +81,8 @@ void help_index(char** argv) {
          << "snarl distance index options" << endl
          << "    -s  --snarl-name FILE  load snarls from FILE (snarls must include trivial snarls)" << endl
          << "    -j  --dist-name FILE   use this file to store a snarl-based distance index" << endl
-         << "    -w  --max_dist N       cap beyond which the maximum distance is no longer accurate. If this is not included or is 0, don't build maximum distance index" << endl;
+         << "    -w  --max_dist N       cap beyond which the maximum distance is no longer accurate. If this is not included or is 0, don't build maximum distance index" << endl
+         << "    --flat-dist            store the distance index in the flat layout, with all snarl and chain records in one block" << endl;
 }
 
 void multiple_thread_sources() {
@@ -100,6 +101,7 @@ int main_index(int argc, char** argv) {
     #define OPT_BUILD_VGI_INDEX  1000
     #define OPT_RENAME_VARIANTS  1001
     #define OPT_PATHS_AS_SAMPLES 1002
+    #define OPT_FLAT_DIST        1003
 
     // Which indexes to build.
     bool build_xg = false, build_gbwt = false, build_gcsa = false, build_dist = false;
@@ -134,6 +136,7 @@ int main_index(int argc, char** argv) {
     //Distance index
     int cap = -1;
     bool include_maximum = false;
+    bool flat_dist = false;
 
     // Include alt paths in xg
     bool xg_alts = false;
@@ -192,6 +195,7 @@ int main_index(int argc, char** argv) {
             {"snarl-name", required_argument, 0, 's'},
             {"dist-name", required_argument, 0, 'j'},
             {"max-dist", required_argument, 0, 'w'},
+            {"flat-dist", no_argument, 0, OPT_FLAT_DIST},
             {0, 0, 0, 0}
         };
 
@@ -384,6 +388,9 @@ int main_index(int argc, char** argv) {
             cap = parse<int>(optarg);
             include_maximum = true;
             break;
+        case OPT_FLAT_DIST:
+            flat_dist = true;
+            break;
 
         case 'h':
         case '?':
@@ -725,6 +732,7 @@ int main_index(int argc, char** argv) {
 
                 // Create the MinimumDistanceIndex
                 MinimumDistanceIndex di(xg.get(), snarl_manager);
+                di.set_flat_layout(flat_dist);
                 // Save the completed DistanceIndex
                 vg::io::VPKG::save(di, dist_name);
 
@@ -738,6 +746,7 @@ int main_index(int argc, char** argv) {
                     
                     // Create the MinimumDistanceIndex
                     MinimumDistanceIndex di(&(gbz->graph), snarl_manager);
+                    di.set_flat_layout(flat_dist);
                     vg::io::VPKG::save(di, dist_name);
                 } else if (get<1>(options)) {
                     // We were given a graph generically
@@ -745,6 +754,7 @@ int main_index(int argc, char** argv) {
                     
                     // Create the MinimumDistanceIndex
                     MinimumDistanceIndex di(graph.get(), snarl_manager);
+                    di.set_flat_layout(flat_dist);
                     vg::io::VPKG::save(di, dist_name);
                 } else {
                     cerr << "error: [vg index] input is not a graph or GBZ" << endl;
@@ -17,6 +17,7 @@
 #include "../path.hpp"
 #include "../watchdog.hpp"
 #include "../watchdog.hpp"
+#include "../read_scheduler.hpp"
 #include <bdsg/overlays/overlay_helper.hpp>
 #include <bdsg/odgi.hpp>
 #include <bdsg/packed_graph.hpp>
@@ -74,6 +75,7 @@ void help_mpmap(char** argv) {
 //    << "  -E, --long-read-scoring      set alignment scores to long-read defaults: -q1 -z1 -o1 -y1 -L0 (can be overridden)" << endl
     << "computational parameters:" << endl
     << "  -t, --threads INT         number of compute threads to use [all available]" << endl
+    << "      --work-stealing       hand reads to threads with a work-stealing scheduler and report batch latencies" << endl
     << endl
     << "advanced options:" << endl
     << "algorithm:" << endl
@@ -163,6 +165,7 @@ int main_mpmap(int argc, char** argv) {
     #define OPT_ALT_PATHS 1030
     #define OPT_SUPPRESS_SUPPRESSION 1031
     #define OPT_SNARL_MAX_CUT 1032
+    #define OPT_WORK_STEALING 1033
     string matrix_file_name;
     string graph_name;
     string gcsa_name;
@@ -301,6 +304,7 @@ int main_mpmap(int argc, char** argv) {
     int min_splice_length = 20;
     int mem_accelerator_length = 12;
     bool no_output = false;
+    bool work_stealing = false;
     string out_format = "GAMP";
 
     // default presets
@@ -395,6 +399,7 @@ int main_mpmap(int argc, char** argv) {
             {"no-qual-adjust", no_argument, 0, 'A'},
             {"threads", required_argument, 0, 't'},
             {"no-output", no_argument, 0, OPT_NO_OUTPUT},
+            {"work-stealing", no_argument, 0, OPT_WORK_STEALING},
             {0, 0, 0, 0}
         };
 
@@ -794,6 +799,10 @@ int main_mpmap(int argc, char** argv) {
                 no_output = true;
                 break;
                 
+            case OPT_WORK_STEALING:
+                work_stealing = true;
+                break;
+                
             case 'h':
             case '?':
             default:
@@ -2134,6 +2143,12 @@ int main_mpmap(int argc, char** argv) {
         return multipath_mapper.has_fixed_fragment_length_distr();
     };
     
+    // if requested, hand reads to threads with a work-stealing scheduler instead of as OpenMP tasks
+    unique_ptr<ReadBatchScheduler> scheduler;
+    if (work_stealing) {
+        scheduler = unique_ptr<ReadBatchScheduler>(new ReadBatchScheduler(thread_count));
+    }
+    
     // FASTQ input
     if (!fastq_name_1.empty()) {
         if (!suppress_progress) {
@@ -2142,14 +2157,14 @@ int main_mpmap(int argc, char** argv) {
         
         if (interleaved_input) {
             fastq_paired_interleaved_for_each_parallel_after_wait(fastq_name_1, do_paired_alignments,
-                                                                  multi_threaded_condition);
+                                                                  multi_threaded_condition, scheduler.get());
         }
         else if (fastq_name_2.empty()) {
-            fastq_unpaired_for_each_parallel(fastq_name_1, do_unpaired_alignments);
+            fastq_unpaired_for_each_parallel(fastq_name_1, do_unpaired_alignments, scheduler.get());
         }
         else {
             fastq_paired_two_files_for_each_parallel_after_wait(fastq_name_1, fastq_name_2, do_paired_alignments,
-                                                                multi_threaded_condition);
+                                                                multi_threaded_condition, scheduler.get());
         }
     }
     
@@ -2165,7 +2180,14 @@ int main_mpmap(int argc, char** argv) {
                 exit(1);
             }
             
-            if (interleaved_input) {
+            if (scheduler && interleaved_input) {
+                scheduler->for_each_interleaved_pair_parallel_after_wait(gam_in, do_paired_alignments,
+                                                                         multi_threaded_condition);
+            }
+            else if (scheduler) {
+                scheduler->for_each_parallel(gam_in, do_unpaired_alignments);
+            }
+            else if (interleaved_input) {
                 vg::io::for_each_interleaved_pair_parallel_after_wait(gam_in, do_paired_alignments,
                                                                       multi_threaded_condition);
             }
@@ -2224,6 +2246,10 @@ int main_mpmap(int argc, char** argv) {
             num_reads_mapped += uncounted_mappings;
         }
         cerr << progress_boilerplate() << "Mapping finished. Mapped " << num_reads_mapped << " " << (fastq_name_2.empty() && !interleaved_input ? "reads" : "read pairs") << "." << endl;
+        if (scheduler) {
+            cerr << progress_boilerplate();
+            scheduler->report(cerr);
+        }
     }
     
 #ifdef record_read_run_times
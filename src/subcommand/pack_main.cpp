@@ -31,6 +31,7 @@ void help_pack(char** argv) {
          << "    -N, --node-list FILE   a white space or line delimited list of nodes to collect" << endl
          << "    -Q, --min-mapq N       ignore reads with MAPQ < N and positions with base quality < N [default: 0]" << endl
          << "    -c, --expected-cov N   expected coverage.  used only for memory tuning [default : 128]" << endl
+         << "    -B, --buffer-size N    buffer N coverage increments per thread between merges, 0 to disable [default: 65536]" << endl
          << "    -t, --threads N        use N threads (defaults to numCPUs)" << endl;
 }
 
@@ -52,6 +53,7 @@ int main_pack(int argc, char** argv) {
     int min_mapq = 0;
     int min_baseq = 0;
     size_t expected_coverage = 128;
+    size_t thread_buffer_size = 65536;
 
     if (argc == 2) {
         help_pack(argv);
@@ -79,11 +81,12 @@ int main_pack(int argc, char** argv) {
             {"bin-size", required_argument, 0, 'b'},
             {"min-mapq", required_argument, 0, 'Q'},
             {"expected-cov", required_argument, 0, 'c'},
+            {"buffer-size", required_argument, 0, 'B'},
             {0, 0, 0, 0}
 
         };
         int option_index = 0;
-        c = getopt_long (argc, argv, "hx:o:i:g:a:dDut:eb:n:N:Q:c:",
+        c = getopt_long (argc, argv, "hx:o:i:g:a:dDut:eb:n:N:Q:c:B:",
                 long_options, &option_index);
 
         // Detect the end of the options.
@@ -127,6 +130,9 @@ int main_pack(int argc, char** argv) {
         case 'b':
             bin_size = atoll(optarg);
             break;
+        case 'B':
+            thread_buffer_size = parse<size_t>(optarg);
+            break;
         case 't':
         {
             int num_threads = parse<int>(optarg);
@@ -210,7 +216,7 @@ int main_pack(int argc, char** argv) {
     size_t bin_count = Packer::estimate_bin_count(num_threads);
 
     // create our packer
-    Packer packer(graph, true, true, record_edits, true, bin_size, bin_count, data_width);
+    Packer packer(graph, true, true, record_edits, true, bin_size, bin_count, data_width, thread_buffer_size);
     
     // todo one packer per thread and merge
     if (packs_in.size() == 1) {
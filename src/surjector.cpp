@@ -101,8 +101,8 @@ using namespace std;
             }
         }
         
-        // make an overlay that will memoize the results of some expensive XG operations
-        MemoizingGraph memoizing_graph(graph);
+        // get an overlay that will memoize the results of some expensive XG operations
+        MemoizingGraph& memoizing_graph = get_memoizing_graph();
         
         // get the chunks of the aligned path that overlap the ref path
         unordered_map<path_handle_t, vector<tuple<size_t, size_t, int32_t>>> connections;
@@ -147,41 +147,87 @@ using namespace std;
         // the surjected alignment for each path we overlapped
         unordered_map<path_handle_t, pair<Alignment, pair<step_handle_t, step_handle_t>>> aln_surjections;
         unordered_map<path_handle_t, pair<multipath_alignment_t, pair<step_handle_t, step_handle_t>>> mp_aln_surjections;
+        
+        // collect the paths up front so that we can surject to them independently
+        vector<pair<const path_handle_t, pair<vector<path_chunk_t>, vector<pair<step_handle_t, step_handle_t>>>>*> surj_records;
+        vector<vector<tuple<size_t, size_t, int32_t>>*> surj_connections;
+        surj_records.reserve(path_overlapping_anchors.size());
+        surj_connections.reserve(path_overlapping_anchors.size());
         for (pair<const path_handle_t, pair<vector<path_chunk_t>, vector<pair<step_handle_t, step_handle_t>>>>& surj_record : path_overlapping_anchors) {
+            surj_records.push_back(&surj_record);
+            surj_connections.push_back(&connections[surj_record.first]);
+        }
+        
+        // to hold the surjection onto each path and the path interval that corresponds to it
+        vector<Alignment> path_alns(source_aln ? surj_records.size() : 0);
+        vector<multipath_alignment_t> path_mp_alns(source_mp_aln ? surj_records.size() : 0);
+        vector<pair<step_handle_t, step_handle_t>> path_ranges(surj_records.size());
+        vector<uint8_t> path_surjected(surj_records.size(), false);
+        
+        auto surject_to_path = [&](size_t i) {
+            // this may be run on a different thread, so use that thread's memos
+            MemoizingGraph& path_memoizing_graph = get_memoizing_graph();
+            auto& surj_record = *surj_records[i];
             
-            // to hold the path interval that corresponds to the path we surject to
-            pair<step_handle_t, step_handle_t> path_range;
             if (!preserve_deletions && source_aln) {
-                auto surjection = realigning_surject(&memoizing_graph, *source_aln, surj_record.first,
-                                                     surj_record.second.first, path_range, allow_negative_scores,
+                auto surjection = realigning_surject(&path_memoizing_graph, *source_aln, surj_record.first,
+                                                     surj_record.second.first, path_ranges[i], allow_negative_scores,
                                                      false, false);
                 if (surjection.path().mapping_size() != 0) {
-                    aln_surjections[surj_record.first] = make_pair(move(surjection), path_range);
+                    path_alns[i] = move(surjection);
+                    path_surjected[i] = true;
                 }
             }
             else if (source_aln) {
-                auto surjection = spliced_surject(&memoizing_graph, source_aln->sequence(), source_aln->quality(),
+                auto surjection = spliced_surject(&path_memoizing_graph, source_aln->sequence(), source_aln->quality(),
                                                  source_aln->mapping_quality(), surj_record.first, surj_record.second.first,
-                                                 surj_record.second.second, connections[surj_record.first], path_range,
+                                                 surj_record.second.second, *surj_connections[i], path_ranges[i],
                                                  allow_negative_scores, preserve_deletions);
                 if (surjection.subpath_size() != 0) {
                     // this internal method is written for multipath alignments, so we need to convert to standard alignments
-                    aln_surjections[surj_record.first] = make_pair(Alignment(), path_range);
-                    auto& surjected_aln = aln_surjections[surj_record.first].first;
-                    optimal_alignment(surjection, surjected_aln, allow_negative_scores);
-                    transfer_read_metadata(*source_aln, surjected_aln);
+                    optimal_alignment(surjection, path_alns[i], allow_negative_scores);
+                    transfer_read_metadata(*source_aln, path_alns[i]);
+                    path_surjected[i] = true;
                 }
             }
             else {
-                auto surjection = spliced_surject(&memoizing_graph, source_mp_aln->sequence(),
+                auto surjection = spliced_surject(&path_memoizing_graph, source_mp_aln->sequence(),
                                                   source_mp_aln->quality(), source_mp_aln->mapping_quality(),
                                                   surj_record.first, surj_record.second.first,
-                                                  surj_record.second.second, connections[surj_record.first],
-                                                  path_range, allow_negative_scores, preserve_deletions);
+                                                  surj_record.second.second, *surj_connections[i],
+                                                  path_ranges[i], allow_negative_scores, preserve_deletions);
                 if (surjection.subpath_size() != 0) {
-                    mp_aln_surjections[surj_record.first] = make_pair(move(surjection), path_range);
+                    path_mp_alns[i] = move(surjection);
+                    path_surjected[i] = true;
                 }
             }
+        };
+        
+        if (surj_records.size() > 1) {
+            // the realignments to different paths are independent, so let any idle threads
+            // help out (when we're not in a parallel region, these just run immediately)
+            for (size_t i = 0; i < surj_records.size(); ++i) {
+#pragma omp task default(shared) firstprivate(i)
+                surject_to_path(i);
+            }
+#pragma omp taskwait
+        }
+        else if (!surj_records.empty()) {
+            surject_to_path(0);
+        }
+        
+        // record the results in the same order as the serial loop would, so that ties between
+        // paths are broken the same way
+        for (size_t i = 0; i < surj_records.size(); ++i) {
+            if (!path_surjected[i]) {
+                continue;
+            }
+            if (source_aln) {
+                aln_surjections[surj_records[i]->first] = make_pair(move(path_alns[i]), path_ranges[i]);
+            }
+            else {
+                mp_aln_surjections[surj_records[i]->first] = make_pair(move(path_mp_alns[i]), path_ranges[i]);
+            }
         }
         
         // in case we didn't overlap any paths, add a sentinel so the following code still executes correctly
@@ -2641,6 +2687,25 @@ using namespace std;
         }
     }
     
+    MemoizingGraph& Surjector::get_memoizing_graph() const {
+        // we go by the actual thread rather than the OMP thread number, since tasks
+        // and nested parallel regions can reuse thread numbers
+        MemoizingGraph* memoizing_graph;
+        {
+            lock_guard<mutex> guard(memoizing_graphs_lock);
+            unique_ptr<MemoizingGraph>& slot = memoizing_graphs[this_thread::get_id()];
+            if (!slot) {
+                slot.reset(new MemoizingGraph(graph));
+            }
+            memoizing_graph = slot.get();
+        }
+        if (memoizing_graph->memos_full()) {
+            // start over rather than stop memoizing
+            memoizing_graph->clear_memos();
+        }
+        return *memoizing_graph;
+    }
+    
     Alignment Surjector::make_null_alignment(const Alignment& source) {
         Alignment null;
         null.set_name(source.name());
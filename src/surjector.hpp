@@ -8,6 +8,9 @@
 
 #include <set>
 #include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 #include "alignment.hpp"
 #include "aligner.hpp"
@@ -196,6 +199,10 @@ using namespace std;
                                  vector<path_chunk_t>& path_chunks,
                                  vector<pair<step_handle_t, step_handle_t>>& ref_chunks) const;
         
+        /// get this thread's overlay of the graph that memoizes some expensive operations, and
+        /// keeps its memos between surjections so that nearby reads can share them
+        MemoizingGraph& get_memoizing_graph() const;
+        
         /// make a sentinel meant to indicate an unmapped read
         static Alignment make_null_alignment(const Alignment& source);
         
@@ -203,6 +210,13 @@ using namespace std;
         
         /// the graph we're surjecting onto
         const PathPositionHandleGraph* graph = nullptr;
+        
+        /// the memoizing overlays for each thread that has surjected with this surjector
+        mutable unordered_map<thread::id, unique_ptr<MemoizingGraph>> memoizing_graphs;
+        
+        /// protects memoizing_graphs, but not the overlays in it, which are only used
+        /// by their own threads
+        mutable mutex memoizing_graphs_lock;
     };
 }
 
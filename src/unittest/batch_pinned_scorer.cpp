@@ -0,0 +1,124 @@
+///
+/// \file batch_pinned_scorer.cpp
+///
+/// Unit tests for BatchPinnedScorer
+///
+
+#include "catch.hpp"
+#include "../batch_pinned_scorer.hpp"
+
+#include <algorithm>
+#include <random>
+
+namespace vg {
+namespace unittest {
+
+using namespace std;
+
+/// Compute the best left-pinned alignment score one cell at a time.
+static int32_t slow_pinned_score(const string& query, const string& target, const int8_t* matrix,
+                                 int32_t gap_open, int32_t gap_extension, int32_t bonus) {
+    const int32_t inf = 1 << 28;
+    size_t rows = query.size() + 1;
+    size_t cols = target.size() + 1;
+    vector<vector<int32_t>> h(rows, vector<int32_t>(cols, -inf));
+    vector<vector<int32_t>> e(rows, vector<int32_t>(cols, -inf));
+    vector<vector<int32_t>> f(rows, vector<int32_t>(cols, -inf));
+    string bases = "ACGT";
+    int32_t best = 0;
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            if (i == 0 && j == 0) {
+                h[i][j] = 0;
+            } else {
+                if (j > 0) {
+                    e[i][j] = max(h[i][j - 1] - gap_open, e[i][j - 1] - gap_extension);
+                }
+                if (i > 0) {
+                    f[i][j] = max(h[i - 1][j] - gap_open, f[i - 1][j] - gap_extension);
+                }
+                h[i][j] = max(e[i][j], f[i][j]);
+                if (i > 0 && j > 0) {
+                    int32_t s = matrix[bases.find(query[i - 1]) * 4 + bases.find(target[j - 1])];
+                    h[i][j] = max(h[i][j], h[i - 1][j - 1] + s);
+                }
+            }
+            best = max(best, h[i][j] + (i + 1 == rows ? bonus : 0));
+        }
+    }
+    return best;
+}
+
+TEST_CASE("BatchPinnedScorer scores pinned alignments", "[aligner]") {
+
+    int8_t matrix[16];
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 4; j++) {
+            matrix[i * 4 + j] = i == j ? 1 : -4;
+        }
+    }
+    BatchPinnedScorer scorer(matrix, 6, 1, 5);
+
+    SECTION("Exact matches get the full length bonus") {
+        vector<int32_t> scores = scorer.score("GATTACA", {"GATTACA", "GATTACACCC", "GATT"});
+        REQUIRE(scores.size() == 3);
+        REQUIRE(scores[0] == 12);
+        REQUIRE(scores[1] == 12);
+        // Stopping at the end of the target is better than a gap
+        REQUIRE(scores[2] == 4);
+    }
+
+    SECTION("Hopeless alignments score 0") {
+        vector<int32_t> scores = scorer.score("AAAA", {"CCCC", ""});
+        REQUIRE(scores[0] == 0);
+        REQUIRE(scores[1] == 0);
+    }
+
+    SECTION("N scores as well as a match") {
+        vector<int32_t> scores = scorer.score("GANTACA", {"GATTACA"});
+        REQUIRE(scores[0] == 12);
+    }
+
+    SECTION("Many targets of different lengths agree with the full dynamic programming") {
+        default_random_engine generator(4321);
+        uniform_int_distribution<size_t> base_distribution(0, 3);
+        uniform_int_distribution<size_t> edit_distribution(0, 9);
+        uniform_int_distribution<size_t> length_distribution(0, 60);
+        const string bases = "ACGT";
+
+        string query;
+        for (size_t i = 0; i < 40; i++) {
+            query.push_back(bases[base_distribution(generator)]);
+        }
+
+        // Use more targets than lanes, so we need more than one batch
+        vector<string> targets;
+        for (size_t t = 0; t < 2 * BatchPinnedScorer::LANES + 3; t++) {
+            string target;
+            for (size_t i = 0; i < query.size(); i++) {
+                size_t edit = edit_distribution(generator);
+                if (edit == 0) {
+                    target.push_back(bases[base_distribution(generator)]);
+                } else if (edit == 1) {
+                    continue;
+                } else if (edit == 2) {
+                    target.push_back(bases[base_distribution(generator)]);
+                    target.push_back(query[i]);
+                } else {
+                    target.push_back(query[i]);
+                }
+            }
+            target.resize(min(target.size(), length_distribution(generator)));
+            targets.push_back(target);
+        }
+
+        vector<int32_t> scores = scorer.score(query, targets);
+        REQUIRE(scores.size() == targets.size());
+        for (size_t t = 0; t < targets.size(); t++) {
+            REQUIRE(scores[t] == slow_pinned_score(query, targets[t], matrix, 6, 1, 5));
+        }
+    }
+}
+
+}
+}
@@ -10,8 +10,11 @@
 #include "../vg.hpp"
 
 #include "catch.hpp"
+#include "randomness.hpp"
 
 #include <map>
+#include <random>
+#include <set>
 #include <unordered_set>
 #include <vector>
 
@@ -292,6 +295,59 @@ void check_haplotypes(const GaplessExtender& extender, const std::unordered_set<
     }
 }
 
+// Build a GBWTGraph for a linear graph with a single path over the given
+// node sequences, with node ids starting from 1.
+gbwtgraph::GBWTGraph build_linear_graph(const std::vector<std::string>& sequences, gbwt::GBWT& gbwt_index) {
+    bdsg::HashGraph graph;
+    gbwt::vector_type path;
+    for (size_t i = 0; i < sequences.size(); i++) {
+        nid_t id = i + 1;
+        graph.create_handle(sequences[i], id);
+        if (i > 0) {
+            graph.create_edge(graph.get_handle(id - 1, false), graph.get_handle(id, false));
+        }
+        path.push_back(static_cast<gbwt::vector_type::value_type>(gbwt::Node::encode(id, false)));
+    }
+    gbwt_index = get_gbwt({ path });
+    return gbwtgraph::GBWTGraph(gbwt_index, graph);
+}
+
+// Replace the bases at the given offsets with different bases.
+std::string with_mismatches(std::string sequence, const std::vector<size_t>& offsets) {
+    for (size_t offset : offsets) {
+        sequence[offset] = (sequence[offset] == 'A' ? 'C' : 'A');
+    }
+    return sequence;
+}
+
+// A pseudorandom ACGT sequence.
+std::string random_sequence(size_t length, std::mt19937& rng) {
+    std::uniform_int_distribution<size_t> base(0, 3);
+    std::string result(length, 'A');
+    for (char& c : result) {
+        c = "ACGT"[base(rng)];
+    }
+    return result;
+}
+
+// Extend a single seed.
+std::vector<GaplessExtension> extend_seed(const GaplessExtender& extender, pos_t pos, size_t read_offset, const std::string& read, size_t error_bound) {
+    GaplessExtender::cluster_type cluster;
+    cluster.insert(GaplessExtender::to_seed(pos, read_offset));
+    return extender.extend(cluster, read, nullptr, error_bound);
+}
+
+// Check that the extension is a full-length alignment with mismatches at the
+// given read positions.
+void full_length_mismatches(const std::vector<GaplessExtension>& result, const std::vector<size_t>& correct_positions) {
+    REQUIRE(result.size() == 1);
+    REQUIRE(result.front().full());
+    // internal_score comes from the vectorized comparison and
+    // mismatch_positions from a character-by-character one.
+    REQUIRE(result.front().internal_score == correct_positions.size());
+    REQUIRE(result.front().mismatch_positions == correct_positions);
+}
+
 } // anonymous namespace
 
 //------------------------------------------------------------------------------
@@ -880,6 +936,156 @@ TEST_CASE("Non-ACGT characters do not match", "[gapless_extender]") {
 
 //------------------------------------------------------------------------------
 
+TEST_CASE("Mismatch masks match character-by-character comparison", "[gapless_extender]") {
+
+    // Check both the kernel we would use and the portable one.
+    std::vector<bool> kernels { false, true };
+
+    SECTION("a single mismatch in each position of a block") {
+        std::string a(32, 'A');
+        for (bool portable_kernel : kernels) {
+            for (size_t i = 0; i < 32; i++) {
+                std::string b = with_mismatches(a, { i });
+                REQUIRE(gapless_mismatch_mask(a.data(), b.data(), 32, portable_kernel) == static_cast<std::uint32_t>(1) << i);
+            }
+        }
+    }
+
+    SECTION("mismatches past the end of a partial block are ignored") {
+        std::string a(32, 'C');
+        std::string b = with_mismatches(a, { 15, 16, 31 });
+        for (bool portable_kernel : kernels) {
+            REQUIRE(gapless_mismatch_mask(a.data(), b.data(), 0, portable_kernel) == 0);
+            REQUIRE(gapless_mismatch_mask(a.data(), b.data(), 15, portable_kernel) == 0);
+            REQUIRE(gapless_mismatch_mask(a.data(), b.data(), 16, portable_kernel) == static_cast<std::uint32_t>(1) << 15);
+            REQUIRE(gapless_mismatch_mask(a.data(), b.data(), 17, portable_kernel) == static_cast<std::uint32_t>(3) << 15);
+            REQUIRE(gapless_mismatch_mask(a.data(), b.data(), 31, portable_kernel) == static_cast<std::uint32_t>(3) << 15);
+        }
+    }
+
+    SECTION("random sequences") {
+        std::mt19937 rng(test_seed_source());
+        std::uniform_int_distribution<size_t> length(0, 32);
+        std::uniform_int_distribution<size_t> character(0, 5);
+        for (size_t trial = 0; trial < 1000; trial++) {
+            std::string a(32, 'A'), b(32, 'A');
+            for (size_t i = 0; i < 32; i++) {
+                a[i] = "ACGTNX"[character(rng)];
+                b[i] = (character(rng) < 4 ? a[i] : "ACGTNX"[character(rng)]);
+            }
+            size_t len = length(rng);
+            std::uint32_t correct = 0;
+            for (size_t i = 0; i < len; i++) {
+                if (a[i] != b[i]) {
+                    correct |= static_cast<std::uint32_t>(1) << i;
+                }
+            }
+            for (bool portable_kernel : kernels) {
+                REQUIRE(gapless_mismatch_mask(a.data(), b.data(), len, portable_kernel) == correct);
+            }
+        }
+    }
+}
+
+TEST_CASE("Mismatches are found across comparison blocks", "[gapless_extender]") {
+
+    // Sequences are compared 32 bases at a time, and the portable kernel does
+    // that in 16-base halves. Extending to the right compares blocks from the
+    // start of the node, and extending to the left from the end.
+    std::mt19937 rng(test_seed_source());
+    std::string seed_node = "GATT";
+    std::string long_node = random_sequence(100, rng);
+    Aligner aligner;
+
+    // Seed node 1 followed by the long node 2.
+    gbwt::GBWT forward_index;
+    gbwtgraph::GBWTGraph forward_graph = build_linear_graph({ seed_node, long_node }, forward_index);
+    GaplessExtender forward_extender(forward_graph, aligner);
+
+    // The long node 1 followed by seed node 2.
+    gbwt::GBWT backward_index;
+    gbwtgraph::GBWTGraph backward_graph = build_linear_graph({ long_node, seed_node }, backward_index);
+    GaplessExtender backward_extender(backward_graph, aligner);
+
+    SECTION("mismatches on both sides of block boundaries") {
+        size_t error_bound = 8;
+        // Blocks [0, 32), [32, 64), [64, 96), [96, 100)
+        std::vector<size_t> forward_offsets { 15, 16, 31, 32, 63, 64, 95, 96 };
+        std::string read = seed_node + with_mismatches(long_node, forward_offsets);
+        std::vector<size_t> correct_positions;
+        for (size_t offset : forward_offsets) {
+            correct_positions.push_back(seed_node.length() + offset);
+        }
+        full_length_mismatches(extend_seed(forward_extender, make_pos_t(1, false, 0), 0, read, error_bound), correct_positions);
+
+        // Blocks [68, 100), [36, 68), [4, 36), [0, 4)
+        std::vector<size_t> backward_offsets { 3, 4, 35, 36, 67, 68, 83, 84 };
+        read = with_mismatches(long_node, backward_offsets) + seed_node;
+        full_length_mismatches(extend_seed(backward_extender, make_pos_t(2, false, 0), long_node.length(), read, error_bound), backward_offsets);
+    }
+
+    SECTION("mismatch limit reached at a block boundary") {
+        // With the seed matching exactly, the extension stops before the
+        // fifth mismatch in the long node. The earlier ones are far enough
+        // that trimming only moves the other end of the extension.
+        size_t error_bound = 4;
+        for (size_t limit_offset : { 15, 16, 31, 32, 63, 64 }) {
+            std::string read = seed_node + with_mismatches(long_node, { 0, 1, 2, 3, limit_offset });
+            auto result = extend_seed(forward_extender, make_pos_t(1, false, 0), 0, read, error_bound);
+            REQUIRE(result.size() == 1);
+            REQUIRE(!result.front().full());
+            REQUIRE(result.front().read_interval.second == seed_node.length() + limit_offset);
+        }
+        for (size_t limit_offset : { 84, 83, 68, 67, 36, 35 }) {
+            std::string read = with_mismatches(long_node, { 99, 98, 97, 96, limit_offset }) + seed_node;
+            auto result = extend_seed(backward_extender, make_pos_t(2, false, 0), long_node.length(), read, error_bound);
+            REQUIRE(result.size() == 1);
+            REQUIRE(!result.front().full());
+            REQUIRE(result.front().read_interval.first == limit_offset + 1);
+        }
+    }
+
+    SECTION("Ns at block boundaries do not match") {
+        // Ns in the node and the read never match, not even each other.
+        std::string n_node = long_node;
+        n_node[16] = 'N';
+        n_node[32] = 'N';
+        gbwt::GBWT n_index;
+        gbwtgraph::GBWTGraph n_graph = build_linear_graph({ seed_node, n_node }, n_index);
+        GaplessExtender n_extender(n_graph, aligner);
+
+        std::string read = seed_node + n_node;
+        read[seed_node.length() + 31] = 'N';
+        size_t error_bound = 4;
+        full_length_mismatches(extend_seed(n_extender, make_pos_t(1, false, 0), 0, read, error_bound),
+                               { seed_node.length() + 16, seed_node.length() + 31, seed_node.length() + 32 });
+    }
+
+    SECTION("random mismatches") {
+        size_t error_bound = 8;
+        std::uniform_int_distribution<size_t> mismatch_count(0, error_bound);
+        std::uniform_int_distribution<size_t> offset(0, long_node.length() - 1);
+        for (size_t trial = 0; trial < 100; trial++) {
+            std::set<size_t> offsets;
+            size_t count = mismatch_count(rng);
+            while (offsets.size() < count) {
+                offsets.insert(offset(rng));
+            }
+            std::vector<size_t> sorted_offsets(offsets.begin(), offsets.end());
+            std::string mutated = with_mismatches(long_node, sorted_offsets);
+
+            std::vector<size_t> correct_positions;
+            for (size_t offset : sorted_offsets) {
+                correct_positions.push_back(seed_node.length() + offset);
+            }
+            full_length_mismatches(extend_seed(forward_extender, make_pos_t(1, false, 0), 0, seed_node + mutated, error_bound), correct_positions);
+            full_length_mismatches(extend_seed(backward_extender, make_pos_t(2, false, 0), long_node.length(), mutated + seed_node, error_bound), sorted_offsets);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
 TEST_CASE("Haplotype unfolding", "[gapless_extender]") {
 
     // Build a GBWT with three threads including a duplicate.
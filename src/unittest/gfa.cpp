@@ -3,6 +3,7 @@
 #include "../xg.hpp"
 #include "../gfa.hpp"
 #include "../algorithms/gfa_to_handle.hpp"
+#include "../utility.hpp"
 
 #include <bdsg/hash_graph.hpp>
 
@@ -384,7 +385,243 @@ L	1	+	0	+	0M)";
 
 }
 
+// Make sure the graphs have the same nodes, edges, and paths, with the same IDs
+static void require_same_graph(const PathHandleGraph& graph, const PathHandleGraph& expected) {
+    REQUIRE(graph.get_node_count() == expected.get_node_count());
+    REQUIRE(graph.get_edge_count() == expected.get_edge_count());
+    expected.for_each_handle([&](const handle_t& handle) {
+        nid_t id = expected.get_id(handle);
+        REQUIRE(graph.has_node(id));
+        REQUIRE(graph.get_sequence(graph.get_handle(id)) == expected.get_sequence(handle));
+    });
+    expected.for_each_edge([&](const edge_t& edge) {
+        REQUIRE(graph.has_edge(graph.get_handle(expected.get_id(edge.first), expected.get_is_reverse(edge.first)),
+                               graph.get_handle(expected.get_id(edge.second), expected.get_is_reverse(edge.second))));
+    });
+    
+    REQUIRE(graph.get_path_count() == expected.get_path_count());
+    expected.for_each_path_handle([&](const path_handle_t& expected_path) {
+        string path_name = expected.get_path_name(expected_path);
+        REQUIRE(graph.has_path(path_name));
+        path_handle_t path = graph.get_path_handle(path_name);
+        REQUIRE(graph.get_step_count(path) == expected.get_step_count(expected_path));
+        step_handle_t step = graph.path_begin(path);
+        expected.for_each_step_in_path(expected_path, [&](const step_handle_t& expected_step) {
+            handle_t expected_handle = expected.get_handle_of_step(expected_step);
+            handle_t handle = graph.get_handle_of_step(step);
+            REQUIRE(graph.get_id(handle) == expected.get_id(expected_handle));
+            REQUIRE(graph.get_is_reverse(handle) == expected.get_is_reverse(expected_handle));
+            step = graph.get_next_step(step);
+        });
+    });
+}
+
+TEST_CASE("Can import a GFA file from disk in parallel", "[gfa]") {
 
+    SECTION("Nodes, edges, and paths match the in-memory loader") {
+        const string graph_gfa = R"(H	VN:Z:1.0
+S	1	GATT
+L	1	+	2	-	0M
+S	2	ACA
+S	3	CC
+L	2	-	3	+	*
+P	x	1+,2-,3+	*
+P	y	3-,2+	*
+)";
+        
+        string gfa_filename = temp_file::create();
+        ofstream out(gfa_filename);
+        out << graph_gfa;
+        out.close();
+        
+        bdsg::HashGraph from_disk;
+        algorithms::gfa_to_path_handle_graph(gfa_filename, &from_disk);
+        temp_file::remove(gfa_filename);
+        
+        bdsg::HashGraph in_memory;
+        stringstream in(graph_gfa);
+        algorithms::gfa_to_path_handle_graph_in_memory(in, &in_memory);
+        
+        REQUIRE(from_disk.get_node_count() == in_memory.get_node_count());
+        REQUIRE(from_disk.get_edge_count() == in_memory.get_edge_count());
+        for (nid_t id = 1; id <= 3; id++) {
+            REQUIRE(from_disk.get_sequence(from_disk.get_handle(id)) == in_memory.get_sequence(in_memory.get_handle(id)));
+        }
+        REQUIRE(from_disk.has_edge(from_disk.get_handle(1), from_disk.get_handle(2, true)));
+        REQUIRE(from_disk.has_edge(from_disk.get_handle(2, true), from_disk.get_handle(3)));
+        
+        for (const string& path_name : {"x", "y"}) {
+            REQUIRE(from_disk.has_path(path_name));
+            vector<handle_t> disk_steps;
+            from_disk.for_each_step_in_path(from_disk.get_path_handle(path_name), [&](const step_handle_t& step) {
+                disk_steps.push_back(from_disk.get_handle_of_step(step));
+            });
+            vector<handle_t> memory_steps;
+            in_memory.for_each_step_in_path(in_memory.get_path_handle(path_name), [&](const step_handle_t& step) {
+                memory_steps.push_back(in_memory.get_handle_of_step(step));
+            });
+            REQUIRE(disk_steps.size() == memory_steps.size());
+            for (size_t i = 0; i < disk_steps.size(); i++) {
+                REQUIRE(from_disk.get_id(disk_steps[i]) == in_memory.get_id(memory_steps[i]));
+                REQUIRE(from_disk.get_is_reverse(disk_steps[i]) == in_memory.get_is_reverse(memory_steps[i]));
+            }
+        }
+    }
+    
+    SECTION("Non-numeric names are numbered in file order") {
+        const string graph_gfa = R"(S	Chana	GATT
+S	1	ACA
+L	Chana	+	1	+	0M
+)";
+        
+        string gfa_filename = temp_file::create();
+        ofstream out(gfa_filename);
+        out << graph_gfa;
+        out.close();
+        
+        bdsg::HashGraph graph;
+        algorithms::gfa_to_path_handle_graph(gfa_filename, &graph);
+        temp_file::remove(gfa_filename);
+        
+        REQUIRE(graph.get_node_count() == 2);
+        REQUIRE(graph.get_sequence(graph.get_handle(1)) == "GATT");
+        REQUIRE(graph.get_sequence(graph.get_handle(2)) == "ACA");
+        REQUIRE(graph.has_edge(graph.get_handle(1), graph.get_handle(2)));
+    }
+    
+    SECTION("Edges to missing segments are rejected with GFAFormatError") {
+        const string graph_gfa = R"(S	1	GATT
+L	1	+	2	+	0M
+)";
+        
+        string gfa_filename = temp_file::create();
+        ofstream out(gfa_filename);
+        out << graph_gfa;
+        out.close();
+        
+        bdsg::HashGraph graph;
+        REQUIRE_THROWS_AS(algorithms::gfa_to_path_handle_graph(gfa_filename, &graph), algorithms::GFAFormatError);
+        temp_file::remove(gfa_filename);
+    }
+    
+    SECTION("Blocks of a few bytes give the same graph as the default block size") {
+        // Lines longer than the blocks, lines spanning block boundaries, and
+        // a P line long enough to be split into pieces at commas
+        stringstream gfa;
+        gfa << "H\tVN:Z:1.0\n";
+        for (nid_t id = 1; id <= 30; id++) {
+            gfa << "S\t" << id << "\t" << string(id % 7 + 1, "ACGT"[id % 4]) << "\n";
+            if (id > 1) {
+                gfa << "L\t" << id - 1 << "\t+\t" << id << "\t" << (id % 3 ? "+" : "-") << "\t0M\n";
+            }
+        }
+        gfa << "P\tlong";
+        for (nid_t id = 1; id <= 30; id++) {
+            gfa << (id == 1 ? "\t" : ",") << id << (id % 3 ? "+" : "-");
+        }
+        gfa << "\t*\n";
+        gfa << "P\tshort\t5-,4-\t*\n";
+        gfa << "P\tempty\t*\t*\n";
+        
+        string gfa_filename = temp_file::create();
+        ofstream out(gfa_filename);
+        out << gfa.str();
+        out.close();
+        
+        bdsg::HashGraph expected;
+        algorithms::gfa_to_path_handle_graph(gfa_filename, &expected);
+        
+        for (size_t block_size : {1, 2, 5, 16, 64, 200}) {
+            bdsg::HashGraph graph;
+            algorithms::gfa_to_path_handle_graph(gfa_filename, &graph, true, false,
+                                                 numeric_limits<int64_t>::max(), "", block_size);
+            
+            require_same_graph(graph, expected);
+        }
+        temp_file::remove(gfa_filename);
+        
+        REQUIRE(expected.get_node_count() == 30);
+        REQUIRE(expected.get_step_count(expected.get_path_handle("long")) == 30);
+    }
+    
+    SECTION("Names get the same IDs as in the sequential loader") {
+        // Zero-padded and unpadded versions of the same number are different
+        // names once a non-numeric name has been seen, 19-digit numbers are
+        // still numbers, and numbers too big for an ID are names.
+        vector<string> graph_gfas {
+            R"(S	007	GATT
+S	12	ACA
+S	Chana	CC
+S	7	T
+S	0012	G
+S	12x	A
+L	007	+	Chana	+	0M
+L	12	+	007	-	0M
+L	7	+	0012	+	0M
+L	0012	-	12x	+	0M
+P	x	007+,Chana+,7-,0012+	*
+)",
+            R"(S	1000000000000000000	GATT
+S	0002	ACA
+S	1000000000000000001	C
+S	99999999999999999999	T
+L	1000000000000000000	+	0002	+	0M
+L	0002	+	1000000000000000001	+	0M
+L	1000000000000000001	+	99999999999999999999	-	0M
+)"
+        };
+        
+        for (const string& graph_gfa : graph_gfas) {
+            string gfa_filename = temp_file::create();
+            ofstream out(gfa_filename);
+            out << graph_gfa;
+            out.close();
+            
+            // The streaming loader works line by line in file order
+            bdsg::HashGraph sequential;
+            ifstream in(gfa_filename);
+            algorithms::gfa_to_path_handle_graph_stream(in, &sequential);
+            
+            for (size_t block_size : {(size_t) 4, algorithms::DEFAULT_GFA_BLOCK_SIZE}) {
+                bdsg::HashGraph parallel;
+                algorithms::gfa_to_path_handle_graph(gfa_filename, &parallel, true, false,
+                                                     numeric_limits<int64_t>::max(), "", block_size);
+                require_same_graph(parallel, sequential);
+            }
+            temp_file::remove(gfa_filename);
+        }
+    }
+    
+    SECTION("Zero-padded numeric names can still be found after a non-numeric name") {
+        const string graph_gfa = R"(S	007	GATT
+S	2	ACA
+S	Chana	CC
+L	007	+	Chana	+	0M
+L	2	+	007	-	0M
+P	x	007+,Chana+	*
+)";
+        
+        string gfa_filename = temp_file::create();
+        ofstream out(gfa_filename);
+        out << graph_gfa;
+        out.close();
+        
+        for (size_t block_size : {(size_t) 4, algorithms::DEFAULT_GFA_BLOCK_SIZE}) {
+            bdsg::HashGraph graph;
+            algorithms::gfa_to_path_handle_graph(gfa_filename, &graph, true, false,
+                                                 numeric_limits<int64_t>::max(), "", block_size);
+            
+            REQUIRE(graph.get_node_count() == 3);
+            REQUIRE(graph.get_sequence(graph.get_handle(7)) == "GATT");
+            REQUIRE(graph.get_sequence(graph.get_handle(2)) == "ACA");
+            REQUIRE(graph.get_sequence(graph.get_handle(8)) == "CC");
+            REQUIRE(graph.has_edge(graph.get_handle(7), graph.get_handle(8)));
+            REQUIRE(graph.has_edge(graph.get_handle(2), graph.get_handle(7, true)));
+            REQUIRE(graph.get_step_count(graph.get_path_handle("x")) == 2);
+        }
+        temp_file::remove(gfa_filename);
+    }
+}
         
 }
 }
@@ -0,0 +1,196 @@
+/// \file hts_alignment_emitter.cpp
+///
+/// Unit tests for writing HTSlib formats
+///
+
+#include "../hts_alignment_emitter.hpp"
+#include "../utility.hpp"
+#include "randomness.hpp"
+#include "catch.hpp"
+
+#include <htslib/kstring.h>
+#include <unistd.h>
+
+#include <random>
+#include <sstream>
+#include <tuple>
+
+namespace vg {
+namespace unittest {
+using namespace std;
+
+// expose the parts of HTSWriter that emitters use
+class TestHTSWriter : public HTSWriter {
+public:
+    using HTSWriter::HTSWriter;
+    using HTSWriter::ensure_header;
+    using HTSWriter::save_records;
+
+    void set_max_sort_fan_in(size_t fan_in) {
+        max_sort_fan_in = fan_in;
+    }
+
+    void set_pool_flush_bytes(size_t bytes) {
+        pool_flush_bytes = bytes;
+    }
+};
+
+// make a BAM record from a line of SAM
+static bam1_t* parse_record(const string& line, bam_hdr_t* header) {
+    bam1_t* b = bam_init1();
+    kstring_t str = {0, 0, nullptr};
+    kputs(line.c_str(), &str);
+    REQUIRE(sam_parse1(&str, header, b) >= 0);
+    free(str.s);
+    return b;
+}
+
+TEST_CASE("HTSWriter can sort output that doesn't fit in memory", "[hts][sort]") {
+
+    string bam_filename = temp_file::create();
+    string index_filename = bam_filename + ".bai";
+
+    size_t num_records = 2000;
+    size_t batch_size = 5;
+    // keep (path, 0-based position) of the mapped records
+    vector<pair<string, int64_t>> placements;
+
+    {
+        TestHTSWriter writer(bam_filename, "BAM", {{"x", 100000}, {"y", 50000}}, 1);
+        // a budget this small makes every batch its own temp file, and a
+        // small fan-in makes us merge them in several rounds
+        writer.set_sorted_output(1, index_filename);
+        writer.set_max_sort_fan_in(4);
+
+        bam_hdr_t* header = writer.ensure_header("", "", 0);
+
+        default_random_engine gen(test_seed_source());
+        uniform_int_distribution<int64_t> x_pos(0, 100000 - 10);
+        uniform_int_distribution<int64_t> y_pos(0, 50000 - 10);
+        uniform_int_distribution<int> kind(0, 9);
+
+        vector<bam1_t*> batch;
+        for (size_t i = 0; i < num_records; ++i) {
+            stringstream line;
+            int k = kind(gen);
+            if (k == 0) {
+                // unplaced, which sorts last
+                line << "r" << i << "\t4\t*\t0\t0\t*\t*\t0\t0\tACGTACGTAC\t*";
+            } else {
+                string path = k < 6 ? "x" : "y";
+                int64_t pos = path == "x" ? x_pos(gen) : y_pos(gen);
+                placements.emplace_back(path, pos);
+                line << "r" << i << "\t" << (k % 2 ? 16 : 0) << "\t" << path << "\t" << pos + 1
+                     << "\t60\t10M\t*\t0\t0\tACGTACGTAC\t*";
+            }
+            batch.push_back(parse_record(line.str(), header));
+            if (batch.size() == batch_size) {
+                writer.save_records(header, batch, 0);
+                batch.clear();
+            }
+        }
+        writer.save_records(header, batch, 0);
+        // destroying the writer merges and writes everything
+    }
+
+    samFile* in = sam_open(bam_filename.c_str(), "r");
+    REQUIRE(in != nullptr);
+    bam_hdr_t* header = sam_hdr_read(in);
+    REQUIRE(header != nullptr);
+
+    SECTION("The header declares the sort order") {
+        REQUIRE(string(header->text).find("@HD\tVN:1.5\tSO:coordinate") == 0);
+    }
+
+    SECTION("All the records come out in coordinate order") {
+        bam1_t* b = bam_init1();
+        size_t count = 0;
+        tuple<uint32_t, int64_t, bool> last_key(0, -1, false);
+        while (sam_read1(in, header, b) >= 0) {
+            tuple<uint32_t, int64_t, bool> key((uint32_t) b->core.tid, b->core.pos, bam_is_rev(b));
+            REQUIRE(last_key <= key);
+            last_key = key;
+            ++count;
+        }
+        bam_destroy1(b);
+        REQUIRE(count == num_records);
+    }
+
+    SECTION("The index can find records in a region") {
+        hts_idx_t* index = sam_index_load(in, bam_filename.c_str());
+        REQUIRE(index != nullptr);
+
+        // 0-based half-open [999, 2000)
+        size_t expected = 0;
+        for (auto& placement : placements) {
+            if (placement.first == "x" && placement.second + 10 > 999 && placement.second < 2000) {
+                ++expected;
+            }
+        }
+
+        hts_itr_t* iter = sam_itr_querys(index, header, "x:1000-2000");
+        REQUIRE(iter != nullptr);
+        bam1_t* b = bam_init1();
+        size_t found = 0;
+        while (sam_itr_next(in, iter, b) >= 0) {
+            ++found;
+        }
+        bam_destroy1(b);
+        hts_itr_destroy(iter);
+        hts_idx_destroy(index);
+
+        REQUIRE(found == expected);
+    }
+
+    bam_hdr_destroy(header);
+    sam_close(in);
+    temp_file::remove(bam_filename);
+    unlink(index_filename.c_str());
+}
+
+TEST_CASE("HTSWriter can compress one-record batches on a thread pool", "[hts]") {
+
+    string bam_filename = temp_file::create();
+
+    size_t num_records = 2000;
+
+    {
+        TestHTSWriter writer(bam_filename, "BAM", {{"x", 100000}}, 1, 2);
+        // flush every few records, so the writer checks for breakpoints many
+        // times
+        writer.set_pool_flush_bytes(1000);
+
+        bam_hdr_t* header = writer.ensure_header("", "", 0);
+
+        vector<bam1_t*> batch;
+        for (size_t i = 0; i < num_records; ++i) {
+            stringstream line;
+            line << "r" << i << "\t0\tx\t" << i + 1 << "\t60\t10M\t*\t0\t0\tACGTACGTAC\t*";
+            batch.push_back(parse_record(line.str(), header));
+            writer.save_records(header, batch, 0);
+            batch.clear();
+        }
+    }
+
+    samFile* in = sam_open(bam_filename.c_str(), "r");
+    REQUIRE(in != nullptr);
+    bam_hdr_t* header = sam_hdr_read(in);
+    REQUIRE(header != nullptr);
+
+    // one thread made all the batches, so they come out in order
+    bam1_t* b = bam_init1();
+    size_t count = 0;
+    while (sam_read1(in, header, b) >= 0) {
+        REQUIRE(string(bam_get_qname(b)) == "r" + to_string(count));
+        ++count;
+    }
+    bam_destroy1(b);
+    REQUIRE(count == num_records);
+
+    bam_hdr_destroy(header);
+    sam_close(in);
+    temp_file::remove(bam_filename);
+}
+
+}
+}
@@ -3,6 +3,11 @@
 /// unit tests for the vg-file-backed handle graph implementation
 
 #include <iostream>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <omp.h>
 #include "../index_registry.hpp"
 #include "catch.hpp"
 
@@ -277,5 +282,118 @@ TEST_CASE("IndexRegistry can make plans on a dummy recipe graph", "[indexregistr
 //    }
 }
 
+TEST_CASE("IndexRegistry passes along a recipe's failure once the other running recipes finish", "[indexregistry]") {
+    
+    int thread_count = omp_get_max_threads();
+    omp_set_num_threads(2);
+    
+    IndexRegistry registry;
+    registry.register_index("Input", "input");
+    registry.register_index("Slow", "slow");
+    registry.register_index("Failing", "failing");
+    
+    atomic<bool> failing_started(false);
+    atomic<bool> slow_finished(false);
+    
+    // each recipe only wants one thread, so they can run at the same time
+    registry.register_recipe({"Slow"}, {"Input"},
+                             [&] (const vector<const IndexFile*>& inputs,
+                                  const IndexingPlan* plan,
+                                  AliasGraph& alias_graph,
+                                  const IndexGroup& constructing) {
+        // make sure the other recipe fails while this one is still running
+        for (size_t i = 0; i < 100 && !failing_started.load(); ++i) {
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+        this_thread::sleep_for(chrono::milliseconds(100));
+        slow_finished.store(true);
+        return vector<vector<string>>(1, vector<string>(1, "slow-file"));
+    }, 1);
+    registry.register_recipe({"Failing"}, {"Input"},
+                             [&] (const vector<const IndexFile*>& inputs,
+                                  const IndexingPlan* plan,
+                                  AliasGraph& alias_graph,
+                                  const IndexGroup& constructing) -> vector<vector<string>> {
+        failing_started.store(true);
+        throw runtime_error("recipe failed");
+    }, 1);
+    
+    registry.provide("Input", "input-name");
+    
+    bool caught = false;
+    try {
+        registry.make_indexes({"Slow", "Failing"});
+    }
+    catch (runtime_error& ex) {
+        caught = true;
+        REQUIRE(string(ex.what()) == "recipe failed");
+    }
+    
+    omp_set_num_threads(thread_count);
+    
+    REQUIRE(caught);
+    REQUIRE(failing_started.load());
+    REQUIRE(slow_finished.load());
+}
+
+TEST_CASE("IndexRegistry only runs recipes at the same time if their memory fits", "[indexregistry]") {
+    
+    int thread_count = omp_get_max_threads();
+    omp_set_num_threads(2);
+    
+    IndexRegistry registry;
+    registry.register_index("Input", "input");
+    registry.register_index("First", "first");
+    registry.register_index("Second", "second");
+    
+    // 1 TB, of which the recipes get to use 750 GB
+    int64_t gigabyte = 1024 * 1024 * 1024;
+    registry.set_target_memory_usage(1024 * gigabyte);
+    
+    atomic<int> running(0);
+    atomic<int> max_running(0);
+    int64_t recipe_memory = 0;
+    
+    auto recipe = [&] (const vector<const IndexFile*>& inputs,
+                       const IndexingPlan* plan,
+                       AliasGraph& alias_graph,
+                       const IndexGroup& constructing) {
+        int now = ++running;
+        int most = max_running.load();
+        while (now > most && !max_running.compare_exchange_weak(most, now)) {
+            // try again
+        }
+        // give the other recipe a chance to start alongside this one
+        for (size_t i = 0; i < 50 && max_running.load() < 2; ++i) {
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+        --running;
+        return vector<vector<string>>(1, vector<string>(1, *constructing.begin() + "-file"));
+    };
+    auto estimate = [&] (const vector<const IndexFile*>& inputs) {
+        return recipe_memory;
+    };
+    
+    // each recipe only wants one thread, so only memory can keep them apart
+    registry.register_recipe({"First"}, {"Input"}, recipe, 1, estimate);
+    registry.register_recipe({"Second"}, {"Input"}, recipe, 1, estimate);
+    
+    registry.provide("Input", "input-name");
+    
+    SECTION("Recipes that fit together run at the same time") {
+        recipe_memory = 300 * gigabyte;
+        registry.make_indexes({"First", "Second"});
+        REQUIRE(max_running.load() == 2);
+    }
+    
+    SECTION("Recipes that don't fit together run one at a time") {
+        recipe_memory = 500 * gigabyte;
+        registry.make_indexes({"First", "Second"});
+        REQUIRE(max_running.load() == 1);
+    }
+    
+    omp_set_num_threads(thread_count);
+}
+
 }
 }
@@ -0,0 +1,157 @@
+///
+/// \file job_schedule.cpp
+///
+/// Unit tests for JobSchedule
+///
+
+#include "catch.hpp"
+#include "../job_schedule.hpp"
+
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <omp.h>
+
+namespace vg {
+namespace unittest {
+
+using namespace std;
+
+TEST_CASE("JobSchedule runs every job exactly once", "[jobs]") {
+
+    vector<pair<int64_t, int64_t>> requirements;
+    for (int64_t i = 0; i < 50; i++) {
+        requirements.emplace_back(i % 7, (i % 5) * 1024 * 1024);
+    }
+    
+    mutex run_lock;
+    vector<int64_t> times_run(requirements.size(), 0);
+    JobSchedule schedule(requirements, [&](int64_t i) {
+        lock_guard<mutex> guard(run_lock);
+        times_run[i]++;
+    });
+    
+    // even with a budget too small for any one job
+    schedule.execute(1);
+    
+    for (auto count : times_run) {
+        REQUIRE(count == 1);
+    }
+}
+
+TEST_CASE("JobSchedule starts higher priority jobs first", "[jobs]") {
+
+    int thread_count = omp_get_max_threads();
+    omp_set_num_threads(1);
+    
+    vector<pair<int64_t, int64_t>> requirements{{1, 0}, {5, 0}, {3, 0}, {2, 0}, {4, 0}};
+    vector<int64_t> priorities{0, 0, 1, 0, 1};
+    
+    vector<int64_t> order;
+    JobSchedule schedule(requirements, [&](int64_t i) {
+        order.push_back(i);
+    }, priorities);
+    schedule.execute(numeric_limits<int64_t>::max());
+    
+    omp_set_num_threads(thread_count);
+    
+    // by priority, and then longest first
+    REQUIRE(order == vector<int64_t>{4, 2, 1, 3, 0});
+}
+
+// get the memory scale column of each job in a schedule's trace
+static vector<double> traced_memory_scales(const string& trace) {
+    vector<double> scales;
+    stringstream lines(trace);
+    string line;
+    while (getline(lines, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        stringstream fields(line);
+        string field;
+        for (size_t i = 0; i < 7; ++i) {
+            getline(fields, field, '\t');
+        }
+        scales.push_back(stod(field));
+    }
+    return scales;
+}
+
+TEST_CASE("JobSchedule learns how far off its memory estimates are", "[jobs]") {
+
+    int thread_count = omp_get_max_threads();
+    omp_set_num_threads(1);
+    
+    int64_t baseline = 1024 * 1024;
+    atomic<int64_t> rss(baseline);
+    
+    // each job estimates 1000 bytes, and the longest jobs go first
+    vector<pair<int64_t, int64_t>> requirements{{3, 1000}, {2, 1000}, {1, 1000}};
+    // how much memory each job actually uses above the baseline
+    vector<int64_t> real_usage{0, 3000, 100000};
+    
+    stringstream trace;
+    JobSchedule schedule(requirements, [&](int64_t i) {
+        rss.store(baseline + real_usage[i]);
+    });
+    schedule.set_rss_source([&]() { return rss.load(); });
+    schedule.set_trace(&trace);
+    
+    SECTION("The scale is the mean of each job's ratio, clamped to a reasonable range") {
+        schedule.execute(numeric_limits<int64_t>::max());
+        
+        vector<double> scales = traced_memory_scales(trace.str());
+        REQUIRE(scales.size() == 3);
+        REQUIRE(scales[0] == Approx(0.1));
+        REQUIRE(scales[1] == Approx((0.1 + 3.0) / 2.0));
+        REQUIRE(scales[2] == Approx((0.1 + 3.0 + 10.0) / 3.0));
+    }
+    
+    SECTION("Nothing is learned if memory can't be measured") {
+        schedule.set_rss_source([]() { return int64_t(0); });
+        schedule.execute(numeric_limits<int64_t>::max());
+        
+        vector<double> scales = traced_memory_scales(trace.str());
+        REQUIRE(scales == vector<double>{1.0, 1.0, 1.0});
+    }
+    
+    omp_set_num_threads(thread_count);
+}
+
+TEST_CASE("JobSchedule doesn't learn from jobs that ran while memory couldn't be measured", "[jobs]") {
+
+    int thread_count = omp_get_max_threads();
+    omp_set_num_threads(1);
+    
+    int64_t baseline = 1024 * 1024;
+    atomic<int64_t> rss(baseline);
+    atomic<int64_t> current_job(-1);
+    
+    vector<pair<int64_t, int64_t>> requirements{{4, 1000}, {3, 1000}, {2, 1000}, {1, 1000}};
+    vector<int64_t> real_usage{2000, 3000, 5000, 4000};
+    
+    stringstream trace;
+    JobSchedule schedule(requirements, [&](int64_t i) {
+        current_job.store(i);
+        rss.store(baseline + real_usage[i]);
+    });
+    // pretend something else is using memory while job 1 runs, which it
+    // is still counted as doing until the next job starts
+    schedule.set_rss_source([&]() { return current_job.load() == 1 ? int64_t(0) : rss.load(); });
+    schedule.set_trace(&trace);
+    schedule.execute(numeric_limits<int64_t>::max());
+    
+    vector<double> scales = traced_memory_scales(trace.str());
+    REQUIRE(scales.size() == 4);
+    REQUIRE(scales[0] == Approx(2.0));
+    REQUIRE(scales[1] == Approx(2.0));
+    REQUIRE(scales[2] == Approx(2.0));
+    REQUIRE(scales[3] == Approx((2.0 + 4.0) / 2.0));
+    
+    omp_set_num_threads(thread_count);
+}
+
+}
+}
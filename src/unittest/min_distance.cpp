@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <set>
 #include "vg/io/json2pb.h"
 #include "../vg.hpp"
@@ -10,12 +12,14 @@
 #include "../cactus_snarl_finder.hpp"
 #include "../position.hpp"
 #include "../min_distance.hpp"
+#include "../utility.hpp"
 #include "../genotypekit.hpp"
 #include "random_graph.hpp"
 #include "randomness.hpp"
 #include <fstream>
 #include <random>
 #include <time.h> 
+#include <omp.h>
 
 //#define print
 
@@ -1094,6 +1098,21 @@ int64_t min_distance(VG* graph, pos_t pos1, pos_t pos2){
             REQUIRE (std::get<7>(di.get_minimizer_distances(make_pos_t(6 , false, 0)))== 1 );
             REQUIRE (std::get<7>(di.get_minimizer_distances(make_pos_t(7 , false, 0)))== 1 );
         }
+
+        SECTION ("Components built in parallel give the same index as one thread") {
+            int thread_count = omp_get_max_threads();
+            omp_set_num_threads(1);
+            MinimumDistanceIndex serial_di (&graph, &snarl_manager);
+            omp_set_num_threads(max(thread_count, 4));
+            MinimumDistanceIndex parallel_di (&graph, &snarl_manager);
+            omp_set_num_threads(thread_count);
+
+            stringstream serial_out;
+            serial_di.serialize(serial_out);
+            stringstream parallel_out;
+            parallel_di.serialize(parallel_out);
+            REQUIRE(serial_out.str() == parallel_out.str());
+        }
  
     }
     TEST_CASE( "Get connected component and length of root chains in nested graph",
@@ -1551,6 +1570,124 @@ int64_t min_distance(VG* graph, pos_t pos1, pos_t pos2){
              
         }
     } //end test case
+
+    TEST_CASE("Flat distance index layout", "[min_dist][serial]") {
+        VG graph;
+
+        Node* n1 = graph.create_node("GCA");
+        Node* n2 = graph.create_node("T");
+        Node* n3 = graph.create_node("G");
+        Node* n4 = graph.create_node("CTGA");
+        Node* n5 = graph.create_node("GCA");
+        Node* n6 = graph.create_node("T");
+        Node* n7 = graph.create_node("G");
+        Node* n8 = graph.create_node("CTGA");
+
+        Edge* e1 = graph.create_edge(n1, n2);
+        Edge* e2 = graph.create_edge(n1, n8);
+        Edge* e3 = graph.create_edge(n2, n3);
+        Edge* e4 = graph.create_edge(n2, n6);
+        Edge* e5 = graph.create_edge(n3, n4);
+        Edge* e6 = graph.create_edge(n3, n5);
+        Edge* e7 = graph.create_edge(n4, n5);
+        Edge* e8 = graph.create_edge(n5, n7);
+        Edge* e9 = graph.create_edge(n6, n7);
+        Edge* e10 = graph.create_edge(n7, n8);
+
+        CactusSnarlFinder bubble_finder(graph);
+        SnarlManager snarl_manager = bubble_finder.find_snarls(); 
+
+        MinimumDistanceIndex di (&graph, &snarl_manager, 20);
+        di.set_flat_layout(true);
+
+        stringstream flat;
+        di.serialize(flat);
+        string flat_bytes = flat.str();
+
+        MinimumDistanceIndex flat_di (flat);
+        REQUIRE(flat_di.is_flat_layout());
+
+        SECTION( "Flat index gives the same distances" ) {
+            for (id_t id1 = 1 ; id1 <= 8 ; id1++) {
+                for (id_t id2 = 1 ; id2 <= 8 ; id2++) {
+                    for (bool rev1 : {false, true}) {
+                        for (bool rev2 : {false, true}) {
+                            pos_t pos1 = make_pos_t(id1, rev1, 0);
+                            pos_t pos2 = make_pos_t(id2, rev2, 0);
+                            REQUIRE(flat_di.min_distance(pos1, pos2) == di.min_distance(pos1, pos2));
+                            REQUIRE(flat_di.max_distance(pos1, pos2) == di.max_distance(pos1, pos2));
+                        }
+                    }
+                }
+                REQUIRE(flat_di.get_minimizer_distances(make_pos_t(id1, false, 0)) == 
+                        di.get_minimizer_distances(make_pos_t(id1, false, 0)));
+            }
+        }
+
+        SECTION( "Flat index serializes back to the same bytes" ) {
+            stringstream again;
+            flat_di.serialize(again);
+            REQUIRE(again.str() == flat_bytes);
+        }
+
+        SECTION( "Flat index can be memory-mapped from a file" ) {
+            string filename = temp_file::create();
+            {
+                ofstream out(filename);
+                out << flat_bytes;
+            }
+
+            MinimumDistanceIndex mapped_di;
+            REQUIRE(mapped_di.load_mapped(filename));
+            REQUIRE(mapped_di.is_flat_layout());
+            for (id_t id1 = 1 ; id1 <= 8 ; id1++) {
+                for (id_t id2 = 1 ; id2 <= 8 ; id2++) {
+                    pos_t pos1 = make_pos_t(id1, false, 0);
+                    pos_t pos2 = make_pos_t(id2, true, 0);
+                    REQUIRE(mapped_di.min_distance(pos1, pos2) == di.min_distance(pos1, pos2));
+                    REQUIRE(mapped_di.max_distance(pos1, pos2) == di.max_distance(pos1, pos2));
+                }
+            }
+            temp_file::remove(filename);
+        }
+
+        SECTION( "Only flat indexes in regular files are memory-mapped" ) {
+            //The original layout has to be read from a stream
+            string filename = temp_file::create();
+            {
+                ofstream out(filename);
+                di.set_flat_layout(false);
+                di.serialize(out);
+            }
+            MinimumDistanceIndex original_di;
+            REQUIRE(!original_di.load_mapped(filename));
+            temp_file::remove(filename);
+
+            //And so does anything that isn't a regular file
+            string dirname = temp_file::create_directory();
+            string pipe_name = dirname + "/pipe";
+            REQUIRE(mkfifo(pipe_name.c_str(), 0600) == 0);
+            MinimumDistanceIndex pipe_di;
+            REQUIRE(!pipe_di.load_mapped(pipe_name));
+            temp_file::remove(dirname);
+        }
+
+        SECTION( "Flat index can be written in the original layout" ) {
+            flat_di.set_flat_layout(false);
+            stringstream original;
+            flat_di.serialize(original);
+
+            MinimumDistanceIndex original_di (original);
+            REQUIRE(!original_di.is_flat_layout());
+            for (id_t id1 = 1 ; id1 <= 8 ; id1++) {
+                for (id_t id2 = 1 ; id2 <= 8 ; id2++) {
+                    pos_t pos1 = make_pos_t(id1, false, 0);
+                    pos_t pos2 = make_pos_t(id2, false, 0);
+                    REQUIRE(original_di.min_distance(pos1, pos2) == di.min_distance(pos1, pos2));
+                }
+            }
+        }
+    }
     /*
     TEST_CASE("Serialize only minimum distance index", "[dist][serial]") {
         for (int i = 0; i < 100; i++) {
@@ -0,0 +1,119 @@
+///
+/// \file myers_edit_distance.cpp
+///
+/// Unit tests for MyersEditDistance
+///
+
+#include "catch.hpp"
+#include "../myers_edit_distance.hpp"
+
+#include <algorithm>
+#include <random>
+
+namespace vg {
+namespace unittest {
+
+using namespace std;
+
+/// Compute the prefix edit distance the slow way, with N matching anything.
+static size_t slow_prefix_distance(const string& pattern, const string& text) {
+    vector<vector<size_t>> table(pattern.size() + 1, vector<size_t>(text.size() + 1));
+    for (size_t i = 0; i <= pattern.size(); i++) {
+        table[i][0] = i;
+    }
+    for (size_t j = 0; j <= text.size(); j++) {
+        table[0][j] = j;
+    }
+    for (size_t i = 1; i <= pattern.size(); i++) {
+        for (size_t j = 1; j <= text.size(); j++) {
+            bool match = pattern[i - 1] == text[j - 1] || pattern[i - 1] == 'N' || text[j - 1] == 'N';
+            table[i][j] = min(table[i - 1][j - 1] + (match ? 0 : 1), min(table[i - 1][j], table[i][j - 1]) + 1);
+        }
+    }
+    size_t best = table[pattern.size()][0];
+    for (size_t j = 0; j <= text.size(); j++) {
+        best = min(best, table[pattern.size()][j]);
+    }
+    return best;
+}
+
+TEST_CASE("MyersEditDistance finds prefix edit distances", "[myers]") {
+
+    SECTION("Exact prefix matches have distance 0") {
+        MyersEditDistance distance("GATTACA");
+        REQUIRE(distance.prefix_distance("GATTACA") == 0);
+        REQUIRE(distance.prefix_distance("GATTACATTTT") == 0);
+    }
+
+    SECTION("Edits are counted") {
+        MyersEditDistance distance("GATTACA");
+        REQUIRE(distance.prefix_distance("GACTACA") == 1);
+        REQUIRE(distance.prefix_distance("GATACA") == 1);
+        REQUIRE(distance.prefix_distance("GATTTACA") == 1);
+        // The text must be matched from its start
+        REQUIRE(distance.prefix_distance("CCGATTACA") == 2);
+        // An empty text means inserting the whole pattern
+        REQUIRE(distance.prefix_distance("") == 7);
+    }
+
+    SECTION("N matches anything") {
+        MyersEditDistance distance("GANTACA");
+        REQUIRE(distance.prefix_distance("GATTACA") == 0);
+        REQUIRE(distance.prefix_distance("GATTNCA") == 0);
+    }
+
+    SECTION("Columns can be shared between texts") {
+        MyersEditDistance distance("ACGTACGT");
+        MyersEditDistance::Column column = distance.start();
+        for (char c : string("ACGT")) {
+            distance.advance(column, c);
+        }
+        MyersEditDistance::Column branch = column;
+        for (char c : string("ACGT")) {
+            distance.advance(column, c);
+        }
+        for (char c : string("TTTT")) {
+            distance.advance(branch, c);
+        }
+        REQUIRE(column.score == 0);
+        REQUIRE(branch.score == 3);
+    }
+
+    SECTION("Long patterns agree with the full dynamic programming") {
+        default_random_engine generator(1234);
+        uniform_int_distribution<size_t> base_distribution(0, 3);
+        uniform_int_distribution<size_t> edit_distribution(0, 9);
+        const string bases = "ACGT";
+        for (size_t length : {1, 63, 64, 65, 150, 300}) {
+            string pattern;
+            for (size_t i = 0; i < length; i++) {
+                pattern.push_back(bases[base_distribution(generator)]);
+            }
+            // Make a text with some edits relative to the pattern
+            string text;
+            for (size_t i = 0; i < length; i++) {
+                size_t edit = edit_distribution(generator);
+                if (edit == 0) {
+                    // Substitution
+                    text.push_back(bases[base_distribution(generator)]);
+                } else if (edit == 1) {
+                    // Deletion
+                    continue;
+                } else if (edit == 2) {
+                    // Insertion
+                    text.push_back(bases[base_distribution(generator)]);
+                    text.push_back(pattern[i]);
+                } else {
+                    text.push_back(pattern[i]);
+                }
+            }
+            text += "ACGTTGCA";
+
+            MyersEditDistance distance(pattern);
+            REQUIRE(distance.prefix_distance(text) == slow_prefix_distance(pattern, text));
+        }
+    }
+}
+
+}
+}
@@ -0,0 +1,120 @@
+/**
+ * \file
+ * unittest/read_scheduler.cpp: test cases for the work-stealing ReadBatchScheduler.
+ */
+
+#include "catch.hpp"
+#include "../read_scheduler.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vg {
+namespace unittest {
+
+TEST_CASE("ReadBatchScheduler processes every read exactly once", "[scheduler]") {
+
+    ReadBatchScheduler scheduler(4, 7, 2);
+
+    size_t next_read = 0;
+    size_t total_reads = 1000;
+    auto get_read = [&](Alignment& aln) {
+        if (next_read == total_reads) {
+            return false;
+        }
+        aln.set_name(std::to_string(next_read++));
+        return true;
+    };
+
+    std::vector<std::atomic<size_t>> seen(total_reads);
+    for (auto& count : seen) {
+        count.store(0);
+    }
+
+    size_t processed = scheduler.for_each_parallel(get_read, [&](Alignment& aln) {
+        seen.at(std::stoul(aln.name()))++;
+    });
+
+    REQUIRE(processed == total_reads);
+    for (auto& count : seen) {
+        REQUIRE(count.load() == 1);
+    }
+    // 1000 reads in batches of 7 makes 143 batches.
+    REQUIRE(scheduler.batch_count() == 143);
+    REQUIRE(scheduler.batch_seconds_quantile(0.5) <= scheduler.batch_seconds_quantile(1.0));
+}
+
+TEST_CASE("ReadBatchScheduler waits before going parallel on pairs", "[scheduler]") {
+
+    ReadBatchScheduler scheduler(4, 10, 2);
+
+    size_t next_pair = 0;
+    size_t total_pairs = 95;
+    auto get_pair = [&](Alignment& aln1, Alignment& aln2) {
+        if (next_pair == total_pairs) {
+            return false;
+        }
+        aln1.set_name(std::to_string(next_pair));
+        aln2.set_name(std::to_string(next_pair));
+        next_pair++;
+        return true;
+    };
+
+    std::atomic<size_t> processed_pairs(0);
+    std::atomic<size_t> mismatched_pairs(0);
+    size_t single_threaded_pairs = 0;
+    bool went_parallel = false;
+
+    size_t processed = scheduler.for_each_pair_parallel_after_wait(get_pair, [&](Alignment& aln1, Alignment& aln2) {
+        if (aln1.name() != aln2.name()) {
+            mismatched_pairs++;
+        }
+        if (!went_parallel) {
+            single_threaded_pairs++;
+        }
+        processed_pairs++;
+    }, [&]() {
+        // Go parallel after 15 pairs.
+        went_parallel = single_threaded_pairs >= 15;
+        return went_parallel;
+    });
+
+    REQUIRE(processed == total_pairs);
+    REQUIRE(processed_pairs.load() == total_pairs);
+    REQUIRE(mismatched_pairs.load() == 0);
+    REQUIRE(single_threaded_pairs == 15);
+    // The remaining 80 pairs go in batches of 10.
+    REQUIRE(scheduler.batch_count() == 8);
+}
+
+TEST_CASE("ReadBatchScheduler threads sleep while they have nothing to do", "[scheduler]") {
+
+    ReadBatchScheduler scheduler(4, 1, 2);
+
+    size_t next_read = 0;
+    auto get_read = [&](Alignment& aln) {
+        if (next_read == 1) {
+            return false;
+        }
+        aln.set_name(std::to_string(next_read++));
+        return true;
+    };
+
+    // One slow read leaves the other threads waiting for it to finish.
+    std::clock_t cpu_start = std::clock();
+    size_t processed = scheduler.for_each_parallel(get_read, [&](Alignment& aln) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    });
+    double cpu_seconds = (double) (std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+    REQUIRE(processed == 1);
+    // Spinning threads would use up to 1.5 seconds of CPU.
+    REQUIRE(cpu_seconds < 0.25);
+}
+
+}
+}
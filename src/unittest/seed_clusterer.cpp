@@ -10,10 +10,12 @@
 #include "../integrated_snarl_finder.hpp"
 #include "../genotypekit.hpp"
 #include "random_graph.hpp"
+#include "randomness.hpp"
 #include "../seed_clusterer.hpp"
 #include <random>
 #include <time.h>
 #include <structures/union_find.hpp>
+#include <omp.h>
 
 //#define print
 
@@ -2042,5 +2044,92 @@ namespace unittest {
             }
         }
     } //end test case
+
+    /// Put each read's clusters in a canonical order, with the fragment
+    /// clusters numbered in order of their first seeds, so that clusterings
+    /// can be compared no matter what order they were found in.
+    static vector<vector<pair<vector<size_t>, size_t>>> canonical_clusters(
+            const vector<vector<SnarlSeedClusterer::Cluster>>& all_clusters) {
+        vector<vector<pair<vector<size_t>, size_t>>> canonical(all_clusters.size());
+        for (size_t read_num = 0 ; read_num < all_clusters.size() ; read_num++) {
+            for (auto& cluster : all_clusters[read_num]) {
+                vector<size_t> seeds = cluster.seeds;
+                std::sort(seeds.begin(), seeds.end());
+                canonical[read_num].emplace_back(seeds, cluster.fragment);
+            }
+            std::sort(canonical[read_num].begin(), canonical[read_num].end());
+        }
+        unordered_map<size_t, size_t> fragment_numbers;
+        for (auto& read_clusters : canonical) {
+            for (auto& cluster : read_clusters) {
+                auto inserted = fragment_numbers.emplace(cluster.second, fragment_numbers.size());
+                cluster.second = inserted.first->second;
+            }
+        }
+        return canonical;
+    }
+
+    TEST_CASE("Clustering in parallel matches clustering serially", "[cluster]") {
+
+        default_random_engine generator(test_seed_source());
+
+        for (int i = 0; i < 10; i++) {
+            // For each random graph
+            uniform_int_distribution<int> variant_count(5, 500);
+            uniform_int_distribution<int> chrom_len(10, 2000);
+
+            VG graph;
+            random_graph({chrom_len(generator), chrom_len(generator), chrom_len(generator)}, 30, variant_count(generator), &graph);
+
+            IntegratedSnarlFinder bubble_finder(graph);
+            SnarlManager snarl_manager = bubble_finder.find_snarls();
+            MinimumDistanceIndex dist_index (&graph, &snarl_manager);
+
+            vector<id_t> all_nodes;
+            graph.for_each_handle([&](const handle_t& h)->bool{
+                all_nodes.push_back(graph.get_id(h));
+                return true;
+            });
+            uniform_int_distribution<int> randPosIndex(0, all_nodes.size()-1);
+
+            for (size_t k = 0; k < 10 ; k++) {
+                vector<vector<SnarlSeedClusterer::Seed>> all_seeds(2);
+                for (size_t read = 0 ; read < 2 ; read ++) {
+                    int seed_count = uniform_int_distribution<int>(1, 200)(generator);
+                    for (int j = 0; j < seed_count; j++) {
+                        id_t nodeID1 = all_nodes[randPosIndex(generator)];
+                        handle_t node1 = graph.get_handle(nodeID1);
+                        off_t offset1 = uniform_int_distribution<int>(0,graph.get_length(node1) - 1)(generator);
+                        pos_t pos = make_pos_t(nodeID1,
+                            uniform_int_distribution<int>(0,1)(generator) == 0,offset1 );
+                        std::tuple<bool, size_t, size_t, bool, size_t, size_t, size_t, size_t, bool> chain_info = dist_index.get_minimizer_distances(pos);
+                        all_seeds[read].push_back({ pos, 0, std::get<0>(chain_info), std::get<1>(chain_info), std::get<2>(chain_info),
+                           std::get<3>(chain_info), std::get<4>(chain_info), std::get<5>(chain_info), std::get<6>(chain_info), std::get<7>(chain_info), std::get<8>(chain_info)});
+                    }
+                }
+
+                SnarlSeedClusterer serial_clusterer(dist_index);
+                SnarlSeedClusterer parallel_clusterer(dist_index);
+                // Cluster everything in tasks, which only happens in a parallel region
+                parallel_clusterer.parallel_seed_threshold = 1;
+
+                // Single-end clusters match
+                vector<SnarlSeedClusterer::Cluster> serial_clusters = serial_clusterer.cluster_seeds(all_seeds[0], 30);
+                vector<SnarlSeedClusterer::Cluster> parallel_clusters;
+                #pragma omp parallel num_threads(4)
+                #pragma omp single
+                parallel_clusters = parallel_clusterer.cluster_seeds(all_seeds[0], 30);
+                REQUIRE(canonical_clusters({parallel_clusters}) == canonical_clusters({serial_clusters}));
+
+                // Paired clusters match
+                vector<vector<SnarlSeedClusterer::Cluster>> serial_paired_clusters = serial_clusterer.cluster_seeds(all_seeds, 30, 50);
+                vector<vector<SnarlSeedClusterer::Cluster>> parallel_paired_clusters;
+                #pragma omp parallel num_threads(4)
+                #pragma omp single
+                parallel_paired_clusters = parallel_clusterer.cluster_seeds(all_seeds, 30, 50);
+                REQUIRE(canonical_clusters(parallel_paired_clusters) == canonical_clusters(serial_paired_clusters));
+            }
+        }
+    }
 }
 }
@@ -11,6 +11,7 @@
 #include "bdsg/hash_graph.hpp"
 #include "bdsg/overlays/path_position_overlays.hpp"
 #include <vg/vg.pb.h>
+#include "vg/io/json2pb.h"
 
 namespace vg {
 namespace unittest {
@@ -688,5 +689,85 @@ TEST_CASE("Duplicate path chunks can be detected", "[surject][multipath]") {
     REQUIRE(path_chunks.size() == 2);
     
 }
+
+TEST_CASE("Surjecting to several paths in parallel gives the same results as surjecting serially", "[surject]") {
+    
+    bdsg::HashGraph graph;
+    handle_t h1 = graph.create_handle("GATTACAGATTACA");
+    handle_t h2 = graph.create_handle("C");
+    handle_t h3 = graph.create_handle("G");
+    handle_t h4 = graph.create_handle("TTGCATTGCATTGCA");
+    handle_t h5 = graph.create_handle("A");
+    handle_t h6 = graph.create_handle("T");
+    handle_t h7 = graph.create_handle("CCAGTCCAGTCCAGT");
+    
+    graph.create_edge(h1, h2);
+    graph.create_edge(h1, h3);
+    graph.create_edge(h2, h4);
+    graph.create_edge(h3, h4);
+    graph.create_edge(h4, h5);
+    graph.create_edge(h4, h6);
+    graph.create_edge(h5, h7);
+    graph.create_edge(h6, h7);
+    
+    // every read will overlap several of these paths
+    vector<vector<handle_t>> path_walks{{h1, h2, h4, h5, h7}, {h1, h3, h4, h5, h7}, {h1, h2, h4, h6, h7}};
+    unordered_set<path_handle_t> paths;
+    for (size_t i = 0; i < path_walks.size(); ++i) {
+        path_handle_t p = graph.create_path_handle("p" + to_string(i));
+        for (handle_t h : path_walks[i]) {
+            graph.append_step(p, h);
+        }
+        paths.insert(p);
+    }
+    
+    bdsg::PositionOverlay pos_graph(&graph);
+    
+    // reads along all the walks through the graph, on path or not
+    vector<Alignment> reads;
+    for (handle_t a : {h2, h3}) {
+        for (handle_t b : {h5, h6}) {
+            Alignment read;
+            string seq;
+            Path* rpath = read.mutable_path();
+            for (handle_t h : {h1, a, h4, b, h7}) {
+                Mapping* m = rpath->add_mapping();
+                m->set_rank(rpath->mapping_size());
+                m->mutable_position()->set_node_id(pos_graph.get_id(h));
+                Edit* e = m->add_edit();
+                e->set_from_length(pos_graph.get_length(h));
+                e->set_to_length(pos_graph.get_length(h));
+                seq += pos_graph.get_sequence(h);
+            }
+            read.set_name("read" + to_string(reads.size()));
+            read.set_sequence(seq);
+            read.set_score(Aligner().score_contiguous_alignment(read));
+            reads.push_back(read);
+        }
+    }
+    
+    for (bool preserve_deletions : {false, true}) {
+        vector<string> serial(reads.size());
+        {
+            Surjector surjector(&pos_graph);
+            for (size_t i = 0; i < reads.size(); ++i) {
+                serial[i] = pb2json(surjector.surject(reads[i], paths, true, preserve_deletions));
+            }
+        }
+        
+        vector<string> parallel(reads.size());
+        {
+            Surjector surjector(&pos_graph);
+            // surjecting from one thread lets the others take the tasks for each path
+#pragma omp parallel num_threads(4)
+#pragma omp single
+            for (size_t i = 0; i < reads.size(); ++i) {
+                parallel[i] = pb2json(surjector.surject(reads[i], paths, true, preserve_deletions));
+            }
+        }
+        
+        REQUIRE(parallel == serial);
+    }
+}
 }
 }
@@ -40,6 +40,9 @@ XdropAligner& XdropAligner::operator=(const XdropAligner& other)
         if (dz) {
             dz_destroy(dz);
         }
+        // We get our own dozeu memory, without the other aligner's query
+        query_cache = QueryCache();
+        
         dz = dz_init(other.dz->matrix,
                      *((const uint16_t*) &other.dz->giv),
                      *((const uint16_t*) &other.dz->gev));
@@ -61,6 +64,10 @@ XdropAligner& XdropAligner::operator=(XdropAligner&& other)
         }
         dz = other.dz;
         other.dz = nullptr;
+        // The cached query may point into the strings, which don't
+        // necessarily keep their buffers when moved
+        query_cache = QueryCache();
+        other.query_cache = QueryCache();
     }
 
 	return *this;
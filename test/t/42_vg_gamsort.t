@@ -6,7 +6,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 PATH=../bin:$PATH # for vg
 
 
-plan tests 2
+plan tests 5
 
 vg construct -r small/x.fa -v small/x.vcf.gz >x.vg
 vg index -x x.xg  x.vg
@@ -22,5 +22,15 @@ is "$(md5sum <min_ids.gamsorted.txt)" "$(md5sum <min_ids.sorted.txt)" "Sorting a
 vg gamsort x.gam -i x.sorted.gam.gai >x.sorted.gam
 is "$?" "0" "sorted GAMs can be indexed during the sort"
 
+vg gamsort -t 8 -m 1 x.gam >x.sorted.2.gam
+vg view -aj x.sorted.2.gam | jq -r '.path.mapping | ([.[] | .position.node_id | tonumber] | min)' >min_ids.gamsorted.txt
+is "$(md5sum <min_ids.gamsorted.txt)" "$(md5sum <min_ids.sorted.txt)" "Sorting a GAM in many small chunks on many threads orders the alignments by min node ID"
 
-rm -f x.vg x.xg x.gam x.sorted.gam x.sorted.2.gam min_ids.gamsorted.txt min_ids.sorted.txt x.sorted.gam.gai x.sorted.2.gam.gai
+vg convert x.vg -G x.gam >x.gaf
+vg gamsort -G x.gaf -i x.sorted.gaf.gz.gai >x.sorted.gaf.gz
+zcat x.sorted.gaf.gz | cut -f 6 | tr '><' '  ' | awk '{m=$1; for (i=2; i<=NF; i++) if ($i<m) m=$i; print m}' | sort -n -c
+is "$?" "0" "Sorting a GAF orders the records by min node ID"
+
+is "$(vg find --sorted-gaf x.sorted.gaf.gz -o 10:20 | wc -l)" "$(vg find -l x.sorted.gam -o 10:20 | vg view -a - | wc -l)" "sorted GAF and sorted GAM find the same number of reads on a node range"
+
+rm -f x.vg x.xg x.gam x.sorted.gam x.sorted.2.gam min_ids.gamsorted.txt min_ids.sorted.txt x.sorted.gam.gai x.sorted.2.gam.gai x.gaf x.sorted.gaf.gz x.sorted.gaf.gz.gai
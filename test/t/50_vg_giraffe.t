@@ -5,7 +5,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 24
+plan tests 37
 
 vg construct -a -r small/x.fa -v small/x.vcf.gz >x.vg
 vg index -x x.xg x.vg
@@ -37,7 +37,13 @@ vg minimizer -k 29 -b -s 18 -g x.gbwt -o x.sync x.xg
 vg giraffe -x x.xg -H x.gbwt -m x.sync -d x.dist -f reads/small.middle.ref.fq > mapped.sync.gam
 is "${?}" "0" "a read can be mapped with syncmer indexes without crashing"
 
-rm -f x.vg x.xg x.gbwt x.snarls x.min x.sync x.dist x.gg
+vg index -s x.snarls -j x.flat.dist --flat-dist x.vg
+vg giraffe -x x.xg -H x.gbwt -m x.sync -d x.flat.dist -f reads/small.middle.ref.fq > mapped.flat.gam
+is "$(vg view -aj mapped.flat.gam | jq -c '[.name, .path]' | sort | md5sum)" "$(vg view -aj mapped.sync.gam | jq -c '[.name, .path]' | sort | md5sum)" "a flat distance index gives the same mappings"
+vg giraffe -x x.xg -H x.gbwt -m x.sync -d <(cat x.flat.dist) -f reads/small.middle.ref.fq > mapped.flatpipe.gam
+is "$(vg view -aj mapped.flatpipe.gam | jq -c '[.name, .path]' | sort | md5sum)" "$(vg view -aj mapped.sync.gam | jq -c '[.name, .path]' | sort | md5sum)" "a flat distance index can be read from a pipe"
+
+rm -f x.vg x.xg x.gbwt x.snarls x.min x.sync x.dist x.flat.dist x.gg mapped.flat.gam mapped.flatpipe.gam
 rm -f x.giraffe.gbz
 
 
@@ -72,6 +78,15 @@ rm -rf mapped1.gam mapped1.json mapped2.gam mapped2.json mapped.sync.gam mapped.
 vg giraffe x.fa x.vcf.gz -f small/x.fa_1.fastq > single.gam
 is "$(vg view -aj single.gam | jq -c 'select((.fragment_next | not) and (.fragment_prev | not))' | wc -l)" "1000" "unpaired reads lack cross-references"
 
+vg giraffe x.fa x.vcf.gz -f small/x.fa_1.fastq -t 1 --batch-size 64 > batched.gam
+is "$(vg view -aj batched.gam | jq -c '[.name, .path]' | sort | md5sum)" "$(vg view -aj single.gam | jq -c '[.name, .path]' | sort | md5sum)" "batched minimizer lookup produces the same alignments"
+
+vg giraffe x.fa x.vcf.gz -f small/x.fa_1.fastq --tail-bound-mapq 60 > bounded.gam
+is "$(vg view -aj bounded.gam | jq -c '[.name, .path, .score]' | sort | md5sum)" "$(vg view -aj single.gam | jq -c '[.name, .path, .score]' | sort | md5sum)" "bounding tail alignments produces the same alignments"
+
+vg giraffe x.fa x.vcf.gz -f small/x.fa_1.fastq --bound-tail-trees > tree-bounded.gam
+is "$(vg view -aj tree-bounded.gam | jq -c '[.name, .path, .score]' | sort | md5sum)" "$(vg view -aj single.gam | jq -c '[.name, .path, .score]' | sort | md5sum)" "bounding tail trees produces the same alignments"
+
 vg giraffe x.fa x.vcf.gz -f small/x.fa_1.fastq -f small/x.fa_1.fastq --fragment-mean 300 --fragment-stdev 100 > paired.gam
 is "$(vg view -aj paired.gam | jq -c 'select((.fragment_next | not) and (.fragment_prev | not))' | wc -l)" "0" "paired reads have cross-references"
 
@@ -91,7 +106,27 @@ is "$(cat surjected.sam | grep -v '^@' | cut -f 1 | sort | uniq | wc -l)" "2" "s
 is "$(cat surjected.sam | grep -v '^@' | cut -f 7)" "$(printf '*\n*')" "surjection of unpaired reads to SAM produces absent partner contigs"
 is "$(cat surjected.sam | grep -v '^@' | sort -k4 | cut -f 2)" "$(printf '0\n16')" "surjection of unpaired reads to SAM produces correct flags"
 
-rm -f x.vg x.gbwt x.xg x.snarls x.min x.dist x.gg x.fa x.fa.fai x.vcf.gz x.vcf.gz.tbi single.gam paired.gam surjected.sam
+vg giraffe x.fa x.vcf.gz -G <(vg view -a small/x-s13241-n1-p500-v300.gam | sed 's%_1%/1%' | sed 's%_2%/2%' | vg view -JaG - ) --output-format BAM --hts-threads 2 -t 2 >surjected.bam
+is "$(samtools view surjected.bam | sort | md5sum)" "$(cat surjected.sam | grep -v '^@' | sort | md5sum)" "compressing BAM output on separate threads produces the same records"
+
+# Write BAM from many small batches through the compression threads
+vg sim -x x.xg -n 2000 -l 100 -s 1 -a > many.gam
+vg giraffe x.fa x.vcf.gz -G many.gam --output-format BAM --hts-threads 2 -t 2 >many.bam
+is "$(samtools quickcheck many.bam && samtools view -c many.bam)" "2000" "BAM output compressed on separate threads over many batches is intact"
+vg giraffe x.fa x.vcf.gz -G many.gam --output-format SAM -t 2 >many.sam
+is "$(samtools view many.bam | sort | md5sum)" "$(grep -v '^@' many.sam | sort | md5sum)" "BAM output compressed on separate threads over many batches has the same records"
+
+# Sort with a small budget. Spilling to many temp files is covered by the unit tests.
+vg giraffe x.fa x.vcf.gz -G many.gam --output-format BAM --sort-output --sort-memory 1 -t 2 >many.sorted.bam
+is "$(samtools quickcheck many.sorted.bam && samtools index many.sorted.bam && samtools view -c many.sorted.bam)" "2000" "sorted BAM output with a small memory budget is intact and indexable"
+is "$(samtools view -H many.sorted.bam | grep '^@HD' | grep -c 'SO:coordinate')" "1" "sorted BAM output declares its sort order"
+is "$(samtools view many.sorted.bam | cut -f 3,4 | md5sum)" "$(samtools sort many.bam | samtools view - | cut -f 3,4 | md5sum)" "sorted BAM output with a small memory budget is in coordinate order"
+
+vg giraffe x.fa x.vcf.gz -G <(vg view -a small/x-s13241-n1-p500-v300.gam | sed 's%_1%/1%' | sed 's%_2%/2%' | vg view -JaG - ) --output-format BAM --sort-output --hts-index sorted.bam.bai -t 2 >sorted.bam
+is "$(samtools view sorted.bam | cut -f 4)" "$(printf '321\n762')" "sorted BAM output is in coordinate order"
+is "$(samtools view sorted.bam x:700-800 | cut -f 4)" "762" "sorted BAM output can be queried with its index"
+
+rm -f x.vg x.gbwt x.xg x.snarls x.min x.dist x.gg x.fa x.fa.fai x.vcf.gz x.vcf.gz.tbi single.gam batched.gam bounded.gam tree-bounded.gam paired.gam surjected.sam surjected.bam sorted.bam sorted.bam.bai many.gam many.bam many.sam many.sorted.bam many.sorted.bam.bai
 rm -f x.giraffe.gbz
 
 
@@ -5,7 +5,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 21
+plan tests 24
 
 vg autoindex -p auto -w map -r tiny/tiny.fa -v tiny/tiny.vcf.gz --force-unphased
 is $(echo $?) 0 "autoindexing successfully completes indexing for vg map with basic input"
@@ -70,5 +70,12 @@ is $(echo $?) 0 "basic autoindexing results can be used by vg giraffe"
 rm auto.*
 rm t.*
 
+vg autoindex -p auto -w map -r tiny/tiny.fa -v tiny/tiny.vcf.gz --force-unphased --cache auto_cache
+is $(echo $?) 0 "autoindexing can fill a cache"
+mv auto.xg cached_once.xg
+rm auto.*
+vg autoindex -p auto -w map -r tiny/tiny.fa -v tiny/tiny.vcf.gz --force-unphased --cache auto_cache 2> cache.log
+is $(grep -c "Reusing cached XG\.$" cache.log) 1 "autoindexing reuses the cached indexes"
+is $(cmp auto.xg cached_once.xg && echo same) same "cached indexes are the same as the ones we made"
 
-
+rm -r auto.* cached_once.xg cache.log auto_cache